@@ -0,0 +1,101 @@
+#include "AllocationCounter.h"
+
+#include <cstdlib>
+#include <new>
+
+#include <malloc.h>
+
+namespace allocation {
+std::atomic<size_t> allocations{0};
+std::atomic<size_t> allocatedBytes{0};
+std::atomic<size_t> liveBytes{0};
+std::atomic<size_t> peakBytes{0};
+} // namespace allocation
+
+namespace {
+
+void *counted(void *p) {
+  if (!p)
+    return p;
+  using namespace allocation;
+  size_t size = malloc_usable_size(p);
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+  size_t live = liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+  size_t peak = peakBytes.load(std::memory_order_relaxed);
+  while (live > peak && !peakBytes.compare_exchange_weak(
+                            peak, live, std::memory_order_relaxed)) {
+  }
+  return p;
+}
+
+void *allocate(size_t size, size_t alignment, bool nothrow) {
+  if (size == 0)
+    size = 1;
+  void *p = alignment <= alignof(std::max_align_t)
+                ? std::malloc(size)
+                : std::aligned_alloc(alignment,
+                                     (size + alignment - 1) / alignment *
+                                         alignment);
+  if (!p && !nothrow)
+    throw std::bad_alloc();
+  return counted(p);
+}
+
+void release(void *p) {
+  if (!p)
+    return;
+  allocation::liveBytes.fetch_sub(malloc_usable_size(p),
+                                  std::memory_order_relaxed);
+  std::free(p);
+}
+
+} // namespace
+
+void *operator new(size_t size) { return allocate(size, 0, false); }
+void *operator new[](size_t size) { return allocate(size, 0, false); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  return allocate(size, 0, true);
+}
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+  return allocate(size, 0, true);
+}
+void *operator new(size_t size, std::align_val_t alignment) {
+  return allocate(size, (size_t)alignment, false);
+}
+void *operator new[](size_t size, std::align_val_t alignment) {
+  return allocate(size, (size_t)alignment, false);
+}
+void *operator new(size_t size, std::align_val_t alignment,
+                   const std::nothrow_t &) noexcept {
+  return allocate(size, (size_t)alignment, true);
+}
+void *operator new[](size_t size, std::align_val_t alignment,
+                     const std::nothrow_t &) noexcept {
+  return allocate(size, (size_t)alignment, true);
+}
+
+void operator delete(void *p) noexcept { release(p); }
+void operator delete[](void *p) noexcept { release(p); }
+void operator delete(void *p, size_t) noexcept { release(p); }
+void operator delete[](void *p, size_t) noexcept { release(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { release(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept {
+  release(p);
+}
+void operator delete(void *p, std::align_val_t) noexcept { release(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { release(p); }
+void operator delete(void *p, size_t, std::align_val_t) noexcept {
+  release(p);
+}
+void operator delete[](void *p, size_t, std::align_val_t) noexcept {
+  release(p);
+}
+void operator delete(void *p, std::align_val_t,
+                     const std::nothrow_t &) noexcept {
+  release(p);
+}
+void operator delete[](void *p, std::align_val_t,
+                       const std::nothrow_t &) noexcept {
+  release(p);
+}
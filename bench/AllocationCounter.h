@@ -0,0 +1,68 @@
+#ifndef PROJECT_DB_ALLOCATIONCOUNTER_H
+#define PROJECT_DB_ALLOCATIONCOUNTER_H
+
+#include <atomic>
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+// Heap accounting for the benchmarks: AllocationCounter.cpp replaces the
+// global operator new and delete with versions that count into these totals.
+// An executable that includes this header must link AllocationCounter.o.
+// Sizes are the usable sizes malloc hands out, so they include its rounding.
+namespace allocation {
+extern std::atomic<size_t> allocations;    // calls to operator new
+extern std::atomic<size_t> allocatedBytes; // bytes they returned
+extern std::atomic<size_t> liveBytes;      // bytes not freed yet
+extern std::atomic<size_t> peakBytes;      // highest liveBytes so far
+} // namespace allocation
+
+/**
+ * @brief         What was allocated between the start of an
+ *                AllocationCounter and stats()
+ */
+struct AllocationStats {
+  size_t allocations = 0;
+  size_t allocatedBytes = 0;
+  size_t liveBytes = 0; // still allocated, over what was live at the start
+  size_t peakBytes = 0; // highest live bytes, over the start
+
+  static std::string header() {
+    return "Allocations,AllocatedBytes,LiveBytes,PeakBytes";
+  }
+  friend std::ostream &operator<<(std::ostream &os,
+                                  const AllocationStats &stats) {
+    return os << stats.allocations << "," << stats.allocatedBytes << ","
+              << stats.liveBytes << "," << stats.peakBytes;
+  }
+};
+
+/**
+ * @brief         Counts the allocations made from its construction on
+ *
+ * The peak is reset at construction, so counters do not nest.
+ */
+class AllocationCounter {
+private:
+  size_t allocations;
+  size_t allocatedBytes;
+  size_t liveBytes;
+
+public:
+  AllocationCounter()
+      : allocations(allocation::allocations.load()),
+        allocatedBytes(allocation::allocatedBytes.load()),
+        liveBytes(allocation::liveBytes.load()) {
+    allocation::peakBytes.store(liveBytes);
+  }
+
+  AllocationStats stats() const {
+    size_t live = allocation::liveBytes.load();
+    return {allocation::allocations.load() - allocations,
+            allocation::allocatedBytes.load() - allocatedBytes,
+            live > liveBytes ? live - liveBytes : 0,
+            allocation::peakBytes.load() - liveBytes};
+  }
+};
+
+#endif // PROJECT_DB_ALLOCATIONCOUNTER_H
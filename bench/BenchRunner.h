@@ -0,0 +1,274 @@
+#ifndef PROJECT_DB_BENCHRUNNER_H
+#define PROJECT_DB_BENCHRUNNER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <ostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "CommandLine.h"
+
+/**
+ * @brief         The outcome of one run of a benchmark case: its numeric
+ *                metrics (NaN for one it could not measure) and a text
+ *                column that is taken from the last run as is
+ */
+struct Sample {
+  std::vector<double> values;
+  std::string text;
+};
+
+/**
+ * @brief         Median, mean, standard deviation and the 95% confidence
+ *                interval of the mean of the runs of one metric
+ *
+ * The interval uses Student's t distribution, as repetitions are few. NaN
+ * samples are left out; a metric without any is written as empty fields.
+ */
+struct SampleStats {
+  size_t count = 0;
+  double median = NAN;
+  double mean = NAN;
+  double stddev = NAN;
+  double ciLow = NAN;
+  double ciHigh = NAN;
+
+  static SampleStats of(std::vector<double> samples) {
+    auto isNan = [](double value) { return std::isnan(value); };
+    samples.erase(std::remove_if(samples.begin(), samples.end(), isNan),
+                  samples.end());
+    SampleStats stats;
+    stats.count = samples.size();
+    if (samples.empty())
+      return stats;
+    std::sort(samples.begin(), samples.end());
+    size_t middle = samples.size() / 2;
+    stats.median = samples.size() % 2
+                       ? samples[middle]
+                       : (samples[middle - 1] + samples[middle]) / 2;
+    stats.mean = std::accumulate(samples.begin(), samples.end(), 0.0) /
+                 (double)samples.size();
+    double squares = 0;
+    for (double value : samples)
+      squares += (value - stats.mean) * (value - stats.mean);
+    stats.stddev =
+        samples.size() > 1 ? std::sqrt(squares / (samples.size() - 1)) : 0;
+    double margin = tQuantile(samples.size() - 1) * stats.stddev /
+                    std::sqrt((double)samples.size());
+    stats.ciLow = stats.mean - margin;
+    stats.ciHigh = stats.mean + margin;
+    return stats;
+  }
+
+  // the two-sided 97.5% quantile of Student's t with the degrees of freedom
+  static double tQuantile(size_t freedom) {
+    static const double table[] = {
+        0,     12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306,
+        2.262, 2.228,  2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110,
+        2.101, 2.093,  2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056,
+        2.052, 2.048,  2.045, 2.042};
+    if (freedom < sizeof(table) / sizeof(table[0]))
+      return table[freedom];
+    return freedom < 60 ? 2.000 : freedom < 120 ? 1.980 : 1.960;
+  }
+
+  static std::string header() {
+    return "Repetitions,Median,Mean,StdDev,CI95Low,CI95High";
+  }
+  friend std::ostream &operator<<(std::ostream &os, const SampleStats &stats) {
+    os << stats.count;
+    for (double value : {stats.median, stats.mean, stats.stddev, stats.ciLow,
+                         stats.ciHigh}) {
+      os << ",";
+      if (!std::isnan(value))
+        os << value;
+    }
+    return os;
+  }
+};
+
+/**
+ * @brief         Runs benchmark cases with warmup runs, repetitions in a new
+ *                random order each round and, optionally, each run in a
+ *                process of its own
+ *
+ * Options come from the command line:
+ *   --warmup N       unmeasured runs of each case before its measured ones
+ *   --repetitions N  measured runs of each case
+ *   --seed S         seed of the case order, to replay a run (the default is
+ *                    random and printed)
+ *   --isolate        measure every run in a forked child, so that the heap
+ *                    of one case does not carry over into the next; the
+ *                    child does its warmup runs first
+ */
+class BenchRunner {
+public:
+  struct Options {
+    size_t warmup = 1;
+    size_t repetitions = 5;
+    uint64_t seed = std::random_device()();
+    bool isolate = false;
+
+    // the values that follow the runner's option, -1 for another option
+    static int arguments(const char *option) {
+      if (strcmp(option, "--isolate") == 0)
+        return 0;
+      for (const char *name : {"--warmup", "--repetitions", "--seed"}) {
+        if (strcmp(option, name) == 0)
+          return 1;
+      }
+      return -1;
+    }
+
+    // An invalid value leaves its option at the default; the benchmark checks
+    // them when it reads its own options
+    static Options parse(int argc, char *argv[]) {
+      Options options;
+      for (int i = 1; i < argc; ++i) {
+        bool hasValue = i + 1 < argc;
+        if (strcmp(argv[i], "--isolate") == 0)
+          options.isolate = true;
+        else if (strcmp(argv[i], "--warmup") == 0 && hasValue)
+          parseWholeNumber(argv[++i], options.warmup);
+        else if (strcmp(argv[i], "--repetitions") == 0 && hasValue)
+          parseWholeNumber(argv[++i], options.repetitions);
+        else if (strcmp(argv[i], "--seed") == 0 && hasValue)
+          parseWholeNumber(argv[++i], options.seed);
+      }
+      options.repetitions = std::max<size_t>(options.repetitions, 1);
+      return options;
+    }
+  };
+
+  struct Case {
+    std::string name;
+    std::function<Sample()> run;
+  };
+
+private:
+  Options options;
+  std::mt19937_64 rng;
+
+  // Run a case in a child process and read its sample through a pipe;
+  // false if the child failed
+  bool runIsolated(const std::function<Sample()> &run, Sample &sample) {
+    int fds[2];
+    if (pipe(fds) != 0)
+      return false;
+    std::cout.flush();
+    pid_t pid = fork();
+    if (pid < 0) {
+      close(fds[0]);
+      close(fds[1]);
+      return false;
+    }
+    if (pid == 0) {
+      close(fds[0]);
+      for (size_t i = 0; i < options.warmup; ++i)
+        run();
+      Sample result = run();
+      uint64_t sizes[2] = {result.values.size(), result.text.size()};
+      bool written =
+          writeAll(fds[1], sizes, sizeof(sizes)) &&
+          writeAll(fds[1], result.values.data(),
+                   result.values.size() * sizeof(double)) &&
+          writeAll(fds[1], result.text.data(), result.text.size());
+      _exit(written ? 0 : 1);
+    }
+    close(fds[1]);
+    uint64_t sizes[2];
+    bool received = readAll(fds[0], sizes, sizeof(sizes));
+    if (received) {
+      sample.values.resize(sizes[0]);
+      sample.text.resize(sizes[1]);
+      received = readAll(fds[0], sample.values.data(),
+                         sample.values.size() * sizeof(double)) &&
+                 readAll(fds[0], &sample.text[0], sample.text.size());
+    }
+    close(fds[0]);
+    int status;
+    waitpid(pid, &status, 0);
+    return received && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  }
+
+  static bool writeAll(int fd, const void *data, size_t size) {
+    const char *bytes = static_cast<const char *>(data);
+    while (size > 0) {
+      ssize_t written = write(fd, bytes, size);
+      if (written <= 0)
+        return false;
+      bytes += written;
+      size -= (size_t)written;
+    }
+    return true;
+  }
+
+  static bool readAll(int fd, void *data, size_t size) {
+    char *bytes = static_cast<char *>(data);
+    while (size > 0) {
+      ssize_t got = read(fd, bytes, size);
+      if (got <= 0)
+        return false;
+      bytes += got;
+      size -= (size_t)got;
+    }
+    return true;
+  }
+
+  // the indexes of size cases in a random order
+  std::vector<size_t> shuffled(size_t size) {
+    std::vector<size_t> order(size);
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), rng);
+    return order;
+  }
+
+public:
+  explicit BenchRunner(const Options &options)
+      : options(options), rng(options.seed) {}
+
+  const Options &settings() const { return options; }
+
+  /**
+   * @brief         Run every case: the warmup rounds, then one round per
+   *                repetition, each in a new random order of the cases
+   * @return        The measured samples of each case, in the order of cases;
+   *                a run that failed in its child process is missing
+   */
+  std::vector<std::vector<Sample>> run(const std::vector<Case> &cases) {
+    std::vector<std::vector<Sample>> samples(cases.size());
+    if (!options.isolate) {
+      for (size_t round = 0; round < options.warmup; ++round) {
+        for (size_t index : shuffled(cases.size()))
+          cases[index].run();
+      }
+    }
+    for (size_t round = 0; round < options.repetitions; ++round) {
+      for (size_t index : shuffled(cases.size())) {
+        if (!options.isolate) {
+          samples[index].push_back(cases[index].run());
+          continue;
+        }
+        Sample sample;
+        if (runIsolated(cases[index].run, sample))
+          samples[index].push_back(std::move(sample));
+        else
+          std::cerr << "Run of " << cases[index].name << " failed" << std::endl;
+      }
+    }
+    return samples;
+  }
+};
+
+#endif // PROJECT_DB_BENCHRUNNER_H
@@ -0,0 +1,54 @@
+#ifndef PROJECT_DB_BENCHUTILS_H
+#define PROJECT_DB_BENCHUTILS_H
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Dataset.h"
+
+// Shared by the benchmark executables: dataset loading and the custom hashes
+
+// The keys of the dataset, each with its row number as data (the 10-digit
+// studentID does not fit an int)
+inline std::vector<std::pair<std::string, int>>
+readCSV(const std::string &filename) {
+  Dataset dataset = loadDataset(filename);
+  std::vector<std::pair<std::string, int>> data;
+  data.reserve(dataset.size());
+  for (size_t i = 0; i < dataset.size(); ++i)
+    data.emplace_back(dataset.keys[i], (int)i);
+  return data;
+}
+
+inline unsigned naive_mod_hash(const std::string &key, size_t tableSize) {
+  unsigned hash = 0;
+  for (char c : key) {
+    hash = (hash * 256 + c) % tableSize;
+  }
+  return hash;
+}
+
+struct CustomHashMod {
+  size_t operator()(const std::string &key) const {
+    return naive_mod_hash(key, 10000000);
+  }
+};
+
+inline unsigned fnv_hash_1a_32(void *key, int len) {
+  unsigned char *p = static_cast<unsigned char *>(key);
+  unsigned h = 0x811c9dc5;
+  for (int i = 0; i < len; i++) {
+    h = (h ^ p[i]) * 0x01000193;
+  }
+  return h;
+}
+
+struct CustomHashFNV1A {
+  size_t operator()(const std::string &key) const {
+    return fnv_hash_1a_32((void *)key.data(), key.size());
+  }
+};
+
+#endif // PROJECT_DB_BENCHUTILS_H
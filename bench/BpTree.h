@@ -1,93 +1,311 @@
 #ifndef PROJECT_DB_BPTREE_H
 #define PROJECT_DB_BPTREE_H
 
+#include <array>
+#include <iterator>
 #include <memory>
 #include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <variant>
 #include <vector>
 
-template <typename IndexType, typename DataType> class BpTree {
+#include "NodeIndexes.h"
+#include "NodePool.h"
+#include "NodeSearch.h"
+#include "ParallelSort.h"
+
+template <typename IndexType, typename DataType,
+          typename NodePolicy = PooledNodes>
+class BpTree {
 private:
-  class Node : public std::enable_shared_from_this<Node> {
+  // Small values live inline in the leaf next to their indexes; large ones
+  // are boxed so that shifting and splitting a leaf only moves pointers
+  static constexpr bool inlineData =
+      sizeof(DataType) <= 64 && std::is_nothrow_move_constructible_v<DataType>;
+  using DataSlot =
+      std::conditional_t<inlineData, DataType, std::unique_ptr<DataType>>;
+
+  static DataSlot makeSlot(DataType data) {
+    if constexpr (inlineData)
+      return data;
+    else
+      return std::make_unique<DataType>(std::move(data));
+  }
+  static DataType &slotData(DataSlot &slot) {
+    if constexpr (inlineData)
+      return slot;
+    else
+      return *slot;
+  }
+
+  class Node {
   public:
-    typedef std::vector<std::shared_ptr<DataType>>
-        DataContent; // For leaf nodes
-    typedef std::vector<std::shared_ptr<Node>>
-        ChildrenContent; // For internal nodes
+    typedef std::vector<DataSlot> DataContent;   // For leaf nodes
+    typedef std::vector<Node *> ChildrenContent; // For internal nodes
 
     bool isLeaf; // True if node is a leaf, false if node is an internal node
-    std::vector<IndexType> indexes; // the index of the node
-    std::shared_ptr<Node> next;     // the next leaf node
+    NodeIndexes<IndexType> indexes; // the index of the node
+    Node *next;                     // the next leaf node
+    Node *prev;                     // the previous leaf node
     std::variant<DataContent, ChildrenContent> content;
+    // #of index-data pairs below each child, for internal nodes
+    std::vector<size_t> counts;
 
-    Node(bool isLeaf) : isLeaf(isLeaf), indexes(), next(nullptr) {
+    Node(bool isLeaf)
+        : isLeaf(isLeaf), indexes(), next(nullptr), prev(nullptr) {
       if (isLeaf) {
         content = DataContent();
       } else {
         content = ChildrenContent();
       }
     }
-    // create a new node
-    static std::shared_ptr<Node> createLeaf() {
-      return std::make_shared<Node>(true);
-    }
-    static std::shared_ptr<Node> createInternal() {
-      return std::make_shared<Node>(false);
-    }
-    // for shared pointer
-    std::shared_ptr<Node> getShared() { return this->shared_from_this(); }
     // get the reference to the data or children
-    std::vector<std::shared_ptr<DataType>> &getData() {
-      return std::get<DataContent>(content);
-    }
-    std::vector<std::shared_ptr<Node>> &getChildren() {
+    std::vector<DataSlot> &getData() { return std::get<DataContent>(content); }
+    std::vector<Node *> &getChildren() {
       return std::get<ChildrenContent>(content);
     }
   };
 
-  using NodePtr = std::shared_ptr<Node>;
+  // Nodes are owned by the allocator and linked by raw pointers
+  using NodePtr = Node *;
+  using NodeAllocator = typename NodePolicy::template Allocator<Node>;
+  NodeAllocator nodes;
   NodePtr root;
   size_t maxIntChildren; // Limiting #of children for an internal Node
   size_t maxLeafIdxes;   // Limiting #of indexes for a leaf Node
 
+  // The internal nodes visited on the way down to a leaf, together with the
+  // child slot taken in each, so that splits and merges can walk back up
+  // without searching for the parent again
+  struct PathEntry {
+    NodePtr node;
+    size_t slot;
+  };
+  struct Path {
+    static constexpr size_t maxHeight = 64;
+    std::array<PathEntry, maxHeight> entries;
+    size_t depth = 0;
+
+    void push(NodePtr node, size_t slot) { entries[depth++] = {node, slot}; }
+    PathEntry pop() { return entries[--depth]; }
+    bool empty() const { return depth == 0; }
+    void clear() { depth = 0; }
+  };
+
+  // Position of the first index not less than (lowerBound) or greater than
+  // (upperBound) index within a node, SIMD for integral indexes and on the
+  // normalized prefixes for strings
+  static size_t lowerBound(const NodeIndexes<IndexType> &indexes,
+                           const IndexType &index) {
+    return indexes.lowerBound(index);
+  }
+  static size_t upperBound(const NodeIndexes<IndexType> &indexes,
+                           const IndexType &index) {
+    return indexes.upperBound(index);
+  }
+
+  // create a new node
+  NodePtr createLeaf() { return nodes.create(true); }
+  NodePtr createInternal() { return nodes.create(false); }
+  // Release a node and all of its descendants
+  void destroySubtree(NodePtr node);
   // Find the leaf node for index
   NodePtr findLeafNode(const IndexType &index) const;
-  // Find parent of a node
-  NodePtr findParent(NodePtr &child) const;
+  // Find the leaf node for index and record the path to it
+  NodePtr findLeafNode(const IndexType &index, Path &path) const;
+  // Find the leaf node for index, given the path to the leaf of a smaller
+  // index, which is reused down to the first node where the paths part
+  NodePtr findLeafFrom(const IndexType &index, Path &path) const;
   // Get the leftmost leaf node
   NodePtr getLeftmostLeaf() const;
+  // Get the rightmost leaf node
+  NodePtr getRightmostLeaf() const;
+  // #of index-data pairs below the node
+  static size_t subtreeCount(NodePtr node);
+  // #of indexes less than index, or not greater than it if orEqual
+  size_t countBelow(const IndexType &index, bool orEqual) const;
+  // Leaf and position of the i-th smallest index, nullptr if there is none
+  std::pair<NodePtr, size_t> locate(size_t i) const;
+  // Position of the nearest-rank percentile, size() if the tree is empty
+  size_t percentileRank(double fraction) const;
+  // Call visit(leaf, first, last) for the slice [first, last) of each leaf
+  // within the range, in index order, until it returns false
+  template <typename LeafVisitor>
+  void visitLeaves(const std::optional<IndexType> &minIndex,
+                   const std::optional<IndexType> &maxIndex,
+                   bool leftInclusive, bool rightInclusive,
+                   LeafVisitor visit) const;
   // Remove the index and data/children from the node
   void removeFromNode(NodePtr node, size_t pos);
+  // Insert into the leaf at pos and split it if it overflows
+  DataType &insertIntoLeaf(NodePtr leaf, size_t pos, const IndexType &index,
+                           DataSlot slot, Path &path);
   // Split the leaf node
-  void splitLeafNode(NodePtr leaf, const IndexType &index,
-                     std::shared_ptr<DataType> data);
+  void splitLeafNode(NodePtr leaf, Path &path);
   // Promote the child to parent
-  void promoteToParent(NodePtr left, const IndexType &index, NodePtr right);
+  void promoteToParent(NodePtr left, const IndexType &index, NodePtr right,
+                       Path &path);
   // Split the internal node
-  void splitInternalNode(NodePtr internal);
+  void splitInternalNode(NodePtr internal, Path &path);
   // Rebalance the tree
-  void delRebalance(NodePtr node, size_t idx);
+  void delRebalance(NodePtr node, size_t idx, Path &path);
+  // Remove the index at idx from the leaf at the end of path
+  void eraseFromLeaf(NodePtr leaf, size_t idx, Path &path);
   // Borrow a node from the sibling
   void borrowFromLeft(NodePtr node, NodePtr leftSibling, NodePtr parent,
                       size_t idx);
   void borrowFromRight(NodePtr node, NodePtr rightSibling, NodePtr parent,
                        size_t idx);
   // Merge the nodes
-  void mergeNodes(NodePtr left, NodePtr right, NodePtr parent, size_t idx);
+  void mergeNodes(NodePtr left, NodePtr right, NodePtr parent, size_t idx,
+                  Path &path);
 
 public:
+  /**
+   * @brief         Bidirectional iterator over the leaves in index order
+   *
+   * Dereferences to a pair of references to the index and its data. Like the
+   * pointers returned by search, it is invalidated by insertions and removals.
+   */
+  template <bool isConst> class LeafIterator {
+  public:
+    using DataRef = std::conditional_t<isConst, const DataType &, DataType &>;
+    using iterator_category = std::bidirectional_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = std::pair<const IndexType, DataType>;
+    using reference = std::pair<const IndexType &, DataRef>;
+    // operator-> returns the pair by value, wrapped so that it can be chained
+    struct pointer {
+      reference pair;
+      const reference *operator->() const { return &pair; }
+    };
+
+    LeafIterator() = default;
+    // an iterator converts to a const_iterator
+    template <bool otherConst,
+              typename = std::enable_if_t<isConst && !otherConst>>
+    LeafIterator(const LeafIterator<otherConst> &other)
+        : tree(other.tree), leaf(other.leaf), pos(other.pos) {}
+
+    const IndexType &index() const { return leaf->indexes[pos]; }
+    DataRef data() const { return slotData(leaf->getData()[pos]); }
+    reference operator*() const { return {index(), data()}; }
+    pointer operator->() const { return {**this}; }
+
+    LeafIterator &operator++() {
+      ++pos;
+      skipExhausted();
+      return *this;
+    }
+    LeafIterator operator++(int) {
+      LeafIterator old = *this;
+      ++*this;
+      return old;
+    }
+    // decrementing end() moves to the last index
+    LeafIterator &operator--() {
+      if (!leaf) {
+        leaf = tree->getRightmostLeaf();
+        pos = leaf->indexes.size();
+      }
+      while (pos == 0) {
+        leaf = leaf->prev;
+        pos = leaf->indexes.size();
+      }
+      --pos;
+      return *this;
+    }
+    LeafIterator operator--(int) {
+      LeafIterator old = *this;
+      --*this;
+      return old;
+    }
+
+    bool operator==(const LeafIterator &other) const {
+      return leaf == other.leaf && pos == other.pos;
+    }
+    bool operator!=(const LeafIterator &other) const {
+      return !(*this == other);
+    }
+
+  private:
+    friend class BpTree;
+    template <bool> friend class LeafIterator;
+
+    const BpTree *tree = nullptr;
+    NodePtr leaf = nullptr; // nullptr past the last index
+    size_t pos = 0;
+
+    LeafIterator(const BpTree *tree, NodePtr leaf, size_t pos)
+        : tree(tree), leaf(leaf), pos(pos) {
+      skipExhausted();
+    }
+    // past the end of a leaf is the start of the next one
+    void skipExhausted() {
+      while (leaf && pos == leaf->indexes.size()) {
+        leaf = leaf->next;
+        pos = 0;
+      }
+    }
+  };
+  using iterator = LeafIterator<false>;
+  using const_iterator = LeafIterator<true>;
+
+  // Integral indexes fill two cache lines per leaf, others 16 per leaf
   BpTree()
-      : root(std::make_shared<Node>(true)), maxIntChildren(17),
-        maxLeafIdxes(16) {}
+      : nodes(), root(createLeaf()),
+        maxIntChildren(NodeSearch<IndexType>::preferredKeys + 1),
+        maxLeafIdxes(NodeSearch<IndexType>::preferredKeys) {}
 
   BpTree(size_t order)
-      : root(std::make_shared<Node>(true)), maxIntChildren(order),
+      : nodes(), root(createLeaf()), maxIntChildren(order),
         maxLeafIdxes(order - 1) {}
 
   BpTree(size_t maxIntChildren, size_t maxLeafIdxes)
-      : root(std::make_shared<Node>(true)), maxIntChildren(maxIntChildren),
+      : nodes(), root(createLeaf()), maxIntChildren(maxIntChildren),
         maxLeafIdxes(maxLeafIdxes) {}
 
+  /**
+   * @brief         Build the tree from a range of index-data pairs sorted by
+   *                index, see bulkLoad
+   */
+  template <typename Iterator, typename = typename std::iterator_traits<
+                                   Iterator>::iterator_category>
+  BpTree(Iterator first, Iterator last,
+         size_t order = NodeSearch<IndexType>::preferredKeys + 1,
+         double fillFactor = 1.0)
+      : nodes(), root(createLeaf()), maxIntChildren(order),
+        maxLeafIdxes(order - 1) {
+    bulkLoad(first, last, fillFactor);
+  }
+
+  // The tree owns its nodes, so it can be moved but not copied. The
+  // moved-from tree is left empty, with a new root leaf of its own, and
+  // stays usable like a moved-from standard container.
+  BpTree(const BpTree &) = delete;
+  BpTree &operator=(const BpTree &) = delete;
+  BpTree(BpTree &&other) noexcept
+      : nodes(std::move(other.nodes)), root(std::exchange(other.root, nullptr)),
+        maxIntChildren(other.maxIntChildren),
+        maxLeafIdxes(other.maxLeafIdxes) {
+    other.root = other.createLeaf();
+  }
+  BpTree &operator=(BpTree &&other) noexcept {
+    if (this != &other) {
+      destroySubtree(root);
+      nodes = std::move(other.nodes);
+      root = std::exchange(other.root, nullptr);
+      maxIntChildren = other.maxIntChildren;
+      maxLeafIdxes = other.maxLeafIdxes;
+      other.root = other.createLeaf();
+    }
+    return *this;
+  }
+
+  ~BpTree() { destroySubtree(root); }
+
   /**
    * @brief         Insert a index-data pair into the B+ tree
    *
@@ -111,15 +329,53 @@ public:
    */
   bool erase(const IndexType &index);
 
+  /**
+   * @brief         Insert a batch of index-data pairs
+   *
+   * The batch is sorted first, so that consecutive pairs reuse the path down
+   * to the previous leaf instead of descending from the root. Pairs whose
+   * index exists, or came earlier in the batch, are skipped as in insert.
+   *
+   * @tparam        Iterator , yields pairs of (IndexType, DataType)
+   * @return        size_t, the number of pairs inserted
+   */
+  template <typename Iterator>
+  size_t insertBatch(Iterator first, Iterator last);
+
+  /**
+   * @brief         Remove a batch of indexes, sorted first like insertBatch
+   *
+   * @tparam        Iterator , yields IndexType
+   * @return        size_t, the number of indexes removed
+   */
+  template <typename Iterator> size_t eraseBatch(Iterator first, Iterator last);
+
+  /**
+   * @brief         Search for a batch of indexes
+   *
+   * The lookups descend in groups, one level at a time, and the nodes of the
+   * next level are prefetched for the whole group before any of them is
+   * searched, so that their cache misses overlap.
+   *
+   * @tparam        Iterator , yields IndexType
+   * @tparam        OutputIterator , receives one DataType * per index in
+   *                input order, nullptr if not found
+   */
+  template <typename Iterator, typename OutputIterator>
+  void searchBatch(Iterator first, Iterator last, OutputIterator out);
+
   /**
    * @brief         search for a specific index
    *
+   * The data is stored in the leaf, so the pointer is only valid until the
+   * next insertion or removal.
+   *
    * @tparam        IndexType
    * @tparam        DataType
    * @param         index
-   * @return        std::shared_ptr<DataType>, nullptr if not found
+   * @return        DataType *, nullptr if not found
    */
-  std::shared_ptr<DataType> search(const IndexType &index);
+  DataType *search(const IndexType &index);
 
   /**
    * @brief         Get the minimum index in the B+ tree
@@ -139,6 +395,70 @@ public:
    */
   IndexType getMax() const;
 
+  /**
+   * @brief         Iterators over all index-data pairs in index order
+   */
+  iterator begin() { return iterator(this, getLeftmostLeaf(), 0); }
+  iterator end() { return iterator(this, nullptr, 0); }
+  const_iterator begin() const {
+    return const_iterator(this, getLeftmostLeaf(), 0);
+  }
+  const_iterator end() const { return const_iterator(this, nullptr, 0); }
+
+  /**
+   * @brief         Iterator to the first index not less than index
+   *
+   * @param         index
+   * @return        iterator, end() if there is none
+   */
+  iterator lower_bound(const IndexType &index);
+  const_iterator lower_bound(const IndexType &index) const;
+
+  /**
+   * @brief         Iterator to the first index greater than index
+   *
+   * @param         index
+   * @return        iterator, end() if there is none
+   */
+  iterator upper_bound(const IndexType &index);
+  const_iterator upper_bound(const IndexType &index) const;
+
+  /**
+   * @brief         #of index-data pairs in the tree
+   */
+  size_t size() const { return subtreeCount(root); }
+
+  /**
+   * @brief         #of indexes less than index, from the subtree counts kept
+   *                in the internal nodes
+   *
+   * @param         index
+   * @return        size_t, the position index has or would have in order
+   */
+  size_t rank(const IndexType &index) const { return countBelow(index, false); }
+
+  /**
+   * @brief         The i-th smallest index, counting from 0
+   *
+   * @param         i
+   * @return        iterator, end() if i is not less than size()
+   */
+  iterator select(size_t i);
+  const_iterator select(size_t i) const;
+
+  /**
+   * @brief         Nearest-rank percentile of the indexes
+   *
+   * @param         fraction , in [0, 1]; 0 is the minimum, 1 the maximum
+   * @return        iterator, end() if the tree is empty
+   */
+  iterator percentile(double fraction) {
+    return select(percentileRank(fraction));
+  }
+  const_iterator percentile(double fraction) const {
+    return select(percentileRank(fraction));
+  }
+
   /**
    * @brief         Range query in the B+ tree
    *
@@ -146,17 +466,35 @@ public:
    * @tparam        DataType
    * @param         minIndex , if input is std::nullopt, start from the leftmost
    * @param         maxIndex , if input is std::nullopt, end at the rightmost
-   * @return        std::vector<std::shared_ptr<DataType>>
+   * @return        std::vector<DataType *>, valid until the next modification
    */
-  std::vector<std::shared_ptr<DataType>>
+  std::vector<DataType *>
   rangeQuery(const std::optional<IndexType> &minIndex,
              const std::optional<IndexType> &maxIndex,
              const bool &leftInclusive = true,
              const bool &rightInclusive = true);
 
+  /**
+   * @brief         Stream the index-data pairs in the range to a visitor in
+   *                index order, without collecting them
+   *
+   * @tparam        Visitor , called as visit(const IndexType &, DataType &);
+   *                if it returns bool, false stops the scan
+   * @param         minIndex , if input is std::nullopt, start from the leftmost
+   * @param         maxIndex , if input is std::nullopt, end at the rightmost
+   * @return        size_t, the number of pairs visited
+   */
+  template <typename Visitor>
+  size_t visitRange(const std::optional<IndexType> &minIndex,
+                    const std::optional<IndexType> &maxIndex, Visitor visit,
+                    bool leftInclusive = true, bool rightInclusive = true);
+
   /**
    * @brief         Count the number of indexes in the range
    *
+   * Both bounds are ranked with the subtree counts, so the cost does not
+   * depend on the number of indexes in the range.
+   *
    * @param         minIndex , if input is std::nullopt, start from the leftmost
    * @param         maxIndex , if input is std::nullopt, end at the rightmost
    * @return        size_t
@@ -166,6 +504,18 @@ public:
                     const bool &leftInclusive = true,
                     const bool &rightInclusive = true);
 
+  /**
+   * @brief         Visit up to count index-data pairs in index order, starting
+   *                at the first index not less than minIndex
+   *
+   * @tparam        Visitor , called as visit(const IndexType &, DataType &)
+   * @param         minIndex
+   * @param         count
+   * @return        size_t, the number of pairs visited
+   */
+  template <typename Visitor>
+  size_t scan(const IndexType &minIndex, size_t count, Visitor visit);
+
   /**
    * @brief         Print the B+ tree
    *
@@ -174,6 +524,56 @@ public:
    */
   void printTree() const;
 
+  // Occupancy of one level of the tree
+  struct LevelStats {
+    size_t nodes = 0;
+    size_t indexes = 0;
+    size_t capacity = 0; // indexes the nodes could hold
+  };
+
+  struct Stats {
+    size_t height = 0; // levels, the leaves included
+    size_t nodes = 0;
+    size_t leaves = 0;
+    size_t entries = 0;      // index-data pairs
+    double fillFactor = 0.0; // entries over what the leaves could hold
+    // from the root down to the leaves
+    std::vector<LevelStats> levels;
+  };
+
+  /**
+   * @brief         Shape of the tree: node count, height, fill factor and
+   *                occupancy per level, in one walk over the nodes
+   */
+  Stats stats() const;
+
+  /**
+   * @brief         Replace the content of the tree with a sorted range
+   *
+   * Leaves are filled left to right and the internal levels are built bottom
+   * up, so the whole load is a single pass without any splits. Only the first
+   * of several pairs with the same index is kept.
+   *
+   * @tparam        Iterator , yields pairs of (IndexType, DataType)
+   * @param         first
+   * @param         last
+   * @param         fillFactor , fraction of each node to fill, leave room for
+   *                later inserts with a value below 1
+   */
+  template <typename Iterator>
+  void bulkLoad(Iterator first, Iterator last, double fillFactor = 1.0);
+
+  /**
+   * @brief         Sort a copy of the range by index in parallel, then
+   *                bulkLoad it
+   *
+   * @param         threads , #of threads used for sorting
+   */
+  template <typename Iterator>
+  void bulkLoadUnsorted(Iterator first, Iterator last,
+                        size_t threads = std::thread::hardware_concurrency(),
+                        double fillFactor = 1.0);
+
   /**
    * @brief Overload the [] operator for insert, search, and update
    *
@@ -5,87 +5,206 @@
 #include "BpTree.h"
 
 #include <algorithm>
+#include <array>
 #include <cmath>
 #include <cstddef>
 #include <iostream>
 #include <memory>
 #include <optional>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+// Release a node and all of its descendants
+template <typename IndexType, typename DataType, typename NodePolicy>
+void BpTree<IndexType, DataType, NodePolicy>::destroySubtree(NodePtr node) {
+  if (!node)
+    return;
+  if (!node->isLeaf) {
+    for (NodePtr child : node->getChildren())
+      destroySubtree(child);
+  }
+  nodes.destroy(node);
+}
+
 // Find the leaf node for index
-template <typename IndexType, typename DataType>
-typename BpTree<IndexType, DataType>::NodePtr
-BpTree<IndexType, DataType>::findLeafNode(const IndexType &index) const {
-  if (root->isLeaf)
-    return root;
-  Node *current = root.get(); // get the raw pointer for faster traversal
-  while (true) {
+template <typename IndexType, typename DataType, typename NodePolicy>
+typename BpTree<IndexType, DataType, NodePolicy>::NodePtr
+BpTree<IndexType, DataType, NodePolicy>::findLeafNode(
+    const IndexType &index) const {
+  NodePtr current = root;
+  while (!current->isLeaf) {
     auto &children = current->getChildren();
-    auto it = std::upper_bound(current->indexes.begin(), current->indexes.end(),
-                               index); // binary search to find the first
-                                       // element greater than index
-    size_t idxChild = (size_t)std::distance(current->indexes.begin(), it);
+    // the first element greater than index
+    size_t idxChild = upperBound(current->indexes, index);
     // set the current node to the last element less than index
-    if (children[idxChild]->isLeaf) {
-      return children[idxChild];
-    } else {
-      current = children[idxChild].get();
-    }
+    current = children[idxChild];
   }
+  return current;
 }
 
-// Find the parent of a node
-template <typename IndexType, typename DataType>
-typename BpTree<IndexType, DataType>::NodePtr
-BpTree<IndexType, DataType>::findParent(NodePtr &child) const {
-  if (child.get() == root.get())
-    return nullptr;
+// Find the leaf node for index and record the path to it
+template <typename IndexType, typename DataType, typename NodePolicy>
+typename BpTree<IndexType, DataType, NodePolicy>::NodePtr
+BpTree<IndexType, DataType, NodePolicy>::findLeafNode(const IndexType &index,
+                                                      Path &path) const {
+  NodePtr current = root;
+  while (!current->isLeaf) {
+    size_t idxChild = upperBound(current->indexes, index);
+    path.push(current, idxChild);
+    current = current->getChildren()[idxChild];
+  }
+  return current;
+}
 
-  NodePtr parent = root;
+// Find the leaf node for index, reusing the path to a smaller index
+template <typename IndexType, typename DataType, typename NodePolicy>
+typename BpTree<IndexType, DataType, NodePolicy>::NodePtr
+BpTree<IndexType, DataType, NodePolicy>::findLeafFrom(const IndexType &index,
+                                                      Path &path) const {
+  // index is not less than the previous one, so it takes the same child as
+  // long as it is less than the index right of the slot taken
+  size_t depth = 0;
+  for (; depth < path.depth; ++depth) {
+    auto [node, slot] = path.entries[depth];
+    if (slot < node->indexes.size() && !(index < node->indexes[slot]))
+      break;
+  }
   NodePtr current = root;
+  if (depth < path.depth) {
+    current = path.entries[depth].node;
+    path.depth = depth;
+  } else if (depth > 0) {
+    auto [parent, slot] = path.entries[depth - 1];
+    return parent->getChildren()[slot];
+  }
   while (!current->isLeaf) {
-    parent = current;
-    auto it = std::upper_bound(current->indexes.begin(), current->indexes.end(),
-                               child->indexes.front());
-    size_t idxChild = (size_t)std::distance(current->indexes.begin(), it);
-    auto &closestChild = current->getChildren()[idxChild];
-    if (closestChild.get() == child.get())
-      return parent;
-    current = closestChild;
+    size_t idxChild = upperBound(current->indexes, index);
+    path.push(current, idxChild);
+    current = current->getChildren()[idxChild];
   }
-  return parent; // return the supposed parent if child is not found
+  return current;
 }
 
 // Get the leftmost leaf node
-template <typename IndexType, typename DataType>
-typename BpTree<IndexType, DataType>::NodePtr
-BpTree<IndexType, DataType>::getLeftmostLeaf() const {
-  if (root->isLeaf)
-    return root;
-  Node *current = root.get();
-  while (true) {
-    current = current->getChildren().front().get();
-    if (current->isLeaf)
-      return current->getShared();
+template <typename IndexType, typename DataType, typename NodePolicy>
+typename BpTree<IndexType, DataType, NodePolicy>::NodePtr
+BpTree<IndexType, DataType, NodePolicy>::getLeftmostLeaf() const {
+  NodePtr current = root;
+  while (!current->isLeaf) {
+    current = current->getChildren().front();
+  }
+  return current;
+}
+
+// Get the rightmost leaf node
+template <typename IndexType, typename DataType, typename NodePolicy>
+typename BpTree<IndexType, DataType, NodePolicy>::NodePtr
+BpTree<IndexType, DataType, NodePolicy>::getRightmostLeaf() const {
+  NodePtr current = root;
+  while (!current->isLeaf) {
+    current = current->getChildren().back();
+  }
+  return current;
+}
+
+// #of index-data pairs below the node
+template <typename IndexType, typename DataType, typename NodePolicy>
+size_t BpTree<IndexType, DataType, NodePolicy>::subtreeCount(NodePtr node) {
+  if (node->isLeaf)
+    return node->indexes.size();
+  size_t count = 0;
+  for (size_t childCount : node->counts)
+    count += childCount;
+  return count;
+}
+
+// #of indexes less than (or not greater than) index: the children left of
+// the path are added by their counts
+template <typename IndexType, typename DataType, typename NodePolicy>
+size_t
+BpTree<IndexType, DataType, NodePolicy>::countBelow(const IndexType &index,
+                                                    bool orEqual) const {
+  size_t below = 0;
+  NodePtr current = root;
+  while (!current->isLeaf) {
+    size_t idxChild = upperBound(current->indexes, index);
+    for (size_t i = 0; i < idxChild; ++i)
+      below += current->counts[i];
+    current = current->getChildren()[idxChild];
+  }
+  return below + (orEqual ? upperBound(current->indexes, index)
+                          : lowerBound(current->indexes, index));
+}
+
+// Leaf and position of the i-th smallest index
+template <typename IndexType, typename DataType, typename NodePolicy>
+std::pair<typename BpTree<IndexType, DataType, NodePolicy>::NodePtr, size_t>
+BpTree<IndexType, DataType, NodePolicy>::locate(size_t i) const {
+  if (i >= size())
+    return {nullptr, 0};
+  NodePtr current = root;
+  while (!current->isLeaf) {
+    size_t idxChild = 0;
+    while (i >= current->counts[idxChild])
+      i -= current->counts[idxChild++];
+    current = current->getChildren()[idxChild];
   }
+  return {current, i};
+}
+
+// Position of the nearest-rank percentile
+template <typename IndexType, typename DataType, typename NodePolicy>
+size_t BpTree<IndexType, DataType, NodePolicy>::percentileRank(
+    double fraction) const {
+  size_t count = size();
+  double ordinal = std::ceil(std::clamp(fraction, 0.0, 1.0) * (double)count);
+  return count == 0 || ordinal < 1 ? 0 : (size_t)ordinal - 1;
 }
 
 // Remove the index and data from the node
-template <typename IndexType, typename DataType>
-void BpTree<IndexType, DataType>::removeFromNode(NodePtr node, size_t pos) {
+template <typename IndexType, typename DataType, typename NodePolicy>
+void BpTree<IndexType, DataType, NodePolicy>::removeFromNode(NodePtr node,
+                                                             size_t pos) {
   node->indexes.erase(node->indexes.begin() + (long)pos);
   if (node->isLeaf) {
     node->getData().erase(node->getData().begin() + (long)pos);
   } else {
     node->getChildren().erase(node->getChildren().begin() + (long)pos + 1);
+    node->counts.erase(node->counts.begin() + (long)pos + 1);
   }
 }
 
+// Insert into the leaf at pos and split it if it overflows
+template <typename IndexType, typename DataType, typename NodePolicy>
+DataType &BpTree<IndexType, DataType, NodePolicy>::insertIntoLeaf(
+    NodePtr leaf, size_t pos, const IndexType &index, DataSlot slot,
+    Path &path) {
+  // the pair is added below every node on the path
+  for (size_t depth = 0; depth < path.depth; ++depth)
+    ++path.entries[depth].node->counts[path.entries[depth].slot];
+  bool isOverflow = (leaf->indexes.size() >= maxLeafIdxes);
+  // insert the index and data (even if overflow, since we'll split later)
+  leaf->indexes.insert(leaf->indexes.begin() + (long)pos, index);
+  leaf->getData().insert(leaf->getData().begin() + (long)pos,
+                         std::move(slot));
+  if (isOverflow) {
+    // the upper half moves to the new leaf, follow the data if it went there
+    size_t splitPoint = leaf->indexes.size() / 2;
+    splitLeafNode(leaf, path);
+    if (pos >= splitPoint) {
+      leaf = leaf->next;
+      pos -= splitPoint;
+    }
+  }
+  return slotData(leaf->getData()[pos]);
+}
+
 // Split the leaf node
-template <typename IndexType, typename DataType>
-void BpTree<IndexType, DataType>::splitLeafNode(
-    NodePtr leaf, const IndexType &index, std::shared_ptr<DataType> data) {
-  NodePtr newLeaf = Node::createLeaf(); // create a new leaf node
+template <typename IndexType, typename DataType, typename NodePolicy>
+void BpTree<IndexType, DataType, NodePolicy>::splitLeafNode(NodePtr leaf,
+                                                            Path &path) {
+  NodePtr newLeaf = createLeaf(); // create a new leaf node
   auto splitPoint = static_cast<long>(leaf->indexes.size() / 2);
   newLeaf->indexes.assign(leaf->indexes.begin() + splitPoint,
                           leaf->indexes.end());
@@ -95,54 +214,61 @@ void BpTree<IndexType, DataType>::splitLeafNode(
 
   // resize the original leaf
   leaf->indexes.resize((size_t)splitPoint);
-  leaf->getData().resize((size_t)splitPoint);
+  leaf->getData().erase(leaf->getData().begin() + splitPoint,
+                        leaf->getData().end());
 
-  // update the next pointer
+  // link the new leaf in after the original one
   newLeaf->next = leaf->next;
+  newLeaf->prev = leaf;
+  if (leaf->next)
+    leaf->next->prev = newLeaf;
   leaf->next = newLeaf;
 
   // Promote the smallest index of the new leaf to the parent
-  promoteToParent(leaf, newLeaf->indexes.front(), newLeaf);
+  promoteToParent(leaf, newLeaf->indexes.front(), newLeaf, path);
 }
 
 // Promote the child to parent
-template <typename IndexType, typename DataType>
-void BpTree<IndexType, DataType>::promoteToParent(NodePtr left,
-                                                  const IndexType &index,
-                                                  NodePtr right) {
-  if (left.get() == root.get()) {
-    NodePtr newRoot = Node::createInternal();
+template <typename IndexType, typename DataType, typename NodePolicy>
+void BpTree<IndexType, DataType, NodePolicy>::promoteToParent(
+    NodePtr left, const IndexType &index, NodePtr right, Path &path) {
+  if (path.empty()) {
+    NodePtr newRoot = createInternal();
     // set the indexes and children
     newRoot->indexes.emplace_back(index);
-    newRoot->getChildren().emplace_back(std::move(left));
-    newRoot->getChildren().emplace_back(std::move(right));
+    newRoot->getChildren().emplace_back(left);
+    newRoot->getChildren().emplace_back(right);
+    newRoot->counts = {subtreeCount(left), subtreeCount(right)};
     // when internal node is generated, it has 1 index and 2 children
     // so num_children = num_indexes + 1
-    root = std::move(newRoot);
+    root = newRoot;
     return;
   }
 
-  NodePtr parent = findParent(left);
+  // the parent and the slot of left in it were recorded on the way down
+  auto [parent, idx] = path.pop();
 
   // insert the index and the right child
-  auto it =
-      std::lower_bound(parent->indexes.begin(), parent->indexes.end(), index);
-  auto idx = std::distance(parent->indexes.begin(), it);
-  parent->indexes.insert(it, index);
-  auto itChild = parent->getChildren().begin() + idx + 1;
-  parent->getChildren().insert(itChild, std::move(right));
+  parent->indexes.insert(parent->indexes.begin() + (long)idx, index);
+  auto itChild = parent->getChildren().begin() + (long)idx + 1;
+  parent->getChildren().insert(itChild, right);
+  // the pairs below left are now split between left and right
+  parent->counts[idx] = subtreeCount(left);
+  parent->counts.insert(parent->counts.begin() + (long)idx + 1,
+                        subtreeCount(right));
 
   // check if the parent is overflowing
   if (parent->indexes.size() >= maxIntChildren) {
-    splitInternalNode(parent);
+    splitInternalNode(parent, path);
   }
 }
 
 // Split the internal node
-template <typename IndexType, typename DataType>
-void BpTree<IndexType, DataType>::splitInternalNode(NodePtr internal) {
+template <typename IndexType, typename DataType, typename NodePolicy>
+void BpTree<IndexType, DataType, NodePolicy>::splitInternalNode(
+    NodePtr internal, Path &path) {
   // create a new internal node
-  NodePtr newInternal = Node::createInternal();
+  NodePtr newInternal = createInternal();
   // calculate the split point
   auto splitPoint =
       static_cast<typename std::vector<IndexType>::difference_type>(
@@ -152,8 +278,10 @@ void BpTree<IndexType, DataType>::splitInternalNode(NodePtr internal) {
   newInternal->indexes.assign(internal->indexes.begin() + splitPoint + 1,
                               internal->indexes.end());
   newInternal->getChildren().assign(
-      std::make_move_iterator(internal->getChildren().begin() + splitPoint + 1),
-      std::make_move_iterator(internal->getChildren().end()));
+      internal->getChildren().begin() + splitPoint + 1,
+      internal->getChildren().end());
+  newInternal->counts.assign(internal->counts.begin() + splitPoint + 1,
+                             internal->counts.end());
 
   // get the middle index to be promoted
   IndexType promotedIndex = internal->indexes[(size_t)splitPoint];
@@ -161,14 +289,17 @@ void BpTree<IndexType, DataType>::splitInternalNode(NodePtr internal) {
   // resize the original internal
   internal->indexes.resize((size_t)splitPoint);
   internal->getChildren().resize((size_t)splitPoint + 1);
+  internal->counts.resize((size_t)splitPoint + 1);
 
   // Promote the child to parent
-  promoteToParent(internal, promotedIndex, std::move(newInternal));
+  promoteToParent(internal, promotedIndex, newInternal, path);
 }
 
 // Rebalance the tree
-template <typename IndexType, typename DataType>
-void BpTree<IndexType, DataType>::delRebalance(NodePtr node, size_t idx) {
+template <typename IndexType, typename DataType, typename NodePolicy>
+void BpTree<IndexType, DataType, NodePolicy>::delRebalance(NodePtr node,
+                                                           size_t idx,
+                                                           Path &path) {
   // check if the leaf node is underflowing
   size_t minSize = maxLeafIdxes / 2;
   if (node->indexes.size() - 1 >= minSize) {
@@ -180,16 +311,14 @@ void BpTree<IndexType, DataType>::delRebalance(NodePtr node, size_t idx) {
   if (node == root) {
     removeFromNode(node, idx);
     if (!node->isLeaf && node->indexes.empty()) {
-      root = std::move(node->getChildren()[0]);
+      root = node->getChildren()[0];
+      nodes.destroy(node); // recycle the old root
     }
     return;
   }
   // get the parent, left and right siblings
-  NodePtr parent = findParent(node);
-  auto it = std::upper_bound(parent->indexes.begin(), parent->indexes.end(),
-                             node->indexes.back());
+  auto [parent, idxParent] = path.pop();
   removeFromNode(node, idx);
-  size_t idxParent = (size_t)std::distance(parent->indexes.begin(), it);
   NodePtr leftSibling =
       (idxParent > 0) ? parent->getChildren()[idxParent - 1] : nullptr;
   NodePtr rightSibling = (idxParent < parent->indexes.size())
@@ -200,17 +329,16 @@ void BpTree<IndexType, DataType>::delRebalance(NodePtr node, size_t idx) {
   } else if (rightSibling && rightSibling->indexes.size() > minSize) {
     borrowFromRight(node, rightSibling, parent, idxParent);
   } else if (leftSibling) {
-    mergeNodes(leftSibling, node, parent, idxParent - 1);
+    mergeNodes(leftSibling, node, parent, idxParent - 1, path);
   } else {
-    mergeNodes(node, rightSibling, parent, idxParent);
+    mergeNodes(node, rightSibling, parent, idxParent, path);
   }
 }
 
 // Borrow a node from the left sibling
-template <typename IndexType, typename DataType>
-void BpTree<IndexType, DataType>::borrowFromLeft(NodePtr node,
-                                                 NodePtr leftSibling,
-                                                 NodePtr parent, size_t idx) {
+template <typename IndexType, typename DataType, typename NodePolicy>
+void BpTree<IndexType, DataType, NodePolicy>::borrowFromLeft(
+    NodePtr node, NodePtr leftSibling, NodePtr parent, size_t idx) {
   if (node->isLeaf) {
     node->indexes.insert(node->indexes.begin(), leftSibling->indexes.back());
     node->getData().insert(node->getData().begin(),
@@ -218,43 +346,55 @@ void BpTree<IndexType, DataType>::borrowFromLeft(NodePtr node,
     leftSibling->indexes.pop_back();
     leftSibling->getData().pop_back();
     // update the parent index
-    parent->indexes[idx] = node->indexes.front();
+    parent->indexes.set(idx, node->indexes.front());
+    --parent->counts[idx];
+    ++parent->counts[idx + 1];
   } else {
     node->indexes.insert(node->indexes.begin(), parent->indexes[idx]);
     node->getChildren().insert(node->getChildren().begin(),
-                               std::move(leftSibling->getChildren().back()));
+                               leftSibling->getChildren().back());
+    size_t moved = leftSibling->counts.back();
+    node->counts.insert(node->counts.begin(), moved);
     // update the parent index
-    parent->indexes[idx] = leftSibling->indexes.back();
+    parent->indexes.set(idx, leftSibling->indexes.back());
     leftSibling->indexes.pop_back();
     leftSibling->getChildren().pop_back();
+    leftSibling->counts.pop_back();
+    parent->counts[idx] -= moved;
+    parent->counts[idx + 1] += moved;
   }
 }
 
 // Borrow a node from the right sibling
-template <typename IndexType, typename DataType>
-void BpTree<IndexType, DataType>::borrowFromRight(NodePtr node,
-                                                  NodePtr rightSibling,
-                                                  NodePtr parent, size_t idx) {
+template <typename IndexType, typename DataType, typename NodePolicy>
+void BpTree<IndexType, DataType, NodePolicy>::borrowFromRight(
+    NodePtr node, NodePtr rightSibling, NodePtr parent, size_t idx) {
   if (node->isLeaf) {
     node->indexes.emplace_back(rightSibling->indexes.front());
     node->getData().emplace_back(std::move(rightSibling->getData().front()));
     rightSibling->indexes.erase(rightSibling->indexes.begin());
     rightSibling->getData().erase(rightSibling->getData().begin());
-    parent->indexes[idx] = rightSibling->indexes.front();
+    parent->indexes.set(idx, rightSibling->indexes.front());
+    ++parent->counts[idx];
+    --parent->counts[idx + 1];
   } else {
     node->indexes.emplace_back(parent->indexes[idx]);
-    node->getChildren().emplace_back(
-        std::move(rightSibling->getChildren().front()));
-    parent->indexes[idx] = rightSibling->indexes.front();
+    node->getChildren().emplace_back(rightSibling->getChildren().front());
+    size_t moved = rightSibling->counts.front();
+    node->counts.emplace_back(moved);
+    parent->indexes.set(idx, rightSibling->indexes.front());
     rightSibling->indexes.erase(rightSibling->indexes.begin());
     rightSibling->getChildren().erase(rightSibling->getChildren().begin());
+    rightSibling->counts.erase(rightSibling->counts.begin());
+    parent->counts[idx] += moved;
+    parent->counts[idx + 1] -= moved;
   }
 }
 
 // Merge the sibling nodes
-template <typename IndexType, typename DataType>
-void BpTree<IndexType, DataType>::mergeNodes(NodePtr left, NodePtr right,
-                                             NodePtr parent, size_t idx) {
+template <typename IndexType, typename DataType, typename NodePolicy>
+void BpTree<IndexType, DataType, NodePolicy>::mergeNodes(
+    NodePtr left, NodePtr right, NodePtr parent, size_t idx, Path &path) {
   if (left->isLeaf) {
     // merge the indexes and data
     left->indexes.insert(left->indexes.end(), right->indexes.begin(),
@@ -262,176 +402,358 @@ void BpTree<IndexType, DataType>::mergeNodes(NodePtr left, NodePtr right,
     left->getData().insert(left->getData().end(),
                            std::make_move_iterator(right->getData().begin()),
                            std::make_move_iterator(right->getData().end()));
-    // update the next pointer
-    left->next = std::move(right->next);
+    // unlink the right leaf
+    left->next = right->next;
+    if (right->next)
+      right->next->prev = left;
   } else {
     // merge the indexes and children
     left->indexes.emplace_back(parent->indexes[idx]);
     left->indexes.insert(left->indexes.end(), right->indexes.begin(),
                          right->indexes.end());
-    left->getChildren().insert(
-        left->getChildren().end(),
-        std::make_move_iterator(right->getChildren().begin()),
-        std::make_move_iterator(right->getChildren().end()));
+    left->getChildren().insert(left->getChildren().end(),
+                               right->getChildren().begin(),
+                               right->getChildren().end());
+    left->counts.insert(left->counts.end(), right->counts.begin(),
+                        right->counts.end());
   }
-  delRebalance(parent, idx);
+  // the slot of right is removed from the parent below
+  parent->counts[idx] += parent->counts[idx + 1];
+  // the right node is now empty, hand its slot back to the allocator
+  nodes.destroy(right);
+  delRebalance(parent, idx, path);
 }
 
 // Insert a index-data pair into the B+ tree
-template <typename IndexType, typename DataType>
-bool BpTree<IndexType, DataType>::insert(const IndexType &index,
-                                         const DataType &data) {
+template <typename IndexType, typename DataType, typename NodePolicy>
+bool BpTree<IndexType, DataType, NodePolicy>::insert(const IndexType &index,
+                                                     const DataType &data) {
   // find the leaf node containing the index
-  NodePtr leaf = findLeafNode(index);
+  Path path;
+  NodePtr leaf = findLeafNode(index, path);
 
-  bool isOverflow = (leaf->indexes.size() >= maxLeafIdxes);
-
-  auto it = std::lower_bound(leaf->indexes.begin(), leaf->indexes.end(), index);
-  if (it != leaf->indexes.end() && *it == index) {
+  size_t idx = lowerBound(leaf->indexes, index);
+  if (idx < leaf->indexes.size() && leaf->indexes[idx] == index) {
     return false; // duplicate index
   }
-  // insert the index and data (even if overflow, since we'll split later)
-  auto idx = std::distance(leaf->indexes.begin(), it);
-  leaf->indexes.insert(it, index);
-  auto ptr = std::make_shared<DataType>(data);
-  auto it_data = leaf->getData().begin() + idx;
-  leaf->getData().insert(it_data, ptr);
-
-  if (isOverflow)
-    splitLeafNode(leaf, index, ptr);
-
+  insertIntoLeaf(leaf, idx, index, makeSlot(data), path);
   return true;
 }
 
 // Remove a node with index from the B+ tree
-template <typename IndexType, typename DataType>
-bool BpTree<IndexType, DataType>::erase(const IndexType &index) {
+template <typename IndexType, typename DataType, typename NodePolicy>
+bool BpTree<IndexType, DataType, NodePolicy>::erase(const IndexType &index) {
   if (!root)
     return false;
   // find the leaf node containing the index
-  NodePtr leaf = findLeafNode(index);
-  auto it = std::lower_bound(leaf->indexes.begin(), leaf->indexes.end(), index);
-  if (it == leaf->indexes.end() || *it != index) {
-    return false; // Index not found
-  }
+  Path path;
+  NodePtr leaf = findLeafNode(index, path);
   // find the idx to remove
-  auto idx = std::distance(leaf->indexes.begin(), it);
-  if ((leaf == root) && (leaf->indexes.empty())) {
-    root = Node::createLeaf();
-    return true;
+  size_t idx = lowerBound(leaf->indexes, index);
+  if (idx == leaf->indexes.size() || leaf->indexes[idx] != index) {
+    return false; // Index not found
   }
-  // del and rebalance the tree after deletion
-  delRebalance(leaf, (size_t)idx);
+  eraseFromLeaf(leaf, idx, path);
   return true;
 }
 
+// Remove the index at idx from the leaf at the end of path
+template <typename IndexType, typename DataType, typename NodePolicy>
+void BpTree<IndexType, DataType, NodePolicy>::eraseFromLeaf(NodePtr leaf,
+                                                            size_t idx,
+                                                            Path &path) {
+  // the pair is removed from below every node on the path
+  for (size_t depth = 0; depth < path.depth; ++depth)
+    --path.entries[depth].node->counts[path.entries[depth].slot];
+  // del and rebalance the tree after deletion
+  delRebalance(leaf, idx, path);
+}
+
+// Insert a batch of index-data pairs in index order
+template <typename IndexType, typename DataType, typename NodePolicy>
+template <typename Iterator>
+size_t BpTree<IndexType, DataType, NodePolicy>::insertBatch(Iterator first,
+                                                            Iterator last) {
+  std::vector<Iterator> order;
+  for (; first != last; ++first)
+    order.emplace_back(first);
+  // stable, so that the first of several pairs with the same index wins
+  std::stable_sort(order.begin(), order.end(),
+                   [](const Iterator &a, const Iterator &b) {
+                     return a->first < b->first;
+                   });
+  size_t inserted = 0;
+  Path path;
+  for (const Iterator &it : order) {
+    NodePtr leaf = findLeafFrom(it->first, path);
+    size_t idx = lowerBound(leaf->indexes, it->first);
+    if (idx < leaf->indexes.size() && leaf->indexes[idx] == it->first)
+      continue; // duplicate index
+    bool splits = leaf->indexes.size() >= maxLeafIdxes;
+    insertIntoLeaf(leaf, idx, it->first, makeSlot(it->second), path);
+    if (splits)
+      path.clear(); // the nodes on the path have changed
+    ++inserted;
+  }
+  return inserted;
+}
+
+// Remove a batch of indexes in index order
+template <typename IndexType, typename DataType, typename NodePolicy>
+template <typename Iterator>
+size_t BpTree<IndexType, DataType, NodePolicy>::eraseBatch(Iterator first,
+                                                           Iterator last) {
+  std::vector<Iterator> order;
+  for (; first != last; ++first)
+    order.emplace_back(first);
+  std::sort(order.begin(), order.end(),
+            [](const Iterator &a, const Iterator &b) { return *a < *b; });
+  size_t erased = 0;
+  Path path;
+  for (const Iterator &it : order) {
+    NodePtr leaf = findLeafFrom(*it, path);
+    size_t idx = lowerBound(leaf->indexes, *it);
+    if (idx == leaf->indexes.size() || leaf->indexes[idx] != *it)
+      continue; // Index not found
+    // an underflowing leaf borrows or merges, which changes the path
+    bool rebalances = leaf->indexes.size() - 1 < maxLeafIdxes / 2;
+    eraseFromLeaf(leaf, idx, path);
+    if (rebalances)
+      path.clear();
+    ++erased;
+  }
+  return erased;
+}
+
+// Search for a batch of indexes in groups that descend level by level
+template <typename IndexType, typename DataType, typename NodePolicy>
+template <typename Iterator, typename OutputIterator>
+void BpTree<IndexType, DataType, NodePolicy>::searchBatch(Iterator first,
+                                                          Iterator last,
+                                                          OutputIterator out) {
+  constexpr size_t groupSize = 16;
+  std::array<Iterator, groupSize> group;
+  std::array<NodePtr, groupSize> current;
+  while (first != last) {
+    size_t size = 0;
+    for (; size < groupSize && first != last; ++size, ++first) {
+      group[size] = first;
+      current[size] = root;
+    }
+    // every leaf is at the same depth, so the group moves down together
+    while (!current[0]->isLeaf) {
+      for (size_t i = 0; i < size; ++i) {
+        current[i]->indexes.prefetch();
+        __builtin_prefetch(current[i]->getChildren().data());
+      }
+      for (size_t i = 0; i < size; ++i) {
+        size_t idxChild = upperBound(current[i]->indexes, *group[i]);
+        current[i] = current[i]->getChildren()[idxChild];
+        __builtin_prefetch(current[i]);
+      }
+    }
+    for (size_t i = 0; i < size; ++i)
+      current[i]->indexes.prefetch();
+    for (size_t i = 0; i < size; ++i) {
+      NodePtr leaf = current[i];
+      size_t idx = lowerBound(leaf->indexes, *group[i]);
+      bool found =
+          idx < leaf->indexes.size() && leaf->indexes[idx] == *group[i];
+      *out++ = found ? &slotData(leaf->getData()[idx]) : nullptr;
+    }
+  }
+}
+
 // Search for a specific index
-template <typename IndexType, typename DataType>
-std::shared_ptr<DataType>
-BpTree<IndexType, DataType>::search(const IndexType &index) {
+template <typename IndexType, typename DataType, typename NodePolicy>
+DataType *
+BpTree<IndexType, DataType, NodePolicy>::search(const IndexType &index) {
   // find the leaf node containing the index
   NodePtr leaf = findLeafNode(index);
   // find the index in the leaf node
-  auto it = std::lower_bound(leaf->indexes.begin(), leaf->indexes.end(), index);
-  if (it != leaf->indexes.end() && *it == index) {
-    auto idx = std::distance(leaf->indexes.begin(), it);
-    return leaf->getData()[(size_t)idx];
+  size_t idx = lowerBound(leaf->indexes, index);
+  if (idx < leaf->indexes.size() && leaf->indexes[idx] == index) {
+    return &slotData(leaf->getData()[idx]);
   }
   return nullptr;
 }
 
 // Get the minimum index in the B+ tree
-template <typename IndexType, typename DataType>
-IndexType BpTree<IndexType, DataType>::getMin() const {
+template <typename IndexType, typename DataType, typename NodePolicy>
+IndexType BpTree<IndexType, DataType, NodePolicy>::getMin() const {
   NodePtr current = getLeftmostLeaf();
   return current->indexes.front();
 }
 
 // Get the maximum index in the B+ tree
-template <typename IndexType, typename DataType>
-IndexType BpTree<IndexType, DataType>::getMax() const {
-  NodePtr current = root;
-  while (!current->isLeaf) {
-    current = current->getChildren().back();
-  }
+template <typename IndexType, typename DataType, typename NodePolicy>
+IndexType BpTree<IndexType, DataType, NodePolicy>::getMax() const {
+  NodePtr current = getRightmostLeaf();
   return current->indexes.back();
 }
 
-// Range query in the B+ tree
-template <typename IndexType, typename DataType>
-std::vector<std::shared_ptr<DataType>> BpTree<IndexType, DataType>::rangeQuery(
+// Iterator to the first index not less than index
+template <typename IndexType, typename DataType, typename NodePolicy>
+typename BpTree<IndexType, DataType, NodePolicy>::iterator
+BpTree<IndexType, DataType, NodePolicy>::lower_bound(const IndexType &index) {
+  NodePtr leaf = findLeafNode(index);
+  return iterator(this, leaf, lowerBound(leaf->indexes, index));
+}
+
+template <typename IndexType, typename DataType, typename NodePolicy>
+typename BpTree<IndexType, DataType, NodePolicy>::const_iterator
+BpTree<IndexType, DataType, NodePolicy>::lower_bound(
+    const IndexType &index) const {
+  NodePtr leaf = findLeafNode(index);
+  return const_iterator(this, leaf, lowerBound(leaf->indexes, index));
+}
+
+// Iterator to the first index greater than index
+template <typename IndexType, typename DataType, typename NodePolicy>
+typename BpTree<IndexType, DataType, NodePolicy>::iterator
+BpTree<IndexType, DataType, NodePolicy>::upper_bound(const IndexType &index) {
+  NodePtr leaf = findLeafNode(index);
+  return iterator(this, leaf, upperBound(leaf->indexes, index));
+}
+
+template <typename IndexType, typename DataType, typename NodePolicy>
+typename BpTree<IndexType, DataType, NodePolicy>::const_iterator
+BpTree<IndexType, DataType, NodePolicy>::upper_bound(
+    const IndexType &index) const {
+  NodePtr leaf = findLeafNode(index);
+  return const_iterator(this, leaf, upperBound(leaf->indexes, index));
+}
+
+// Walk the leaves of a range. The bounds are searched for in the first and
+// the last leaf only, every leaf in between is taken as a whole.
+template <typename IndexType, typename DataType, typename NodePolicy>
+template <typename LeafVisitor>
+void BpTree<IndexType, DataType, NodePolicy>::visitLeaves(
     const std::optional<IndexType> &minIndex,
-    const std::optional<IndexType> &maxIndex, const bool &leftInclusive,
-    const bool &rightInclusive) {
-  std::vector<std::shared_ptr<DataType>> result;
+    const std::optional<IndexType> &maxIndex, bool leftInclusive,
+    bool rightInclusive, LeafVisitor visit) const {
   // Start from the leaf node containing minIndex or the leftmost leaf
   NodePtr current = minIndex ? findLeafNode(*minIndex) : getLeftmostLeaf();
+  size_t first = 0;
+  if (minIndex) {
+    first = leftInclusive ? lowerBound(current->indexes, *minIndex)
+                          : upperBound(current->indexes, *minIndex);
+  }
   while (current) {
-    size_t i = 0;
-    // If minIndex is specified, find the starting point
-    if (minIndex) {
-      auto it = leftInclusive
-                    ? std::lower_bound(current->indexes.begin(),
-                                       current->indexes.end(), *minIndex)
-                    : std::upper_bound(current->indexes.begin(),
-                                       current->indexes.end(), *minIndex);
-      i = static_cast<size_t>(std::distance(current->indexes.begin(), it));
-    }
-    // Iterate through the leaf node
-    for (; i < current->indexes.size(); ++i) {
-      // Check if current index is within the maxIndex and rightInclusive
-      if (maxIndex) {
-        if ((rightInclusive && current->indexes[i] > *maxIndex) ||
-            (!rightInclusive && current->indexes[i] >= *maxIndex))
-          return result;
+    size_t last = current->indexes.size();
+    // the range ends in this leaf if its last index is past maxIndex
+    bool lastLeaf = false;
+    if (maxIndex && last > 0) {
+      const IndexType &back = current->indexes.back();
+      if ((rightInclusive && back > *maxIndex) ||
+          (!rightInclusive && back >= *maxIndex)) {
+        last = rightInclusive ? upperBound(current->indexes, *maxIndex)
+                              : lowerBound(current->indexes, *maxIndex);
+        lastLeaf = true;
       }
-      result.emplace_back(current->getData()[i]);
     }
+    if (first < last && !visit(current, first, last))
+      return;
+    if (lastLeaf)
+      return;
     // Move to the next leaf node
     current = current->next;
+    first = 0;
   }
+}
+
+// Range query in the B+ tree
+template <typename IndexType, typename DataType, typename NodePolicy>
+std::vector<DataType *> BpTree<IndexType, DataType, NodePolicy>::rangeQuery(
+    const std::optional<IndexType> &minIndex,
+    const std::optional<IndexType> &maxIndex, const bool &leftInclusive,
+    const bool &rightInclusive) {
+  std::vector<DataType *> result;
+  visitRange(
+      minIndex, maxIndex,
+      [&result](const IndexType &, DataType &data) {
+        result.emplace_back(&data);
+      },
+      leftInclusive, rightInclusive);
   return result;
 }
 
+// Stream the index-data pairs in the range to a visitor
+template <typename IndexType, typename DataType, typename NodePolicy>
+template <typename Visitor>
+size_t BpTree<IndexType, DataType, NodePolicy>::visitRange(
+    const std::optional<IndexType> &minIndex,
+    const std::optional<IndexType> &maxIndex, Visitor visit,
+    bool leftInclusive, bool rightInclusive) {
+  size_t visited = 0;
+  visitLeaves(minIndex, maxIndex, leftInclusive, rightInclusive,
+              [&](NodePtr leaf, size_t first, size_t last) {
+                auto &data = leaf->getData();
+                for (size_t i = first; i < last; ++i) {
+                  ++visited;
+                  DataType &value = slotData(data[i]);
+                  if constexpr (std::is_same_v<
+                                    decltype(visit(leaf->indexes[i], value)),
+                                    bool>) {
+                    if (!visit(leaf->indexes[i], value))
+                      return false;
+                  } else {
+                    visit(leaf->indexes[i], value);
+                  }
+                }
+                return true;
+              });
+  return visited;
+}
+
 // Count the number of indexes in the range
-template <typename IndexType, typename DataType>
-size_t BpTree<IndexType, DataType>::countRange(
+template <typename IndexType, typename DataType, typename NodePolicy>
+size_t BpTree<IndexType, DataType, NodePolicy>::countRange(
     const std::optional<IndexType> &minIndex,
     const std::optional<IndexType> &maxIndex, const bool &leftInclusive,
     const bool &rightInclusive) {
-  size_t count = 0;
-  // Start from the leaf node containing minIndex or the leftmost leaf
-  NodePtr current = minIndex ? findLeafNode(*minIndex) : getLeftmostLeaf();
-  while (current) {
-    size_t i = 0;
-    // If minIndex is specified, find the starting point
-    if (minIndex) {
-      auto it = leftInclusive
-                    ? std::lower_bound(current->indexes.begin(),
-                                       current->indexes.end(), *minIndex)
-                    : std::upper_bound(current->indexes.begin(),
-                                       current->indexes.end(), *minIndex);
-      i = static_cast<size_t>(std::distance(current->indexes.begin(), it));
-    }
-    // Iterate through the leaf node
-    for (; i < current->indexes.size(); ++i) {
-      // Check if current index is within the maxIndex and rightInclusive
-      // condition
-      if (maxIndex) {
-        if ((rightInclusive && current->indexes[i] > *maxIndex) ||
-            (!rightInclusive && current->indexes[i] >= *maxIndex))
-          return count;
-      }
-      ++count;
+  size_t first = minIndex ? countBelow(*minIndex, !leftInclusive) : 0;
+  size_t last = maxIndex ? countBelow(*maxIndex, rightInclusive) : size();
+  return last > first ? last - first : 0;
+}
+
+// The i-th smallest index
+template <typename IndexType, typename DataType, typename NodePolicy>
+typename BpTree<IndexType, DataType, NodePolicy>::iterator
+BpTree<IndexType, DataType, NodePolicy>::select(size_t i) {
+  auto [leaf, pos] = locate(i);
+  return iterator(this, leaf, pos);
+}
+
+template <typename IndexType, typename DataType, typename NodePolicy>
+typename BpTree<IndexType, DataType, NodePolicy>::const_iterator
+BpTree<IndexType, DataType, NodePolicy>::select(size_t i) const {
+  auto [leaf, pos] = locate(i);
+  return const_iterator(this, leaf, pos);
+}
+
+// Visit up to count index-data pairs starting at minIndex
+template <typename IndexType, typename DataType, typename NodePolicy>
+template <typename Visitor>
+size_t BpTree<IndexType, DataType, NodePolicy>::scan(const IndexType &minIndex,
+                                                     size_t count,
+                                                     Visitor visit) {
+  size_t visited = 0;
+  NodePtr current = findLeafNode(minIndex);
+  size_t i = lowerBound(current->indexes, minIndex);
+  while (current && visited < count) {
+    for (; i < current->indexes.size() && visited < count; ++i, ++visited) {
+      visit(current->indexes[i], slotData(current->getData()[i]));
     }
-    // Move to the next leaf node
     current = current->next;
+    i = 0;
   }
-  return count;
+  return visited;
 }
+
 // Utility function to print the B+ Tree
-template <typename IndexType, typename DataType>
-void BpTree<IndexType, DataType>::printTree() const {
+template <typename IndexType, typename DataType, typename NodePolicy>
+void BpTree<IndexType, DataType, NodePolicy>::printTree() const {
   if (!root)
     return;
   std::vector<NodePtr> currentLevel;
@@ -458,22 +780,175 @@ void BpTree<IndexType, DataType>::printTree() const {
   }
 }
 
-template <typename IndexType, typename DataType>
-DataType &BpTree<IndexType, DataType>::operator[](const IndexType &index) {
-  auto existingData = search(index);
-  if (existingData) {
-    // If the index exists, return a reference to the existing data
-    return *existingData;
-  } else {
-    // If the index doesn't exist, insert a new element with default-constructed
-    // data
-    DataType newData{};
-    insert(index, newData);
+// Walk the tree level by level, counting nodes and indexes; internal nodes
+// hold one index fewer than their children
+template <typename IndexType, typename DataType, typename NodePolicy>
+typename BpTree<IndexType, DataType, NodePolicy>::Stats
+BpTree<IndexType, DataType, NodePolicy>::stats() const {
+  Stats result;
+  std::vector<NodePtr> currentLevel{root}, nextLevel;
+  while (root && !currentLevel.empty()) {
+    LevelStats level;
+    for (NodePtr node : currentLevel) {
+      ++level.nodes;
+      level.indexes += node->indexes.size();
+      if (node->isLeaf) {
+        level.capacity += maxLeafIdxes;
+      } else {
+        level.capacity += maxIntChildren - 1;
+        const auto &children = node->getChildren();
+        nextLevel.insert(nextLevel.end(), children.begin(), children.end());
+      }
+    }
+    result.nodes += level.nodes;
+    result.levels.push_back(level);
+    currentLevel.swap(nextLevel);
+    nextLevel.clear();
+  }
+  result.height = result.levels.size();
+  if (result.height > 0) {
+    const LevelStats &leaves = result.levels.back();
+    result.leaves = leaves.nodes;
+    result.entries = leaves.indexes;
+    result.fillFactor = (double)leaves.indexes / leaves.capacity;
+  }
+  return result;
+}
 
-    // Search again to get the pointer to the newly inserted data
-    auto insertedData = search(index);
-    return *insertedData;
+// Replace the content of the tree with a sorted range
+template <typename IndexType, typename DataType, typename NodePolicy>
+template <typename Iterator>
+void BpTree<IndexType, DataType, NodePolicy>::bulkLoad(Iterator first,
+                                                       Iterator last,
+                                                       double fillFactor) {
+  destroySubtree(root);
+  root = createLeaf();
+  if (first == last)
+    return;
+
+  // however low fillFactor is, every node but the root is left at least
+  // half full, as erase expects to find it
+  size_t minLeaf = std::max<size_t>((maxLeafIdxes + 1) / 2, 1);
+  size_t minChildren = std::min(maxIntChildren / 2 + 1, maxIntChildren);
+  size_t leafFill =
+      std::clamp<size_t>((size_t)((double)maxLeafIdxes * fillFactor),
+                         minLeaf, maxLeafIdxes);
+  size_t intFill = std::clamp<size_t>(
+      (size_t)((double)maxIntChildren * fillFactor),
+      std::max<size_t>(minChildren, std::min<size_t>(3, maxIntChildren)),
+      maxIntChildren);
+
+  // build the leaves and remember the smallest index below each node
+  std::vector<NodePtr> level{root};
+  std::vector<IndexType> lowIndexes;
+  for (; first != last; ++first) {
+    NodePtr leaf = level.back();
+    if (!leaf->indexes.empty() && leaf->indexes.back() == first->first)
+      continue; // duplicate index
+    if (leaf->indexes.size() >= leafFill) {
+      NodePtr newLeaf = createLeaf();
+      leaf->next = newLeaf;
+      newLeaf->prev = leaf;
+      level.emplace_back(newLeaf);
+      leaf = newLeaf;
+    }
+    if (leaf->indexes.empty())
+      lowIndexes.emplace_back(first->first);
+    leaf->indexes.emplace_back(first->first);
+    leaf->getData().emplace_back(makeSlot(first->second));
+  }
+
+  // even out the last two leaves if the last one ended up underflowing, or
+  // merge them if together they do not fill two
+  if (level.size() > 1 && level.back()->indexes.size() < minLeaf) {
+    NodePtr left = level[level.size() - 2];
+    NodePtr right = level.back();
+    size_t total = left->indexes.size() + right->indexes.size();
+    if (total < 2 * minLeaf) {
+      left->indexes.insert(left->indexes.end(), right->indexes.begin(),
+                           right->indexes.end());
+      left->getData().insert(
+          left->getData().end(),
+          std::make_move_iterator(right->getData().begin()),
+          std::make_move_iterator(right->getData().end()));
+      right->getData().clear();
+      left->next = nullptr;
+      destroySubtree(right);
+      level.pop_back();
+      lowIndexes.pop_back();
+    } else {
+      auto moved = (long)(left->indexes.size() - (total - total / 2));
+      right->indexes.insert(right->indexes.begin(),
+                            left->indexes.end() - moved, left->indexes.end());
+      right->getData().insert(
+          right->getData().begin(),
+          std::make_move_iterator(left->getData().end() - moved),
+          std::make_move_iterator(left->getData().end()));
+      left->indexes.erase(left->indexes.end() - moved, left->indexes.end());
+      left->getData().erase(left->getData().end() - moved,
+                            left->getData().end());
+      lowIndexes.back() = right->indexes.front();
+    }
+  }
+
+  // group each level under parents until a single root is left, spreading
+  // the children evenly; fewer, fuller parents when an even spread would
+  // leave them below minChildren
+  while (level.size() > 1) {
+    size_t groups = (level.size() + intFill - 1) / intFill;
+    if (level.size() / groups < minChildren) {
+      groups = std::max(level.size() / minChildren,
+                        (level.size() + maxIntChildren - 1) / maxIntChildren);
+    }
+    std::vector<NodePtr> parents;
+    std::vector<IndexType> parentLowIndexes;
+    size_t child = 0;
+    for (size_t group = 0; group < groups; ++group) {
+      size_t end = level.size() * (group + 1) / groups;
+      NodePtr parent = createInternal();
+      parentLowIndexes.emplace_back(lowIndexes[child]);
+      parent->getChildren().emplace_back(level[child]);
+      parent->counts.emplace_back(subtreeCount(level[child++]));
+      for (; child < end; ++child) {
+        parent->indexes.emplace_back(lowIndexes[child]);
+        parent->getChildren().emplace_back(level[child]);
+        parent->counts.emplace_back(subtreeCount(level[child]));
+      }
+      parents.emplace_back(parent);
+    }
+    level = std::move(parents);
+    lowIndexes = std::move(parentLowIndexes);
+  }
+  root = level.front();
+}
+
+// Sort a copy of the range by index in parallel, then bulkLoad it
+template <typename IndexType, typename DataType, typename NodePolicy>
+template <typename Iterator>
+void BpTree<IndexType, DataType, NodePolicy>::bulkLoadUnsorted(
+    Iterator first, Iterator last, size_t threads, double fillFactor) {
+  std::vector<std::pair<IndexType, DataType>> entries(first, last);
+  // the sort is stable, so the first pair of equal indexes is kept
+  parallelSort(
+      entries.begin(), entries.end(),
+      [](const auto &a, const auto &b) { return a.first < b.first; }, threads);
+  bulkLoad(entries.begin(), entries.end(), fillFactor);
+}
+
+template <typename IndexType, typename DataType, typename NodePolicy>
+DataType &
+BpTree<IndexType, DataType, NodePolicy>::operator[](const IndexType &index) {
+  // descend once: the data is either in this leaf or inserted into it
+  Path path;
+  NodePtr leaf = findLeafNode(index, path);
+  size_t idx = lowerBound(leaf->indexes, index);
+  if (idx < leaf->indexes.size() && leaf->indexes[idx] == index) {
+    // If the index exists, return a reference to the existing data
+    return slotData(leaf->getData()[idx]);
   }
+  // If the index doesn't exist, insert a new element with default-constructed
+  // data
+  return insertIntoLeaf(leaf, idx, index, makeSlot(DataType{}), path);
 }
 
 #endif
@@ -0,0 +1,20 @@
+#ifndef PROJECT_DB_COMMANDLINE_H
+#define PROJECT_DB_COMMANDLINE_H
+
+#include <charconv>
+#include <string_view>
+#include <system_error>
+
+// Unsigned decimal that fills all of text, for command line values; false,
+// leaving value as it was, for anything else or a number out of range
+template <typename T> bool parseWholeNumber(std::string_view text, T &value) {
+  T parsed = 0;
+  const char *end = text.data() + text.size();
+  auto [last, error] = std::from_chars(text.data(), end, parsed);
+  if (text.empty() || error != std::errc() || last != end)
+    return false;
+  value = parsed;
+  return true;
+}
+
+#endif // PROJECT_DB_COMMANDLINE_H
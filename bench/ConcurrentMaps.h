@@ -0,0 +1,166 @@
+#ifndef PROJECT_DB_CONCURRENTMAPS_H
+#define PROJECT_DB_CONCURRENTMAPS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+#include "OlcBpTree.h"
+#include "Workload.h"
+
+// Thread-safe wrappers with a common interface for the multi-threaded
+// benchmark:
+//   bool find(key, out)       copy the data out if the key exists
+//   bool update(key, value)   overwrite the data if the key exists
+//   void upsert(key, value)   insert or overwrite
+//   bool modify(key, f)       apply f to the data atomically if it exists
+
+/**
+ * @brief         unordered_map split into shards with one mutex each
+ *
+ * @tparam        Shards , a power of two
+ */
+template <typename K, typename V, typename Hash = std::hash<K>,
+          size_t Shards = 64>
+class ShardedHashMap {
+private:
+  static_assert((Shards & (Shards - 1)) == 0, "Shards must be a power of two");
+
+  // one shard per cache line pair, so that neighbouring locks do not share
+  struct alignas(128) Shard {
+    std::mutex mutex;
+    std::unordered_map<K, V, Hash> map;
+  };
+  std::array<Shard, Shards> shards;
+
+  Shard &shardOf(const K &key) {
+    // take the high bits of a multiplicative mix, the map inside the shard
+    // uses the low bits of the same hash
+    uint64_t h = (uint64_t)Hash()(key) * 0x9e3779b97f4a7c15ULL;
+    return shards[(size_t)(h >> 32) & (Shards - 1)];
+  }
+
+public:
+  bool find(const K &key, V &out) {
+    Shard &shard = shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.map.find(key);
+    if (it == shard.map.end())
+      return false;
+    out = it->second;
+    return true;
+  }
+
+  bool update(const K &key, const V &value) {
+    return modify(key, [&value](V &data) { data = value; });
+  }
+
+  void upsert(const K &key, const V &value) {
+    Shard &shard = shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.map[key] = value;
+  }
+
+  template <typename F> bool modify(const K &key, F f) {
+    Shard &shard = shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.map.find(key);
+    if (it == shard.map.end())
+      return false;
+    f(it->second);
+    return true;
+  }
+};
+
+/**
+ * @brief         Any MapType behind one reader-writer lock: lookups share the
+ *                lock, every modification takes it exclusively
+ */
+template <typename MapType> class SharedMutexMap {
+private:
+  std::shared_mutex mutex;
+  MapType map;
+
+public:
+  template <typename K, typename V> bool find(const K &key, V &out) {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto *data = lookup(map, key);
+    if (!data)
+      return false;
+    out = *data;
+    return true;
+  }
+
+  template <typename K, typename V> bool update(const K &key, const V &value) {
+    return modify(key, [&value](V &data) { data = value; });
+  }
+
+  template <typename K, typename V> void upsert(const K &key, const V &value) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    map[key] = value;
+  }
+
+  template <typename K, typename F> bool modify(const K &key, F f) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    auto *data = lookup(map, key);
+    if (!data)
+      return false;
+    f(*data);
+    return true;
+  }
+};
+
+// The optimistic lock coupling B+ tree, readers take no lock at all
+template <typename K, typename V, size_t Fanout = 64> class OlcTreeMap {
+private:
+  OlcBpTree<K, V, Fanout> tree;
+
+public:
+  bool find(const K &key, V &out) { return tree.search(key, out); }
+
+  bool update(const K &key, const V &value) {
+    return tree.modify(key, [&value](V &data) { data = value; });
+  }
+
+  void upsert(const K &key, const V &value) { tree.insertOrAssign(key, value); }
+
+  template <typename F> bool modify(const K &key, F f) {
+    return tree.modify(key, f);
+  }
+};
+
+/**
+ * @brief         Run one operation on a thread-safe map
+ *
+ * Scans are not part of the multi-threaded workloads and are ignored.
+ *
+ * @return        size_t, a checksum of the data read
+ */
+template <typename ConcurrentMap>
+size_t runConcurrentOperation(ConcurrentMap &map, const Operation &op) {
+  int data = 0;
+  switch (op.type) {
+  case Operation::Read:
+    if (map.find(*op.key, data))
+      return (size_t)data;
+    break;
+  case Operation::Update:
+    map.update(*op.key, op.value);
+    break;
+  case Operation::Insert:
+    map.upsert(*op.key, op.value);
+    break;
+  case Operation::Scan:
+    break;
+  case Operation::ReadModifyWrite:
+    map.modify(*op.key, [](int &value) { value += 1; });
+    break;
+  }
+  return 0;
+}
+
+#endif // PROJECT_DB_CONCURRENTMAPS_H
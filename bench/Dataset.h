@@ -0,0 +1,225 @@
+#ifndef PROJECT_DB_DATASET_H
+#define PROJECT_DB_DATASET_H
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Loading of data/data.csv (KEY,studentID,class,totalCredit): the file is
+// memory-mapped and parsed into columns that point into the mapping
+
+/**
+ * @brief         Read-only mapping of a whole file, empty if the file cannot
+ *                be opened
+ */
+class MappedFile {
+private:
+  const char *bytes = nullptr;
+  size_t length = 0;
+
+public:
+  MappedFile() = default;
+
+  explicit MappedFile(const std::string &filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+      return;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+      void *mapping =
+          mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapping != MAP_FAILED) {
+        bytes = static_cast<const char *>(mapping);
+        length = (size_t)info.st_size;
+        madvise(mapping, length, MADV_SEQUENTIAL);
+      }
+    }
+    close(fd);
+  }
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  MappedFile(MappedFile &&other) noexcept
+      : bytes(std::exchange(other.bytes, nullptr)),
+        length(std::exchange(other.length, 0)) {}
+  MappedFile &operator=(MappedFile &&other) noexcept {
+    if (this != &other) {
+      unmap();
+      bytes = std::exchange(other.bytes, nullptr);
+      length = std::exchange(other.length, 0);
+    }
+    return *this;
+  }
+
+  ~MappedFile() { unmap(); }
+
+  const char *data() const { return bytes; }
+  size_t size() const { return length; }
+
+private:
+  void unmap() {
+    if (bytes)
+      munmap(const_cast<char *>(bytes), length);
+  }
+};
+
+/**
+ * @brief         The dataset by column. The string columns are views into the
+ *                mapped file, which the dataset keeps alive.
+ */
+struct Dataset {
+  MappedFile file;
+  std::vector<std::string_view> keys;
+  std::vector<uint64_t> studentIds;
+  std::vector<std::string_view> classes;
+  std::vector<uint32_t> totalCredits;
+
+  size_t size() const { return keys.size(); }
+};
+
+// Position of the next ',' or '\n' in [p, end), or end
+inline const char *findDelimiter(const char *p, const char *end) {
+#ifdef __SSE2__
+  const __m128i comma = _mm_set1_epi8(',');
+  const __m128i newline = _mm_set1_epi8('\n');
+  while (end - p >= 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, comma),
+                                              _mm_cmpeq_epi8(chunk, newline)));
+    if (mask)
+      return p + __builtin_ctz((unsigned)mask);
+    p += 16;
+  }
+#endif
+  while (p < end && *p != ',' && *p != '\n')
+    ++p;
+  return p;
+}
+
+// Unsigned decimal, 0 if the field is empty or not a number
+template <typename T> T parseNumber(std::string_view field) {
+  T value = 0;
+  std::from_chars(field.data(), field.data() + field.size(), value);
+  return value;
+}
+
+// Parse the rows in [p, end), which starts at a line boundary, into out.
+// Missing fields are left empty, fields after the fourth are ignored.
+inline void parseRows(const char *p, const char *end, Dataset &out) {
+  while (p < end) {
+    std::string_view fields[4];
+    size_t count = 0;
+    for (;;) {
+      const char *delimiter = findDelimiter(p, end);
+      std::string_view field(p, (size_t)(delimiter - p));
+      bool lineEnd = delimiter == end || *delimiter == '\n';
+      if (lineEnd && !field.empty() && field.back() == '\r')
+        field.remove_suffix(1);
+      if (count < 4)
+        fields[count++] = field;
+      p = delimiter == end ? end : delimiter + 1;
+      if (lineEnd)
+        break;
+    }
+    if (count == 1 && fields[0].empty())
+      continue; // blank line
+    out.keys.push_back(fields[0]);
+    out.studentIds.push_back(parseNumber<uint64_t>(fields[1]));
+    out.classes.push_back(fields[2]);
+    out.totalCredits.push_back(parseNumber<uint32_t>(fields[3]));
+  }
+}
+
+/**
+ * @brief         Map the CSV file and parse it, skipping the header row
+ *
+ * The file is split into one chunk per thread at line boundaries, the chunks
+ * are parsed in parallel and their rows concatenated in file order.
+ *
+ * @param         threads , 1 parses on the calling thread
+ * @return        Dataset, empty if the file cannot be read
+ */
+inline Dataset
+loadDataset(const std::string &filename,
+            size_t threads = std::thread::hardware_concurrency()) {
+  Dataset dataset;
+  dataset.file = MappedFile(filename);
+  const char *begin = dataset.file.data();
+  const char *end = begin + dataset.file.size();
+  if (!begin)
+    return dataset;
+
+  // the header is the first line if its studentID is not a number
+  const char *lineEnd = static_cast<const char *>(
+      std::memchr(begin, '\n', (size_t)(end - begin)));
+  const char *comma = findDelimiter(begin, end);
+  if (comma + 1 < end && *comma == ',' &&
+      !std::isdigit(static_cast<unsigned char>(comma[1])))
+    begin = lineEnd ? lineEnd + 1 : end;
+
+  // at least 1 MB per chunk, the threads are not worth it below that
+  size_t chunks = std::max<size_t>(
+      1, std::min<size_t>(threads, (size_t)(end - begin) >> 20));
+  std::vector<const char *> bounds = {begin};
+  for (size_t i = 1; i < chunks; ++i) {
+    const char *split = begin + (size_t)(end - begin) * i / chunks;
+    split = std::max(split, bounds.back());
+    auto *newline = static_cast<const char *>(
+        std::memchr(split, '\n', (size_t)(end - split)));
+    bounds.push_back(newline ? newline + 1 : end);
+  }
+  bounds.push_back(end);
+
+  if (chunks == 1) {
+    parseRows(begin, end, dataset);
+    return dataset;
+  }
+  std::vector<Dataset> parts(chunks);
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < chunks; ++i) {
+    workers.emplace_back([&parts, &bounds, i]() {
+      parseRows(bounds[i], bounds[i + 1], parts[i]);
+    });
+  }
+  for (auto &worker : workers)
+    worker.join();
+
+  size_t rows = 0;
+  for (const auto &part : parts)
+    rows += part.size();
+  dataset.keys.reserve(rows);
+  dataset.studentIds.reserve(rows);
+  dataset.classes.reserve(rows);
+  dataset.totalCredits.reserve(rows);
+  for (const auto &part : parts) {
+    dataset.keys.insert(dataset.keys.end(), part.keys.begin(),
+                        part.keys.end());
+    dataset.studentIds.insert(dataset.studentIds.end(),
+                              part.studentIds.begin(), part.studentIds.end());
+    dataset.classes.insert(dataset.classes.end(), part.classes.begin(),
+                           part.classes.end());
+    dataset.totalCredits.insert(dataset.totalCredits.end(),
+                                part.totalCredits.begin(),
+                                part.totalCredits.end());
+  }
+  return dataset;
+}
+
+#endif // PROJECT_DB_DATASET_H
@@ -0,0 +1,239 @@
+#ifndef PROJECT_DB_DISKBPTREE_H
+#define PROJECT_DB_DISKBPTREE_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "NodeSearch.h"
+#include "PageFile.h"
+
+/**
+ * @brief         A string of at most N bytes, zero padded, so that it can be
+ *                stored in a page. Longer strings are cut to N bytes.
+ */
+template <size_t N> struct FixedKey {
+  std::array<char, N> bytes{};
+
+  FixedKey() = default;
+  FixedKey(std::string_view text) {
+    std::memcpy(bytes.data(), text.data(), std::min(N, text.size()));
+  }
+  FixedKey(const std::string &text) : FixedKey(std::string_view(text)) {}
+  FixedKey(const char *text) : FixedKey(std::string_view(text)) {}
+
+  std::string_view view() const {
+    return std::string_view(bytes.data(), strnlen(bytes.data(), N));
+  }
+
+  // byte-wise like std::string, the padding sorts before any other byte
+  bool operator<(const FixedKey &other) const {
+    return std::memcmp(bytes.data(), other.bytes.data(), N) < 0;
+  }
+  bool operator>(const FixedKey &other) const { return other < *this; }
+  bool operator>=(const FixedKey &other) const { return !(*this < other); }
+  bool operator==(const FixedKey &other) const { return bytes == other.bytes; }
+  bool operator!=(const FixedKey &other) const { return bytes != other.bytes; }
+};
+
+/**
+ * @brief         B+ tree in a file of fixed-size pages
+ *
+ * Every node is one page of the file, which is memory-mapped, so the tree is
+ * used in place and a closed tree is reopened without reading or parsing
+ * anything: pages are faulted in by the first searches that touch them.
+ * Indexes and data are stored as they are, so both must be trivially
+ * copyable; FixedKey stores strings.
+ *
+ * Page 0 holds the header, with the geometry the file was written with, and
+ * the root. Erased indexes leave their leaf underfull: leaves are neither
+ * merged nor freed, the searches and scans only skip what is empty.
+ *
+ * @tparam        PageSize , bytes per page, 4 KB or 16 KB typically
+ */
+template <typename IndexType, typename DataType, size_t PageSize = 4096>
+class DiskBpTree {
+  static_assert(std::is_trivially_copyable_v<IndexType> &&
+                    std::is_trivially_copyable_v<DataType>,
+                "pages store indexes and data as raw bytes");
+
+private:
+  static constexpr uint64_t fileMagic = 0x3145455254504244; // "DBPTREE1"
+  static constexpr uint64_t noPage = 0; // page 0 is the header
+
+  struct Header {
+    uint64_t magic;
+    uint32_t pageSize;
+    uint32_t indexSize;
+    uint32_t dataSize;
+    uint32_t height; // levels of internal nodes above the leaves
+    uint64_t root;
+    uint64_t pages; // pages in use, the file may be larger
+    uint64_t size;  // #of index-data pairs
+  };
+
+  struct NodeHeader {
+    uint32_t isLeaf;
+    uint32_t count; // #of indexes
+    uint64_t next;  // the next leaf
+    uint64_t prev;  // the previous leaf
+  };
+
+  static constexpr size_t alignUp(size_t offset, size_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+  }
+  static constexpr size_t indexOffset =
+      alignUp(sizeof(NodeHeader), alignof(IndexType));
+  // room for the indexes and the data or children, minus alignment padding
+  static constexpr size_t leafCapacity =
+      (PageSize - indexOffset - alignof(DataType)) /
+      (sizeof(IndexType) + sizeof(DataType));
+  static constexpr size_t internalCapacity =
+      (PageSize - indexOffset - 2 * sizeof(uint64_t)) /
+      (sizeof(IndexType) + sizeof(uint64_t));
+  static constexpr size_t dataOffset = alignUp(
+      indexOffset + leafCapacity * sizeof(IndexType), alignof(DataType));
+  static constexpr size_t childOffset = alignUp(
+      indexOffset + internalCapacity * sizeof(IndexType), alignof(uint64_t));
+  static_assert(leafCapacity >= 2 && internalCapacity >= 2,
+                "a page must hold at least two indexes");
+
+  // A page seen as a node: header, indexes, then data (leaves) or one more
+  // child page number than indexes (internal nodes). Only valid until the
+  // file grows.
+  struct Node {
+    char *page;
+
+    NodeHeader &header() { return *reinterpret_cast<NodeHeader *>(page); }
+    IndexType *indexes() {
+      return reinterpret_cast<IndexType *>(page + indexOffset);
+    }
+    DataType *data() { return reinterpret_cast<DataType *>(page + dataOffset); }
+    uint64_t *children() {
+      return reinterpret_cast<uint64_t *>(page + childOffset);
+    }
+  };
+
+  // The internal nodes visited on the way down to a leaf and the child slot
+  // taken in each
+  struct Path {
+    std::array<std::pair<uint64_t, size_t>, 64> entries;
+    size_t depth = 0;
+  };
+
+  PageFile file;
+
+  Header &header() { return *reinterpret_cast<Header *>(file.page(0)); }
+  const Header &header() const {
+    return *reinterpret_cast<const Header *>(file.page(0));
+  }
+  Node node(uint64_t id) const {
+    return {const_cast<char *>(file.page(id))};
+  }
+
+  static size_t lowerBound(Node node, const IndexType &index) {
+    return NodeSearch<IndexType>::lowerBound(node.indexes(),
+                                             node.header().count, index);
+  }
+  static size_t upperBound(Node node, const IndexType &index) {
+    return NodeSearch<IndexType>::upperBound(node.indexes(),
+                                             node.header().count, index);
+  }
+
+  // Write an empty tree: the header and an empty root leaf
+  bool initialize();
+  // Take the next unused page, growing the file if needed; noPage on failure
+  uint64_t allocatePage(bool isLeaf);
+  // Grow the file so that count more pages can be taken without failing
+  bool reservePages(size_t count);
+  // Find the leaf for index and record the path to it
+  uint64_t findLeaf(const IndexType &index, Path *path) const;
+  // Insert right, whose smallest index is index, next to the last node on
+  // the path, splitting the parents as far up as needed
+  bool promote(IndexType index, uint64_t right, Path &path);
+
+public:
+  /**
+   * @brief         Open the tree in filename, or create it if the file does
+   *                not exist or is empty
+   *
+   * The tree is not open if the file cannot be mapped or was written with a
+   * different page size, index or data type.
+   */
+  explicit DiskBpTree(const std::string &filename);
+
+  DiskBpTree(const DiskBpTree &) = delete;
+  DiskBpTree &operator=(const DiskBpTree &) = delete;
+  DiskBpTree(DiskBpTree &&) noexcept = default;
+  DiskBpTree &operator=(DiskBpTree &&) noexcept = default;
+
+  bool isOpen() const { return file.isOpen(); }
+  size_t size() const { return header().size; }
+  // bytes of file in use
+  size_t fileSize() const { return header().pages * PageSize; }
+
+  /**
+   * @brief         Insert a index-data pair into the tree
+   *
+   * @return        true if the insertion is successful
+   * @return        false if the index already exists or the file cannot grow
+   */
+  bool insert(const IndexType &index, const DataType &data);
+
+  /**
+   * @brief         Remove index from the tree
+   *
+   * @return        true if the removal is successful
+   * @return        false if the index is not found
+   */
+  bool erase(const IndexType &index);
+
+  /**
+   * @brief         search for a specific index
+   *
+   * The data lives in the mapped file: writes through the pointer go to the
+   * file, and it is only valid until the next insertion.
+   *
+   * @return        DataType *, nullptr if not found
+   */
+  DataType *search(const IndexType &index);
+
+  /**
+   * @brief         Visit the index-data pairs in [minIndex, maxIndex] in index
+   *                order
+   *
+   * @tparam        Visitor , called as visit(const IndexType &, DataType &)
+   * @param         minIndex , if input is std::nullopt, start from the leftmost
+   * @param         maxIndex , if input is std::nullopt, end at the rightmost
+   * @return        size_t, the number of pairs visited
+   */
+  template <typename Visitor>
+  size_t visitRange(const std::optional<IndexType> &minIndex,
+                    const std::optional<IndexType> &maxIndex, Visitor visit);
+
+  /**
+   * @brief         Replace the content of the tree with a range of pairs
+   *                sorted by index, filling every page
+   *
+   * Only the first of several pairs with the same index is kept.
+   *
+   * @return        false if the file cannot grow
+   */
+  template <typename Iterator> bool bulkLoad(Iterator first, Iterator last);
+
+  /**
+   * @brief         Write all modified pages to disk and wait for it
+   */
+  bool sync() { return file.sync(); }
+};
+
+#include "DiskBpTreeImpl.h" // Include the implementation
+
+#endif // PROJECT_DB_DISKBPTREE_H
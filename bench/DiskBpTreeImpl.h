@@ -0,0 +1,316 @@
+#ifndef PROJECT_DB_DISKBPTREEIMPL_H
+#define PROJECT_DB_DISKBPTREEIMPL_H
+
+#pragma once
+#include "DiskBpTree.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+template <typename IndexType, typename DataType, size_t PageSize>
+DiskBpTree<IndexType, DataType, PageSize>::DiskBpTree(
+    const std::string &filename)
+    : file(filename, PageSize) {
+  if (!file.isOpen())
+    return;
+  if (file.pageCount() == 0) {
+    if (!initialize())
+      file = PageFile();
+    return;
+  }
+  // a tree written with other types or pages cannot be read
+  const Header &existing = header();
+  if (existing.magic != fileMagic || existing.pageSize != PageSize ||
+      existing.indexSize != sizeof(IndexType) ||
+      existing.dataSize != sizeof(DataType) ||
+      existing.pages > file.pageCount())
+    file = PageFile();
+}
+
+// Write an empty tree: the header and an empty root leaf
+template <typename IndexType, typename DataType, size_t PageSize>
+bool DiskBpTree<IndexType, DataType, PageSize>::initialize() {
+  if (!file.reserve(std::max<size_t>(file.pageCount(), 2)))
+    return false;
+  header() = {fileMagic, PageSize, sizeof(IndexType), sizeof(DataType), 0, 0,
+              1, 0};
+  header().root = allocatePage(true);
+  return header().root != noPage;
+}
+
+// Take the next unused page, doubling the file when it is full
+template <typename IndexType, typename DataType, size_t PageSize>
+uint64_t DiskBpTree<IndexType, DataType, PageSize>::allocatePage(bool isLeaf) {
+  uint64_t id = header().pages;
+  if (id == file.pageCount() && !file.reserve(file.pageCount() * 2))
+    return noPage;
+  ++header().pages;
+  node(id).header() = {isLeaf, 0, noPage, noPage};
+  return id;
+}
+
+template <typename IndexType, typename DataType, size_t PageSize>
+bool DiskBpTree<IndexType, DataType, PageSize>::reservePages(size_t count) {
+  size_t needed = header().pages + count;
+  return needed <= file.pageCount() ||
+         file.reserve(std::max(needed, file.pageCount() * 2));
+}
+
+// Find the leaf for index and record the path to it
+template <typename IndexType, typename DataType, size_t PageSize>
+uint64_t
+DiskBpTree<IndexType, DataType, PageSize>::findLeaf(const IndexType &index,
+                                                    Path *path) const {
+  uint64_t current = header().root;
+  while (!node(current).header().isLeaf) {
+    Node internal = node(current);
+    size_t idxChild = upperBound(internal, index);
+    if (path)
+      path->entries[path->depth++] = {current, idxChild};
+    current = internal.children()[idxChild];
+  }
+  return current;
+}
+
+// Insert right next to the last node on the path, splitting upwards
+template <typename IndexType, typename DataType, size_t PageSize>
+bool DiskBpTree<IndexType, DataType, PageSize>::promote(IndexType index,
+                                                        uint64_t right,
+                                                        Path &path) {
+  while (path.depth > 0) {
+    auto [parentId, slot] = path.entries[--path.depth];
+    size_t count = node(parentId).header().count;
+    if (count < internalCapacity) {
+      Node parent = node(parentId);
+      std::copy_backward(parent.indexes() + slot, parent.indexes() + count,
+                         parent.indexes() + count + 1);
+      std::copy_backward(parent.children() + slot + 1,
+                         parent.children() + count + 1,
+                         parent.children() + count + 2);
+      parent.indexes()[slot] = index;
+      parent.children()[slot + 1] = right;
+      ++parent.header().count;
+      return true;
+    }
+
+    // split the full parent: gather all indexes and children with the new
+    // one, keep the lower half, move the upper half and promote the middle
+    uint64_t siblingId = allocatePage(false);
+    if (siblingId == noPage)
+      return false;
+    Node parent = node(parentId), sibling = node(siblingId);
+    std::vector<IndexType> indexes(parent.indexes(), parent.indexes() + count);
+    std::vector<uint64_t> children(parent.children(),
+                                   parent.children() + count + 1);
+    indexes.insert(indexes.begin() + (long)slot, index);
+    children.insert(children.begin() + (long)slot + 1, right);
+    size_t middle = indexes.size() / 2;
+    std::copy(indexes.begin(), indexes.begin() + (long)middle,
+              parent.indexes());
+    std::copy(children.begin(), children.begin() + (long)middle + 1,
+              parent.children());
+    parent.header().count = (uint32_t)middle;
+    std::copy(indexes.begin() + (long)middle + 1, indexes.end(),
+              sibling.indexes());
+    std::copy(children.begin() + (long)middle + 1, children.end(),
+              sibling.children());
+    sibling.header().count = (uint32_t)(indexes.size() - middle - 1);
+    index = indexes[middle];
+    right = siblingId;
+  }
+
+  // the root was split, grow a new one above it
+  uint64_t rootId = allocatePage(false);
+  if (rootId == noPage)
+    return false;
+  Node root = node(rootId);
+  root.indexes()[0] = index;
+  root.children()[0] = header().root;
+  root.children()[1] = right;
+  root.header().count = 1;
+  header().root = rootId;
+  ++header().height;
+  return true;
+}
+
+// Insert a index-data pair into the tree
+template <typename IndexType, typename DataType, size_t PageSize>
+bool DiskBpTree<IndexType, DataType, PageSize>::insert(const IndexType &index,
+                                                       const DataType &data) {
+  Path path;
+  uint64_t leafId = findLeaf(index, &path);
+  Node leaf = node(leafId);
+  size_t pos = lowerBound(leaf, index);
+  size_t count = leaf.header().count;
+  if (pos < count && leaf.indexes()[pos] == index)
+    return false; // duplicate index
+
+  if (count == leafCapacity) {
+    // the split takes the new leaf, a sibling for every parent on the path
+    // and a new root at worst; fail before anything changes if the file
+    // cannot hold them, so that the split and promote cannot fail halfway
+    if (!reservePages(path.depth + 2))
+      return false;
+    // move the upper half to a new leaf and insert into the half it belongs
+    uint64_t rightId = allocatePage(true);
+    leaf = node(leafId);
+    Node right = node(rightId);
+    size_t splitPoint = count / 2;
+    std::copy(leaf.indexes() + splitPoint, leaf.indexes() + count,
+              right.indexes());
+    std::copy(leaf.data() + splitPoint, leaf.data() + count, right.data());
+    right.header().count = (uint32_t)(count - splitPoint);
+    leaf.header().count = (uint32_t)splitPoint;
+    // link the new leaf in after the original one
+    right.header().next = leaf.header().next;
+    right.header().prev = leafId;
+    if (leaf.header().next != noPage)
+      node(leaf.header().next).header().prev = rightId;
+    leaf.header().next = rightId;
+    // index goes right only if it does not become the smallest there, so
+    // the separator is the smallest index of the new leaf either way
+    IndexType separator = right.indexes()[0];
+    if (pos > splitPoint) {
+      pos -= splitPoint;
+      leaf = right;
+    }
+    count = leaf.header().count;
+    std::copy_backward(leaf.indexes() + pos, leaf.indexes() + count,
+                       leaf.indexes() + count + 1);
+    std::copy_backward(leaf.data() + pos, leaf.data() + count,
+                       leaf.data() + count + 1);
+    leaf.indexes()[pos] = index;
+    leaf.data()[pos] = data;
+    ++leaf.header().count;
+    ++header().size;
+    return promote(separator, rightId, path);
+  }
+
+  std::copy_backward(leaf.indexes() + pos, leaf.indexes() + count,
+                     leaf.indexes() + count + 1);
+  std::copy_backward(leaf.data() + pos, leaf.data() + count,
+                     leaf.data() + count + 1);
+  leaf.indexes()[pos] = index;
+  leaf.data()[pos] = data;
+  ++leaf.header().count;
+  ++header().size;
+  return true;
+}
+
+// Remove index from its leaf, without rebalancing
+template <typename IndexType, typename DataType, size_t PageSize>
+bool DiskBpTree<IndexType, DataType, PageSize>::erase(const IndexType &index) {
+  Node leaf = node(findLeaf(index, nullptr));
+  size_t pos = lowerBound(leaf, index);
+  size_t count = leaf.header().count;
+  if (pos == count || leaf.indexes()[pos] != index)
+    return false; // Index not found
+  std::copy(leaf.indexes() + pos + 1, leaf.indexes() + count,
+            leaf.indexes() + pos);
+  std::copy(leaf.data() + pos + 1, leaf.data() + count, leaf.data() + pos);
+  --leaf.header().count;
+  --header().size;
+  return true;
+}
+
+// Search for a specific index
+template <typename IndexType, typename DataType, size_t PageSize>
+DataType *
+DiskBpTree<IndexType, DataType, PageSize>::search(const IndexType &index) {
+  Node leaf = node(findLeaf(index, nullptr));
+  size_t pos = lowerBound(leaf, index);
+  if (pos < leaf.header().count && leaf.indexes()[pos] == index)
+    return &leaf.data()[pos];
+  return nullptr;
+}
+
+// Visit the pairs in [minIndex, maxIndex] along the leaf chain
+template <typename IndexType, typename DataType, size_t PageSize>
+template <typename Visitor>
+size_t DiskBpTree<IndexType, DataType, PageSize>::visitRange(
+    const std::optional<IndexType> &minIndex,
+    const std::optional<IndexType> &maxIndex, Visitor visit) {
+  uint64_t current = header().root;
+  if (minIndex) {
+    current = findLeaf(*minIndex, nullptr);
+  } else {
+    while (!node(current).header().isLeaf)
+      current = node(current).children()[0];
+  }
+  size_t visited = 0;
+  size_t pos = minIndex ? lowerBound(node(current), *minIndex) : 0;
+  for (; current != noPage; current = node(current).header().next, pos = 0) {
+    Node leaf = node(current);
+    for (; pos < leaf.header().count; ++pos, ++visited) {
+      if (maxIndex && leaf.indexes()[pos] > *maxIndex)
+        return visited;
+      visit(leaf.indexes()[pos], leaf.data()[pos]);
+    }
+  }
+  return visited;
+}
+
+// Replace the content of the tree with a sorted range, filling every page
+template <typename IndexType, typename DataType, size_t PageSize>
+template <typename Iterator>
+bool DiskBpTree<IndexType, DataType, PageSize>::bulkLoad(Iterator first,
+                                                         Iterator last) {
+  // start over in the pages of the old tree
+  if (!initialize())
+    return false;
+  std::vector<uint64_t> level{header().root};
+  std::vector<IndexType> lowIndexes;
+  for (; first != last; ++first) {
+    Node leaf = node(level.back());
+    size_t count = leaf.header().count;
+    if (count > 0 && leaf.indexes()[count - 1] == first->first)
+      continue; // duplicate index
+    if (count == leafCapacity) {
+      uint64_t nextId = allocatePage(true);
+      if (nextId == noPage)
+        return false;
+      node(level.back()).header().next = nextId;
+      node(nextId).header().prev = level.back();
+      level.emplace_back(nextId);
+      leaf = node(nextId);
+      count = 0;
+    }
+    if (count == 0)
+      lowIndexes.emplace_back(first->first);
+    leaf.indexes()[count] = first->first;
+    leaf.data()[count] = first->second;
+    ++leaf.header().count;
+    ++header().size;
+  }
+
+  // group each level under full parents until a single root is left; the
+  // last parent of a level may be left with a single child
+  while (level.size() > 1) {
+    std::vector<uint64_t> parents;
+    std::vector<IndexType> parentLowIndexes;
+    for (size_t child = 0; child < level.size();) {
+      uint64_t parentId = allocatePage(false);
+      if (parentId == noPage)
+        return false;
+      Node parent = node(parentId);
+      parentLowIndexes.emplace_back(lowIndexes[child]);
+      parent.children()[0] = level[child++];
+      for (size_t i = 0; i < internalCapacity && child < level.size(); ++i) {
+        parent.indexes()[i] = lowIndexes[child];
+        parent.children()[i + 1] = level[child++];
+        ++parent.header().count;
+      }
+      parents.emplace_back(parentId);
+    }
+    level = std::move(parents);
+    lowIndexes = std::move(parentLowIndexes);
+    ++header().height;
+  }
+  header().root = level.front();
+  return true;
+}
+
+#endif
@@ -0,0 +1,383 @@
+#ifndef PROJECT_DB_FLATHASHMAP_H
+#define PROJECT_DB_FLATHASHMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * @brief         Open-addressing hash map in the style of SwissTable
+ *
+ * The pairs live in one flat array of slots, next to an array with one
+ * control byte per slot: empty, deleted, or the low 7 bits of the hash (h2)
+ * of the key in a full slot. A lookup starts at the slot given by the rest of
+ * the hash (h1) and compares the control bytes of 16 slots at once with h2,
+ * so that keys are only compared for the few slots whose h2 matches; it stops
+ * at the first group of 16 with an empty slot. Groups are probed in
+ * triangular steps. The first 16 control bytes are mirrored after the last
+ * one, so that a group can start at any slot.
+ *
+ * The table holds at most 7/8 of its capacity, a power of two, in full and
+ * deleted slots. An erased slot becomes deleted (a tombstone) unless no probe
+ * can have gone past it; tombstones are dropped when the table is rehashed.
+ * Pointers and iterators are invalidated by rehashing, which any insertion
+ * may do.
+ *
+ * The hash is mixed with a 128-bit multiply, so that weak hashes such as the
+ * identity std::hash of integers spread over both h1 and h2.
+ */
+template <typename K, typename V, typename Hash = std::hash<K>>
+class FlatHashMap {
+public:
+  using key_type = K;
+  using mapped_type = V;
+  using value_type = std::pair<const K, V>;
+
+private:
+  static constexpr int8_t Empty = -128;
+  static constexpr int8_t Deleted = -2;
+  static constexpr size_t groupWidth = 16;
+
+  // The control bytes of groupWidth consecutive slots, with bit masks of the
+  // slots that match
+  struct Group {
+#ifdef __SSE2__
+    __m128i bytes;
+
+    explicit Group(const int8_t *control)
+        : bytes(_mm_loadu_si128(reinterpret_cast<const __m128i *>(control))) {}
+    uint32_t match(int8_t tag) const {
+      return (uint32_t)_mm_movemask_epi8(
+          _mm_cmpeq_epi8(bytes, _mm_set1_epi8(tag)));
+    }
+    // empty and deleted are the only negative bytes below -1
+    uint32_t matchEmptyOrDeleted() const {
+      return (uint32_t)_mm_movemask_epi8(
+          _mm_cmpgt_epi8(_mm_set1_epi8(-1), bytes));
+    }
+#else
+    int8_t bytes[groupWidth];
+
+    explicit Group(const int8_t *control) {
+      std::memcpy(bytes, control, groupWidth);
+    }
+    uint32_t match(int8_t tag) const {
+      uint32_t mask = 0;
+      for (size_t i = 0; i < groupWidth; ++i)
+        mask |= (uint32_t)(bytes[i] == tag) << i;
+      return mask;
+    }
+    uint32_t matchEmptyOrDeleted() const {
+      uint32_t mask = 0;
+      for (size_t i = 0; i < groupWidth; ++i)
+        mask |= (uint32_t)(bytes[i] < -1) << i;
+      return mask;
+    }
+#endif
+    uint32_t matchEmpty() const { return match(Empty); }
+  };
+
+  int8_t *control = nullptr; // capacity + groupWidth bytes
+  value_type *slots = nullptr;
+  size_t capacity = 0;
+  size_t used = 0;       // full slots
+  size_t growthLeft = 0; // empty slots that may still be filled
+
+  static uint64_t mix(const K &key) {
+    __uint128_t product = (__uint128_t)(uint64_t)Hash()(key) *
+                          0x9e3779b97f4a7c15ULL;
+    return (uint64_t)product ^ (uint64_t)(product >> 64);
+  }
+  static size_t h1(uint64_t hash) { return (size_t)(hash >> 7); }
+  static int8_t h2(uint64_t hash) { return (int8_t)(hash & 0x7f); }
+  size_t mask() const { return capacity - 1; }
+
+  void setControl(size_t i, int8_t value) {
+    control[i] = value;
+    if (i < groupWidth)
+      control[capacity + i] = value;
+  }
+
+  // The slot of key, or capacity if it is not in the map
+  size_t findSlot(const K &key, uint64_t hash) const;
+  // The first empty or deleted slot on the probe sequence of hash
+  size_t firstFree(uint64_t hash) const;
+  // Move every pair into a table of newCapacity slots
+  void rehash(size_t newCapacity);
+  // The slot of key, inserting it with a default value if needed
+  std::pair<size_t, bool> findOrInsert(const K &key);
+  void eraseSlot(size_t i);
+  void destroy();
+
+public:
+  template <bool isConst> class Iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = FlatHashMap::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = std::conditional_t<isConst, const value_type *,
+                                       value_type *>;
+    using reference = std::conditional_t<isConst, const value_type &,
+                                         value_type &>;
+
+    Iterator() = default;
+    // a const_iterator from an iterator
+    template <bool wasConst, typename = std::enable_if_t<isConst && !wasConst>>
+    Iterator(const Iterator<wasConst> &other)
+        : map(other.map), slot(other.slot) {}
+
+    reference operator*() const { return map->slots[slot]; }
+    pointer operator->() const { return &map->slots[slot]; }
+    Iterator &operator++() {
+      ++slot;
+      skipFree();
+      return *this;
+    }
+    Iterator operator++(int) {
+      Iterator old = *this;
+      ++*this;
+      return old;
+    }
+    bool operator==(const Iterator &other) const { return slot == other.slot; }
+    bool operator!=(const Iterator &other) const { return slot != other.slot; }
+
+  private:
+    friend class FlatHashMap;
+    template <bool> friend class Iterator;
+    using Map = std::conditional_t<isConst, const FlatHashMap, FlatHashMap>;
+
+    Map *map = nullptr;
+    size_t slot = 0;
+
+    Iterator(Map *map, size_t slot) : map(map), slot(slot) {}
+    void skipFree() {
+      while (slot < map->capacity && map->control[slot] < 0)
+        ++slot;
+    }
+  };
+
+  using iterator = Iterator<false>;
+  using const_iterator = Iterator<true>;
+
+  FlatHashMap() = default;
+  FlatHashMap(const FlatHashMap &) = delete;
+  FlatHashMap &operator=(const FlatHashMap &) = delete;
+  FlatHashMap(FlatHashMap &&other) noexcept { *this = std::move(other); }
+  FlatHashMap &operator=(FlatHashMap &&other) noexcept {
+    if (this != &other) {
+      destroy();
+      control = std::exchange(other.control, nullptr);
+      slots = std::exchange(other.slots, nullptr);
+      capacity = std::exchange(other.capacity, 0);
+      used = std::exchange(other.used, 0);
+      growthLeft = std::exchange(other.growthLeft, 0);
+    }
+    return *this;
+  }
+  ~FlatHashMap() { destroy(); }
+
+  size_t size() const { return used; }
+  bool empty() const { return used == 0; }
+  size_t bucket_count() const { return capacity; }
+  double load_factor() const {
+    return capacity ? (double)used / capacity : 0.0;
+  }
+
+  iterator begin() {
+    iterator it(this, 0);
+    it.skipFree();
+    return it;
+  }
+  iterator end() { return iterator(this, capacity); }
+  const_iterator begin() const {
+    const_iterator it(this, 0);
+    it.skipFree();
+    return it;
+  }
+  const_iterator end() const { return const_iterator(this, capacity); }
+
+  iterator find(const K &key) {
+    return iterator(this, capacity ? findSlot(key, mix(key)) : 0);
+  }
+  const_iterator find(const K &key) const {
+    return const_iterator(this, capacity ? findSlot(key, mix(key)) : 0);
+  }
+  size_t count(const K &key) const { return find(key) != end(); }
+  bool contains(const K &key) const { return find(key) != end(); }
+
+  /**
+   * @brief         The data of key, inserted with a default value if needed
+   */
+  V &operator[](const K &key) {
+    size_t slot = findOrInsert(key).first; // may rehash, moving slots
+    return slots[slot].second;
+  }
+
+  /**
+   * @brief         Insert a pair unless its key exists
+   *
+   * @return        the pair with the key, and whether it was inserted
+   */
+  std::pair<iterator, bool> insert(const value_type &pair) {
+    auto [slot, inserted] = findOrInsert(pair.first);
+    if (inserted)
+      slots[slot].second = pair.second;
+    return {iterator(this, slot), inserted};
+  }
+
+  /**
+   * @brief         Remove key
+   *
+   * @return        size_t, the number of pairs removed, 0 or 1
+   */
+  size_t erase(const K &key) {
+    if (!capacity)
+      return 0;
+    size_t slot = findSlot(key, mix(key));
+    if (slot == capacity)
+      return 0;
+    eraseSlot(slot);
+    return 1;
+  }
+
+  /**
+   * @brief         Make room for n pairs without rehashing
+   */
+  void reserve(size_t n) {
+    size_t newCapacity = groupWidth;
+    while (newCapacity / 8 * 7 < n)
+      newCapacity *= 2;
+    if (newCapacity > capacity)
+      rehash(newCapacity);
+  }
+
+  void clear() {
+    destroy();
+    capacity = used = growthLeft = 0;
+  }
+};
+
+// Find: probe the groups, comparing keys only where h2 matches, until a group
+// with an empty slot
+template <typename K, typename V, typename Hash>
+size_t FlatHashMap<K, V, Hash>::findSlot(const K &key, uint64_t hash) const {
+  int8_t tag = h2(hash);
+  size_t pos = h1(hash) & mask();
+  for (size_t step = groupWidth;; pos = (pos + step) & mask(),
+              step += groupWidth) {
+    Group group(control + pos);
+    for (uint32_t match = group.match(tag); match; match &= match - 1) {
+      size_t slot = (pos + (size_t)__builtin_ctz(match)) & mask();
+      if (slots[slot].first == key)
+        return slot;
+    }
+    if (group.matchEmpty())
+      return capacity;
+  }
+}
+
+// First free slot: the same probe sequence, stopping at empty or deleted
+template <typename K, typename V, typename Hash>
+size_t FlatHashMap<K, V, Hash>::firstFree(uint64_t hash) const {
+  size_t pos = h1(hash) & mask();
+  for (size_t step = groupWidth;; pos = (pos + step) & mask(),
+              step += groupWidth) {
+    if (uint32_t free = Group(control + pos).matchEmptyOrDeleted())
+      return (pos + (size_t)__builtin_ctz(free)) & mask();
+  }
+}
+
+// Rehash: fresh control bytes, every pair moved to its first free slot in
+// the new table
+template <typename K, typename V, typename Hash>
+void FlatHashMap<K, V, Hash>::rehash(size_t newCapacity) {
+  int8_t *oldControl = control;
+  value_type *oldSlots = slots;
+  size_t oldCapacity = capacity;
+
+  control = new int8_t[newCapacity + groupWidth];
+  std::memset(control, Empty, newCapacity + groupWidth);
+  slots = std::allocator<value_type>().allocate(newCapacity);
+  capacity = newCapacity;
+  growthLeft = newCapacity / 8 * 7 - used;
+  for (size_t i = 0; i < oldCapacity; ++i) {
+    if (oldControl[i] < 0)
+      continue;
+    uint64_t hash = mix(oldSlots[i].first);
+    size_t slot = firstFree(hash);
+    setControl(slot, h2(hash));
+    new (&slots[slot]) value_type(std::move(oldSlots[i]));
+    oldSlots[i].~value_type();
+  }
+  delete[] oldControl;
+  if (oldSlots)
+    std::allocator<value_type>().deallocate(oldSlots, oldCapacity);
+}
+
+// Insert: find the key, or take the first free slot of its probe sequence.
+// Without empty slots left to fill, the table grows, or is rehashed at the
+// same size if tombstones take most of the room.
+template <typename K, typename V, typename Hash>
+std::pair<size_t, bool>
+FlatHashMap<K, V, Hash>::findOrInsert(const K &key) {
+  uint64_t hash = mix(key);
+  if (capacity) {
+    size_t slot = findSlot(key, hash);
+    if (slot != capacity)
+      return {slot, false};
+  }
+  size_t slot = capacity ? firstFree(hash) : 0;
+  if (!capacity || (growthLeft == 0 && control[slot] == Empty)) {
+    size_t newCapacity = groupWidth;
+    if (capacity)
+      newCapacity = (used + 1) * 16 > capacity * 7 ? capacity * 2 : capacity;
+    rehash(newCapacity);
+    slot = firstFree(hash);
+  }
+  growthLeft -= control[slot] == Empty;
+  setControl(slot, h2(hash));
+  new (&slots[slot]) value_type(key, V());
+  ++used;
+  return {slot, true};
+}
+
+// Erase: a slot can become empty again if the groups before and after it
+// have empty slots close enough that no group of 16 around the slot was
+// ever full, otherwise probes may have passed it and it becomes deleted
+template <typename K, typename V, typename Hash>
+void FlatHashMap<K, V, Hash>::eraseSlot(size_t i) {
+  slots[i].~value_type();
+  --used;
+  uint32_t emptyBefore =
+      Group(control + ((i - groupWidth) & mask())).matchEmpty();
+  uint32_t emptyAfter = Group(control + i).matchEmpty();
+  bool neverFull = emptyBefore && emptyAfter &&
+                   (size_t)(__builtin_ctz(emptyAfter) +
+                            __builtin_clz(emptyBefore << 16)) < groupWidth;
+  setControl(i, neverFull ? Empty : Deleted);
+  growthLeft += neverFull;
+}
+
+template <typename K, typename V, typename Hash>
+void FlatHashMap<K, V, Hash>::destroy() {
+  for (size_t i = 0; i < capacity; ++i) {
+    if (control[i] >= 0)
+      slots[i].~value_type();
+  }
+  delete[] control;
+  if (slots)
+    std::allocator<value_type>().deallocate(slots, capacity);
+  control = nullptr;
+  slots = nullptr;
+}
+
+#endif // PROJECT_DB_FLATHASHMAP_H
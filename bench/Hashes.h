@@ -0,0 +1,298 @@
+#ifndef PROJECT_DB_HASHES_H
+#define PROJECT_DB_HASHES_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
+
+// String hashes for the hash map benchmarks, next to the FNV-1a and modulo
+// ones of BenchUtils.h. Each has a function over bytes and a functor for
+// std::string keys.
+
+namespace hashing {
+
+inline uint64_t read64(const unsigned char *p) {
+  uint64_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+inline uint64_t read32(const unsigned char *p) {
+  uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+inline uint64_t rotl(uint64_t value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+// the 128-bit product of a and b, folded to 64 bits
+inline uint64_t mulFold(uint64_t a, uint64_t b) {
+  __uint128_t product = (__uint128_t)a * b;
+  return (uint64_t)product ^ (uint64_t)(product >> 64);
+}
+
+// MurmurHash3's 64-bit finalizer
+inline uint64_t fmix64(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+} // namespace hashing
+
+/**
+ * @brief         wyhash (final version 4): two 64-bit words of input per
+ *                128-bit multiply, with overlapping reads for the tail
+ */
+inline uint64_t wyhash(const void *key, size_t len, uint64_t seed = 0) {
+  using namespace hashing;
+  constexpr uint64_t s0 = 0xa0761d6478bd642fULL, s1 = 0xe7037ed1a0b428dbULL,
+                     s2 = 0x8ebc6af09c88c6e3ULL, s3 = 0x589965cc75374cc3ULL;
+  const unsigned char *p = static_cast<const unsigned char *>(key);
+  seed ^= mulFold(seed ^ s0, s1);
+  uint64_t a, b;
+  if (len <= 16) {
+    if (len >= 4) {
+      size_t middle = (len >> 3) << 2;
+      a = (read32(p) << 32) | read32(p + middle);
+      b = (read32(p + len - 4) << 32) | read32(p + len - 4 - middle);
+    } else if (len > 0) {
+      a = ((uint64_t)p[0] << 16) | ((uint64_t)p[len >> 1] << 8) | p[len - 1];
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    size_t i = len;
+    if (i > 48) {
+      uint64_t seed1 = seed, seed2 = seed;
+      do {
+        seed = mulFold(read64(p) ^ s1, read64(p + 8) ^ seed);
+        seed1 = mulFold(read64(p + 16) ^ s2, read64(p + 24) ^ seed1);
+        seed2 = mulFold(read64(p + 32) ^ s3, read64(p + 40) ^ seed2);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+      seed ^= seed1 ^ seed2;
+    }
+    while (i > 16) {
+      seed = mulFold(read64(p) ^ s1, read64(p + 8) ^ seed);
+      i -= 16;
+      p += 16;
+    }
+    a = read64(p + i - 16);
+    b = read64(p + i - 8);
+  }
+  a ^= s1;
+  b ^= seed;
+  __uint128_t product = (__uint128_t)a * b;
+  a = (uint64_t)product;
+  b = (uint64_t)(product >> 64);
+  return mulFold(a ^ s0 ^ len, b ^ s1);
+}
+
+/**
+ * @brief         A hash with the structure of XXH3-64: separate paths for
+ *                1-3, 4-8, 9-16 and 17-128 bytes that mix the input with a
+ *                secret, and 16-byte stripes beyond that
+ *
+ * The secret is generated rather than XXH3's, and long inputs take a single
+ * stripe loop instead of XXH3's accumulators, so the values differ from
+ * XXH3's. Keys in this project are short, where the two are alike.
+ */
+inline uint64_t xxh3Style(const void *key, size_t len, uint64_t seed = 0) {
+  using namespace hashing;
+  constexpr uint64_t prime1 = 0x9e3779b185ebca87ULL;
+  constexpr uint64_t prime2 = 0xc2b2ae3d27d4eb4fULL;
+  constexpr uint64_t prime3 = 0x165667b19e3779f9ULL;
+  // splitmix64 of 0..15
+  static constexpr std::array<uint64_t, 16> secret = []() {
+    std::array<uint64_t, 16> words{};
+    uint64_t state = 0;
+    for (uint64_t &word : words) {
+      uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+      word = z ^ (z >> 31);
+    }
+    return words;
+  }();
+  auto avalanche = [](uint64_t h) {
+    h ^= h >> 37;
+    h *= 0x165667919e3779f9ULL;
+    return h ^ (h >> 32);
+  };
+  auto mix16 = [&](const unsigned char *p, size_t word) {
+    return mulFold(read64(p) ^ (secret[word] + seed),
+                   read64(p + 8) ^ (secret[word + 1] - seed));
+  };
+  const unsigned char *p = static_cast<const unsigned char *>(key);
+
+  if (len == 0)
+    return avalanche(seed ^ secret[7] ^ secret[8]);
+  if (len <= 3) {
+    uint64_t combined = ((uint64_t)p[0] << 16) |
+                        ((uint64_t)p[len >> 1] << 24) | p[len - 1] |
+                        (len << 8);
+    uint64_t h = combined ^ ((secret[0] ^ (secret[0] >> 32)) + seed);
+    h ^= h >> 33;
+    h *= prime2;
+    h ^= h >> 29;
+    h *= prime3;
+    return h ^ (h >> 32);
+  }
+  if (len <= 8) {
+    uint64_t h = (read32(p + len - 4) + (read32(p) << 32)) ^
+                 ((secret[1] ^ secret[2]) - seed);
+    h ^= rotl(h, 49) ^ rotl(h, 24);
+    h *= 0x9fb21c651e98df25ULL;
+    h ^= (h >> 35) + len;
+    h *= 0x9fb21c651e98df25ULL;
+    return h ^ (h >> 28);
+  }
+  if (len <= 16) {
+    uint64_t low = read64(p) ^ ((secret[3] ^ secret[4]) + seed);
+    uint64_t high = read64(p + len - 8) ^ ((secret[5] ^ secret[6]) - seed);
+    return avalanche(len + __builtin_bswap64(low) + high +
+                     mulFold(low, high));
+  }
+  uint64_t acc = len * prime1;
+  if (len <= 128) {
+    // pairs of stripes from both ends, meeting in the middle
+    if (len > 32) {
+      if (len > 64) {
+        if (len > 96)
+          acc += mix16(p + 48, 12) + mix16(p + len - 64, 14);
+        acc += mix16(p + 32, 8) + mix16(p + len - 48, 10);
+      }
+      acc += mix16(p + 16, 4) + mix16(p + len - 32, 6);
+    }
+    return avalanche(acc + mix16(p, 0) + mix16(p + len - 16, 2));
+  }
+  size_t stripes = len / 16;
+  for (size_t i = 0; i < stripes; ++i)
+    acc += mix16(p + 16 * i, (2 * i) % 14);
+  return avalanche(acc + mix16(p + len - 16, 14));
+}
+
+// CRC32C (Castagnoli) one byte at a time, the portable fallback
+inline uint32_t crc32cSoftware(const void *key, size_t len,
+                               uint32_t crc = 0xffffffff) {
+  static constexpr std::array<uint32_t, 256> table = []() {
+    std::array<uint32_t, 256> entries{};
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t entry = i;
+      for (int bit = 0; bit < 8; ++bit)
+        entry = (entry >> 1) ^ (0x82f63b78 & (0 - (entry & 1)));
+      entries[i] = entry;
+    }
+    return entries;
+  }();
+  const unsigned char *p = static_cast<const unsigned char *>(key);
+  for (size_t i = 0; i < len; ++i)
+    crc = (crc >> 8) ^ table[(crc ^ p[i]) & 0xff];
+  return crc;
+}
+
+/**
+ * @brief         CRC32C of the bytes, with the SSE4.2 crc32 instruction over
+ *                8 bytes at a time when it is available
+ *
+ * The value has only 32 bits, so full-hash collisions appear from about
+ * 100k keys on (10M keys give some 11k pairs).
+ */
+inline uint32_t crc32c(const void *key, size_t len) {
+#ifdef __SSE4_2__
+  const unsigned char *p = static_cast<const unsigned char *>(key);
+  uint64_t crc = 0xffffffff;
+  for (; len >= 8; len -= 8, p += 8)
+    crc = _mm_crc32_u64(crc, hashing::read64(p));
+  uint32_t crc32 = (uint32_t)crc;
+  for (; len > 0; --len, ++p)
+    crc32 = _mm_crc32_u8(crc32, *p);
+  return ~crc32;
+#else
+  return ~crc32cSoftware(key, len);
+#endif
+}
+
+/**
+ * @brief         Multiply-mix with 64-bit multiplies only: four independent
+ *                lanes over 32-byte blocks, which vectorize, then the words
+ *                of the tail (overlapping the block before), a merge of the
+ *                lanes and MurmurHash3's finalizer
+ *
+ * Keys of up to 16 bytes skip the lanes: their two overlapping words are
+ * multiplied and finalized directly.
+ */
+inline uint64_t multiplyMix(const void *key, size_t len, uint64_t seed = 0) {
+  using namespace hashing;
+  constexpr uint64_t k[4] = {0x9e3779b97f4a7c15ULL, 0xc2b2ae3d27d4eb4fULL,
+                             0x165667b19e3779f9ULL, 0xd6e8feb86659fd93ULL};
+  const unsigned char *p = static_cast<const unsigned char *>(key);
+  uint64_t h = seed ^ (len * k[0]);
+  if (len < 8) {
+    // the bytes in the low end, the length keeps trailing zeros apart
+    uint64_t word = 0;
+    std::memcpy(&word, p, len);
+    return fmix64(h ^ (word * k[1]));
+  }
+  if (len <= 16) {
+    // two overlapping words, multiplied independently
+    uint64_t first = read64(p) * k[1], last = read64(p + len - 8) * k[2];
+    return fmix64(h ^ first ^ rotl(last, 31));
+  }
+  uint64_t lanes[4] = {h, h ^ k[1], h ^ k[2], h ^ k[3]};
+  size_t i = 0;
+  for (; i + 32 <= len; i += 32) {
+    for (int lane = 0; lane < 4; ++lane) {
+      uint64_t mixed = (lanes[lane] ^ read64(p + i + 8 * lane)) * k[lane];
+      lanes[lane] = mixed ^ (mixed >> 29);
+    }
+  }
+  for (int lane = 0; i < len; i = std::min(i + 8, len), ++lane) {
+    uint64_t word = read64(p + std::min(i, len - 8));
+    uint64_t mixed = (lanes[lane] ^ word) * k[lane];
+    lanes[lane] = mixed ^ (mixed >> 29);
+  }
+  return fmix64(lanes[0] + rotl(lanes[1], 17) + rotl(lanes[2], 31) +
+                rotl(lanes[3], 47));
+}
+
+struct WyHash {
+  size_t operator()(const std::string &key) const {
+    return wyhash(key.data(), key.size());
+  }
+};
+
+struct Xxh3StyleHash {
+  size_t operator()(const std::string &key) const {
+    return xxh3Style(key.data(), key.size());
+  }
+};
+
+struct Crc32cHash {
+  size_t operator()(const std::string &key) const {
+    return crc32c(key.data(), key.size());
+  }
+};
+
+struct MultiplyMixHash {
+  size_t operator()(const std::string &key) const {
+    return multiplyMix(key.data(), key.size());
+  }
+};
+
+#endif // PROJECT_DB_HASHES_H
@@ -0,0 +1,164 @@
+#ifndef PROJECT_DB_LATENCYHISTOGRAM_H
+#define PROJECT_DB_LATENCYHISTOGRAM_H
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/**
+ * @brief         Cheap timestamps for timing single operations
+ *
+ * Uses the time stamp counter on x86 (calibrated once against steady_clock,
+ * which busy-waits 20 ms on the first call of nsPerTick()) and steady_clock
+ * elsewhere.
+ */
+class TickClock {
+public:
+  static uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+#endif
+  }
+
+  static double nsPerTick() {
+#if defined(__x86_64__) || defined(__i386__)
+    static const double scale = calibrate();
+    return scale;
+#else
+    return 1.0;
+#endif
+  }
+
+  static uint64_t toNs(uint64_t ticks) {
+    return (uint64_t)((double)ticks * nsPerTick());
+  }
+
+private:
+  static double calibrate() {
+    using namespace std::chrono;
+    auto start = steady_clock::now();
+    uint64_t startTicks = now();
+    while (steady_clock::now() - start < milliseconds(20)) {
+    }
+    uint64_t ticks = now() - startTicks;
+    auto ns = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+    return (double)ns / (double)ticks;
+  }
+};
+
+/**
+ * @brief         Log-bucketed latency histogram in nanoseconds
+ *
+ * Values below 32 get a bucket each; every power of two above is split into
+ * 32 linear sub-buckets, so a reported percentile is at most ~3% above the
+ * recorded value. Recording is a couple of bit operations and an increment.
+ */
+class LatencyHistogram {
+public:
+  // The percentiles written to the results
+  struct Summary {
+    uint64_t p50 = 0;
+    uint64_t p90 = 0;
+    uint64_t p99 = 0;
+    uint64_t p999 = 0;
+    uint64_t max = 0;
+
+    // CSV column names, e.g. InsertP50(ns),...,InsertMax(ns)
+    static std::string header(const std::string &prefix) {
+      return prefix + "P50(ns)," + prefix + "P90(ns)," + prefix + "P99(ns)," +
+             prefix + "P99.9(ns)," + prefix + "Max(ns)";
+    }
+    friend std::ostream &operator<<(std::ostream &os, const Summary &s) {
+      return os << s.p50 << "," << s.p90 << "," << s.p99 << "," << s.p999
+                << "," << s.max;
+    }
+  };
+
+  // Calibrate the clock now rather than in the first time(), where it would
+  // count towards the operation timed and the phase around it
+  LatencyHistogram() { TickClock::nsPerTick(); }
+
+  void record(uint64_t ns) {
+    ++counts[bucketOf(ns)];
+    ++total;
+    if (ns > maxValue)
+      maxValue = ns;
+  }
+
+  // time one call of op and record it
+  template <typename Op> void time(Op &&op) {
+    uint64_t start = TickClock::now();
+    op();
+    record(TickClock::toNs(TickClock::now() - start));
+  }
+
+  void merge(const LatencyHistogram &other) {
+    for (size_t i = 0; i < bucketCount; ++i)
+      counts[i] += other.counts[i];
+    total += other.total;
+    if (other.maxValue > maxValue)
+      maxValue = other.maxValue;
+  }
+
+  size_t count() const { return total; }
+
+  // the smallest recorded bucket bound that covers p percent of the values
+  uint64_t percentile(double p) const {
+    if (total == 0)
+      return 0;
+    auto target = (uint64_t)std::ceil(p / 100.0 * (double)total);
+    if (target == 0)
+      target = 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < bucketCount; ++i) {
+      seen += counts[i];
+      if (seen >= target)
+        return upperBound(i) < maxValue ? upperBound(i) : maxValue;
+    }
+    return maxValue;
+  }
+
+  Summary summary() const {
+    return {percentile(50), percentile(90), percentile(99), percentile(99.9),
+            maxValue};
+  }
+
+private:
+  static constexpr unsigned subBucketBits = 5;
+  static constexpr size_t subBuckets = size_t(1) << subBucketBits;
+  static constexpr size_t bucketCount = (64 - subBucketBits + 1) * subBuckets;
+
+  std::array<uint64_t, bucketCount> counts{};
+  uint64_t total = 0;
+  uint64_t maxValue = 0;
+
+  static size_t bucketOf(uint64_t value) {
+    if (value < subBuckets)
+      return (size_t)value;
+    unsigned msb = 63 - (unsigned)__builtin_clzll(value);
+    unsigned shift = msb - subBucketBits;
+    return (shift + 1) * subBuckets + (size_t)((value >> shift) - subBuckets);
+  }
+
+  static uint64_t upperBound(size_t bucket) {
+    if (bucket < subBuckets)
+      return bucket;
+    size_t shift = bucket / subBuckets - 1;
+    uint64_t lower = (uint64_t)(subBuckets + bucket % subBuckets) << shift;
+    return lower + ((uint64_t(1) << shift) - 1);
+  }
+};
+
+#endif // PROJECT_DB_LATENCYHISTOGRAM_H
@@ -0,0 +1,231 @@
+#ifndef PROJECT_DB_NODEINDEXES_H
+#define PROJECT_DB_NODEINDEXES_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "NodeSearch.h"
+
+// Prefetch the cache lines of [data, data + bytes), at most eight of them
+inline void prefetchLines(const void *data, size_t bytes) {
+  const char *p = static_cast<const char *>(data);
+  size_t lines = std::min<size_t>((bytes + 63) / 64, 8);
+  for (size_t i = 0; i < lines; ++i)
+    __builtin_prefetch(p + i * 64);
+}
+
+/**
+ * @brief         The sorted indexes of one B+ tree node
+ *
+ * A vector with the modifiers the tree uses. Elements are replaced with set()
+ * instead of through a reference, so that specializations can keep search
+ * structures next to the indexes.
+ */
+template <typename Key> class NodeIndexes {
+private:
+  std::vector<Key> keys;
+
+public:
+  using const_iterator = typename std::vector<Key>::const_iterator;
+
+  size_t size() const { return keys.size(); }
+  bool empty() const { return keys.empty(); }
+  const Key &operator[](size_t i) const { return keys[i]; }
+  const Key &front() const { return keys.front(); }
+  const Key &back() const { return keys.back(); }
+  const_iterator begin() const { return keys.begin(); }
+  const_iterator end() const { return keys.end(); }
+
+  void set(size_t i, const Key &key) { keys[i] = key; }
+  void insert(const_iterator pos, const Key &key) { keys.insert(pos, key); }
+  template <typename Iterator>
+  void insert(const_iterator pos, Iterator first, Iterator last) {
+    keys.insert(pos, first, last);
+  }
+  void emplace_back(const Key &key) { keys.emplace_back(key); }
+  template <typename Iterator> void assign(Iterator first, Iterator last) {
+    keys.assign(first, last);
+  }
+  void erase(const_iterator pos) { keys.erase(pos); }
+  void erase(const_iterator first, const_iterator last) {
+    keys.erase(first, last);
+  }
+  void pop_back() { keys.pop_back(); }
+  void resize(size_t count) { keys.resize(count); }
+
+  // prefetch what a search reads
+  void prefetch() const {
+    prefetchLines(keys.data(), keys.size() * sizeof(Key));
+  }
+
+  // position of the first index not less (or greater) than key
+  size_t lowerBound(const Key &key) const {
+    return NodeSearch<Key>::lowerBound(keys.data(), keys.size(), key);
+  }
+  size_t upperBound(const Key &key) const {
+    return NodeSearch<Key>::upperBound(keys.data(), keys.size(), key);
+  }
+};
+
+/**
+ * @brief         String indexes with normalized prefixes
+ *
+ * All indexes of a node share a prefix (the common prefix of the first and
+ * last one), which the node keeps a copy of. Next to each index it keeps the 8
+ * bytes after that prefix as a big-endian integer, zero padded, which orders
+ * like the strings themselves. A search compares the key with the common
+ * prefix once, then runs the integral node search over the contiguous
+ * normalized prefixes, and compares full strings only among the indexes whose
+ * normalized prefix ties with the key's.
+ */
+template <> class NodeIndexes<std::string> {
+private:
+  std::vector<std::string> keys;
+  std::vector<uint64_t> prefixes;
+  std::string prefix; // short enough to live in the node in most cases
+
+  static uint64_t normalize(const std::string &key, size_t offset) {
+    uint64_t value = 0;
+    if (key.size() > offset)
+      std::memcpy(&value, key.data() + offset,
+                  std::min<size_t>(sizeof(value), key.size() - offset));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    value = __builtin_bswap64(value);
+#endif
+    return value;
+  }
+
+  static size_t sharedLength(const std::string &a, const std::string &b) {
+    size_t length = std::min(a.size(), b.size());
+    return (size_t)(std::mismatch(a.begin(), a.begin() + (long)length,
+                                  b.begin())
+                        .first -
+                    a.begin());
+  }
+
+  // Recompute the common prefix and every normalized prefix
+  void rebuild() {
+    if (keys.empty())
+      prefix.clear();
+    else
+      prefix.assign(keys.front(), 0, sharedLength(keys.front(), keys.back()));
+    prefixes.resize(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i)
+      prefixes[i] = normalize(keys[i], prefix.size());
+  }
+
+  // keys[pos] was stored: its normalized prefix is updated, or everything is
+  // rebuilt if it does not start with the shared prefix. A shared prefix that
+  // is shorter than it could be after erases is still valid, so it is only
+  // extended again when the node is rebuilt.
+  void stored(size_t pos, bool inserted) {
+    if (keys.size() == 1 || keys[pos].compare(0, prefix.size(), prefix) != 0) {
+      rebuild();
+      return;
+    }
+    uint64_t normalized = normalize(keys[pos], prefix.size());
+    if (inserted)
+      prefixes.insert(prefixes.begin() + (long)pos, normalized);
+    else
+      prefixes[pos] = normalized;
+  }
+
+  // [first, last) of the normalized prefixes that tie with key, or false if
+  // the key sorts before (first = last = 0) or after all indexes
+  bool candidates(const std::string &key, size_t &first, size_t &last) const {
+    first = last = 0;
+    if (keys.empty())
+      return false;
+    int order = key.compare(0, prefix.size(), prefix);
+    if (order != 0) {
+      first = last = order < 0 ? 0 : keys.size();
+      return false;
+    }
+    uint64_t probe = normalize(key, prefix.size());
+    first = NodeSearch<uint64_t>::lowerBound(prefixes.data(), prefixes.size(),
+                                             probe);
+    last = first;
+    while (last < prefixes.size() && prefixes[last] == probe)
+      ++last;
+    return first != last;
+  }
+
+public:
+  using const_iterator = std::vector<std::string>::const_iterator;
+
+  size_t size() const { return keys.size(); }
+  bool empty() const { return keys.empty(); }
+  const std::string &operator[](size_t i) const { return keys[i]; }
+  const std::string &front() const { return keys.front(); }
+  const std::string &back() const { return keys.back(); }
+  const_iterator begin() const { return keys.begin(); }
+  const_iterator end() const { return keys.end(); }
+
+  void set(size_t i, const std::string &key) {
+    keys[i] = key;
+    stored(i, false);
+  }
+  void insert(const_iterator pos, const std::string &key) {
+    auto i = pos - keys.begin();
+    keys.insert(pos, key);
+    stored((size_t)i, true);
+  }
+  template <typename Iterator>
+  void insert(const_iterator pos, Iterator first, Iterator last) {
+    keys.insert(pos, first, last);
+    rebuild();
+  }
+  void emplace_back(const std::string &key) {
+    keys.emplace_back(key);
+    stored(keys.size() - 1, true);
+  }
+  template <typename Iterator> void assign(Iterator first, Iterator last) {
+    keys.assign(first, last);
+    rebuild();
+  }
+  void erase(const_iterator pos) {
+    prefixes.erase(prefixes.begin() + (pos - keys.begin()));
+    keys.erase(pos);
+  }
+  void erase(const_iterator first, const_iterator last) {
+    prefixes.erase(prefixes.begin() + (first - keys.begin()),
+                   prefixes.begin() + (last - keys.begin()));
+    keys.erase(first, last);
+  }
+  void pop_back() {
+    keys.pop_back();
+    prefixes.pop_back();
+  }
+  // after a split, the remaining half may share a longer prefix
+  void resize(size_t count) {
+    keys.resize(count);
+    rebuild();
+  }
+
+  void prefetch() const {
+    prefetchLines(prefixes.data(), prefixes.size() * sizeof(uint64_t));
+  }
+
+  size_t lowerBound(const std::string &key) const {
+    size_t first, last;
+    if (!candidates(key, first, last))
+      return first;
+    return (size_t)(std::lower_bound(keys.begin() + (long)first,
+                                     keys.begin() + (long)last, key) -
+                    keys.begin());
+  }
+  size_t upperBound(const std::string &key) const {
+    size_t first, last;
+    if (!candidates(key, first, last))
+      return first;
+    return (size_t)(std::upper_bound(keys.begin() + (long)first,
+                                     keys.begin() + (long)last, key) -
+                    keys.begin());
+  }
+};
+
+#endif // PROJECT_DB_NODEINDEXES_H
@@ -0,0 +1,95 @@
+#ifndef PROJECT_DB_NODEPOOL_H
+#define PROJECT_DB_NODEPOOL_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief         Slab allocator for fixed-size nodes
+ *
+ * Nodes are carved out of contiguous slabs of `NodesPerSlab` slots, and
+ * destroyed nodes are pushed onto an intrusive free list so that the next
+ * `create` reuses their slot. The pool never returns memory to the system
+ * before it is destroyed; the owner must `destroy` every live node first.
+ *
+ * @tparam        T
+ * @tparam        NodesPerSlab
+ */
+template <typename T, size_t NodesPerSlab = 256> class NodePool {
+private:
+  union Slot {
+    Slot *next; // the next free slot, only valid while the slot is free
+    alignas(T) unsigned char storage[sizeof(T)];
+  };
+
+  std::vector<std::unique_ptr<Slot[]>> slabs;
+  Slot *freeList;
+  size_t used; // #of slots handed out from the last slab
+
+public:
+  NodePool() : slabs(), freeList(nullptr), used(NodesPerSlab) {}
+  NodePool(const NodePool &) = delete;
+  NodePool &operator=(const NodePool &) = delete;
+  NodePool(NodePool &&other) noexcept
+      : slabs(std::move(other.slabs)),
+        freeList(std::exchange(other.freeList, nullptr)),
+        used(std::exchange(other.used, NodesPerSlab)) {}
+  NodePool &operator=(NodePool &&other) noexcept {
+    slabs = std::move(other.slabs);
+    freeList = std::exchange(other.freeList, nullptr);
+    used = std::exchange(other.used, NodesPerSlab);
+    return *this;
+  }
+
+  // construct a node in a recycled slot, or in the next slot of the slab
+  template <typename... Args> T *create(Args &&...args) {
+    Slot *slot;
+    if (freeList) {
+      slot = freeList;
+      freeList = freeList->next;
+    } else {
+      if (used == NodesPerSlab) {
+        slabs.emplace_back(new Slot[NodesPerSlab]);
+        used = 0;
+      }
+      slot = &slabs.back()[used++];
+    }
+    return ::new (static_cast<void *>(slot->storage))
+        T(std::forward<Args>(args)...);
+  }
+
+  // destroy the node and put its slot on the free list
+  void destroy(T *node) {
+    node->~T();
+    Slot *slot = reinterpret_cast<Slot *>(node);
+    slot->next = freeList;
+    freeList = slot;
+  }
+};
+
+/**
+ * @brief         Allocator that creates every node with its own new/delete
+ *
+ * @tparam        T
+ */
+template <typename T> class HeapNodeAllocator {
+public:
+  template <typename... Args> T *create(Args &&...args) {
+    return new T(std::forward<Args>(args)...);
+  }
+  void destroy(T *node) { delete node; }
+};
+
+// Node allocation policies for BpTree
+struct PooledNodes {
+  template <typename T> using Allocator = NodePool<T>;
+};
+
+struct HeapNodes {
+  template <typename T> using Allocator = HeapNodeAllocator<T>;
+};
+
+#endif // PROJECT_DB_NODEPOOL_H
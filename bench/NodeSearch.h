@@ -0,0 +1,153 @@
+#ifndef PROJECT_DB_NODESEARCH_H
+#define PROJECT_DB_NODESEARCH_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief         Search within the sorted indexes of one node
+ *
+ * lowerBound is the position of the first index not less than key, upperBound
+ * of the first index greater than key. The generic version is a binary
+ * search; integral keys get their own below.
+ */
+template <typename Key, typename = void> struct NodeSearch {
+  // indexes per leaf for trees built with the default constructor
+  static constexpr size_t preferredKeys = 16;
+
+  static size_t lowerBound(const Key *keys, size_t count, const Key &key) {
+    return (size_t)(std::lower_bound(keys, keys + count, key) - keys);
+  }
+  static size_t upperBound(const Key *keys, size_t count, const Key &key) {
+    return (size_t)(std::upper_bound(keys, keys + count, key) - keys);
+  }
+};
+
+/**
+ * @brief         Integral keys: branch-free halving down to a window of a few
+ *                cache lines, then the keys below key are counted with SIMD
+ *                compares (AVX2, or SSE when that is all the target has)
+ */
+template <typename Key>
+struct NodeSearch<Key, std::enable_if_t<std::is_integral_v<Key> &&
+                                        !std::is_same_v<Key, bool>>> {
+  // two cache lines of indexes per leaf
+  static constexpr size_t preferredKeys =
+      std::clamp<size_t>(128 / sizeof(Key), 16, 64);
+
+  static size_t lowerBound(const Key *keys, size_t count, const Key &key) {
+    const Key *first = narrow<false>(keys, count, key);
+    return (size_t)(first - keys) + countBelow<false>(first, count, key);
+  }
+  static size_t upperBound(const Key *keys, size_t count, const Key &key) {
+    const Key *first = narrow<true>(keys, count, key);
+    return (size_t)(first - keys) + countBelow<true>(first, count, key);
+  }
+
+private:
+  static constexpr size_t linearWindow = 256 / sizeof(Key);
+
+  // Halve [keys, keys + count) until it fits the window, keeping the bound
+  // inside it
+  template <bool orEqual>
+  static const Key *narrow(const Key *keys, size_t &count, Key key) {
+    while (count > linearWindow) {
+      size_t half = count / 2;
+      Key probe = keys[half - 1];
+      keys = (orEqual ? probe <= key : probe < key) ? keys + half : keys;
+      count -= half;
+    }
+    return keys;
+  }
+
+  // Keys are compared as signed lanes, unsigned ones with the sign bit flipped
+  using Lane = std::conditional_t<sizeof(Key) == 4, int32_t, int64_t>;
+  static constexpr Lane bias =
+      std::is_signed_v<Key> ? 0
+                            : (Lane)((uint64_t)1 << (8 * sizeof(Lane) - 1));
+
+#if defined(__AVX2__)
+  using Vector = __m256i;
+  static constexpr bool vectorized = sizeof(Key) == 4 || sizeof(Key) == 8;
+  static Vector load(const Key *p) {
+    return _mm256_loadu_si256(reinterpret_cast<const Vector *>(p));
+  }
+  static Vector broadcast(Lane value) {
+    if constexpr (sizeof(Key) == 4)
+      return _mm256_set1_epi32(value);
+    else
+      return _mm256_set1_epi64x(value);
+  }
+  static Vector flip(Vector v) {
+    return _mm256_xor_si256(v, broadcast(bias));
+  }
+  static Vector greater(Vector a, Vector b) {
+    if constexpr (sizeof(Key) == 4)
+      return _mm256_cmpgt_epi32(a, b);
+    else
+      return _mm256_cmpgt_epi64(a, b);
+  }
+  static unsigned mask(Vector v) { return (unsigned)_mm256_movemask_epi8(v); }
+#elif defined(__SSE2__)
+  using Vector = __m128i;
+#ifdef __SSE4_2__
+  static constexpr bool vectorized = sizeof(Key) == 4 || sizeof(Key) == 8;
+#else
+  static constexpr bool vectorized = sizeof(Key) == 4;
+#endif
+  static Vector load(const Key *p) {
+    return _mm_loadu_si128(reinterpret_cast<const Vector *>(p));
+  }
+  static Vector broadcast(Lane value) {
+    if constexpr (sizeof(Key) == 4)
+      return _mm_set1_epi32(value);
+    else
+      return _mm_set1_epi64x(value);
+  }
+  static Vector flip(Vector v) { return _mm_xor_si128(v, broadcast(bias)); }
+  static Vector greater(Vector a, Vector b) {
+    if constexpr (sizeof(Key) == 4)
+      return _mm_cmpgt_epi32(a, b);
+#ifdef __SSE4_2__
+    else
+      return _mm_cmpgt_epi64(a, b);
+#else
+    else
+      return a; // not vectorized
+#endif
+  }
+  static unsigned mask(Vector v) { return (unsigned)_mm_movemask_epi8(v); }
+#else
+  static constexpr bool vectorized = false;
+#endif
+
+  // Number of keys less than key, or not greater than it if orEqual. Whole
+  // vectors are compared at once, the tail one key at a time.
+  template <bool orEqual>
+  static size_t countBelow(const Key *keys, size_t count, Key key) {
+    size_t below = 0, i = 0;
+#if defined(__SSE2__) || defined(__AVX2__)
+    if constexpr (vectorized) {
+      constexpr size_t lanes = sizeof(Vector) / sizeof(Key);
+      const Vector target = broadcast((Lane)key ^ bias);
+      for (; i + lanes <= count; i += lanes) {
+        Vector v = flip(load(keys + i));
+        Vector hit = orEqual ? greater(v, target) : greater(target, v);
+        size_t n = (size_t)__builtin_popcount(mask(hit)) / sizeof(Key);
+        below += orEqual ? lanes - n : n;
+      }
+    }
+#endif
+    for (; i < count; ++i)
+      below += orEqual ? keys[i] <= key : keys[i] < key;
+    return below;
+  }
+};
+
+#endif // PROJECT_DB_NODESEARCH_H
@@ -0,0 +1,235 @@
+#ifndef PROJECT_DB_OLCBPTREE_H
+#define PROJECT_DB_OLCBPTREE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief         Version latch for optimistic lock coupling
+ *
+ * The lowest bit is the lock, the rest counts the modifications. Readers take
+ * no lock: they remember the version, read, and validate that the version is
+ * unchanged. Writers upgrade a version they read to the lock with a CAS, which
+ * fails if anybody wrote in between, and bump the version on unlock.
+ */
+class OptimisticLatch {
+private:
+  std::atomic<uint64_t> word{0};
+
+  static bool isLocked(uint64_t version) { return (version & 1) == 1; }
+
+public:
+  // Wait until the latch is free and return its version
+  uint64_t readLock() const {
+    uint64_t version = word.load(std::memory_order_acquire);
+    while (isLocked(version)) {
+#if defined(__x86_64__) || defined(__i386__)
+      _mm_pause();
+#else
+      std::this_thread::yield();
+#endif
+      version = word.load(std::memory_order_acquire);
+    }
+    return version;
+  }
+
+  // true if nothing was written since version was read
+  bool validate(uint64_t version) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return word.load(std::memory_order_relaxed) == version;
+  }
+
+  // Lock exclusively, fails if anything was written since version was read
+  bool tryUpgrade(uint64_t version) {
+    return word.compare_exchange_strong(version, version + 1,
+                                        std::memory_order_acquire);
+  }
+
+  void unlock() { word.fetch_add(1, std::memory_order_release); }
+};
+
+/**
+ * @brief         B+ tree for concurrent use with optimistic lock coupling
+ *                (Leis et al., "The ART of practical synchronization")
+ *
+ * Lookups and scans take no locks and restart when a node they read changed
+ * underneath them. Writers latch the leaf they modify, and a split latches the
+ * node and its parent; full internal nodes are split on the way down, so a
+ * split never propagates further up.
+ *
+ * Readers may look at a node while it is modified, so data is copied out
+ * instead of being handed out by pointer and has to be trivially copyable.
+ * Indexes that are not trivially copyable are boxed and never change once
+ * created; erased ones are freed with the tree. Nodes are not merged on erase,
+ * so the tree does not shrink.
+ *
+ * @tparam        Fanout , the maximum number of children of an internal node
+ *                and of indexes in a leaf
+ */
+template <typename IndexType, typename DataType, size_t Fanout = 64>
+class OlcBpTree {
+private:
+  static_assert(std::is_trivially_copyable_v<DataType>,
+                "data is copied out optimistically");
+  static_assert(Fanout >= 4 && Fanout <= 65535, "unsupported fanout");
+
+  static constexpr bool inlineIndexes = std::is_trivially_copyable_v<IndexType>;
+  using IndexSlot =
+      std::conditional_t<inlineIndexes, IndexType, const IndexType *>;
+
+  struct alignas(64) Node {
+    OptimisticLatch latch;
+    const bool isLeaf;
+    // published with release, so that the slots below it are visible
+    std::atomic<uint16_t> count{0};
+    IndexSlot indexes[Fanout]{};
+
+    explicit Node(bool isLeaf) : isLeaf(isLeaf) {}
+  };
+
+  struct Leaf : Node {
+    DataType data[Fanout]{};
+    std::atomic<Leaf *> next{nullptr};
+
+    Leaf() : Node(true) {}
+  };
+
+  // count indexes separate count + 1 children, at most Fanout - 1 indexes
+  struct Inner : Node {
+    Node *children[Fanout]{};
+
+    Inner() : Node(false) {}
+  };
+
+  std::atomic<Node *> root;
+  std::mutex retiredMutex;
+  std::vector<const IndexType *> retired; // erased boxed indexes
+
+  static const IndexType &indexOf(const IndexSlot &slot) {
+    if constexpr (inlineIndexes)
+      return slot;
+    else
+      return *slot;
+  }
+  static IndexSlot makeIndex(const IndexType &index) {
+    if constexpr (inlineIndexes)
+      return index;
+    else
+      return new IndexType(index);
+  }
+  void retireIndex(IndexSlot slot);
+
+  // The count of a node that may be modified concurrently, clamped so that a
+  // torn read cannot index out of bounds
+  static size_t countOf(const Node *node, size_t capacity) {
+    return std::min<size_t>(node->count.load(std::memory_order_acquire),
+                            capacity);
+  }
+  // position of the first index not less (or greater) than index
+  static size_t lowerBound(const Node *node, size_t count,
+                           const IndexType &index);
+  static size_t upperBound(const Node *node, size_t count,
+                           const IndexType &index);
+
+  // Descend to the leaf for index, or the leftmost leaf if index is null.
+  // Returns false if a concurrent writer got in the way.
+  bool findLeaf(const IndexType *index, Leaf *&leaf, uint64_t &version) const;
+  // Split node, latching it and its parent. Does nothing if either of them
+  // changed since it was read, the caller restarts in any case.
+  void splitNode(Inner *parent, uint64_t parentVersion, Node *node,
+                 uint64_t version);
+  Leaf *splitLeaf(Leaf *leaf, IndexSlot &separator);
+  Inner *splitInner(Inner *inner, IndexSlot &separator);
+  // Add separator and the child right of it to a latched, non-full node
+  static void insertChild(Inner *inner, IndexSlot separator, Node *child);
+  bool insertOrUpdate(const IndexType &index, const DataType &data,
+                      bool assign);
+  void destroySubtree(Node *node);
+
+public:
+  OlcBpTree() : root(new Leaf()) {}
+
+  OlcBpTree(const OlcBpTree &) = delete;
+  OlcBpTree &operator=(const OlcBpTree &) = delete;
+
+  ~OlcBpTree();
+
+  /**
+   * @brief         Insert a index-data pair into the tree
+   *
+   * @param         index
+   * @param         data
+   * @return        true if the insertion is successful
+   * @return        false if the index already exists
+   */
+  bool insert(const IndexType &index, const DataType &data) {
+    return insertOrUpdate(index, data, false);
+  }
+
+  /**
+   * @brief         Insert a index-data pair, or overwrite the data if the
+   *                index already exists
+   *
+   * @return        true if the index was inserted
+   */
+  bool insertOrAssign(const IndexType &index, const DataType &data) {
+    return insertOrUpdate(index, data, true);
+  }
+
+  /**
+   * @brief         Remove index from the tree
+   *
+   * @param         index
+   * @return        true if the removal is successful
+   * @return        false if the index is not found
+   */
+  bool erase(const IndexType &index);
+
+  /**
+   * @brief         search for a specific index
+   *
+   * @param         index
+   * @param         out , receives a copy of the data if the index is found
+   * @return        true if the index is found
+   */
+  bool search(const IndexType &index, DataType &out) const;
+
+  /**
+   * @brief         Apply f to the data of index while holding its leaf latch
+   *
+   * @tparam        F , called as f(DataType &)
+   * @return        true if the index is found
+   */
+  template <typename F> bool modify(const IndexType &index, F f);
+
+  /**
+   * @brief         Range query in the tree
+   *
+   * Every leaf is read consistently, but the query as a whole is not atomic
+   * with respect to concurrent writers.
+   *
+   * @param         minIndex , if input is std::nullopt, start from the leftmost
+   * @param         maxIndex , if input is std::nullopt, end at the rightmost
+   * @return        std::vector<DataType>, copies of the data in index order
+   */
+  std::vector<DataType> rangeQuery(const std::optional<IndexType> &minIndex,
+                                   const std::optional<IndexType> &maxIndex,
+                                   const bool &leftInclusive = true,
+                                   const bool &rightInclusive = true) const;
+};
+
+#include "OlcBpTreeImpl.h"
+
+#endif // PROJECT_DB_OLCBPTREE_H
@@ -0,0 +1,398 @@
+#ifndef PROJECT_DB_OLCBPTREEIMPL_H
+#define PROJECT_DB_OLCBPTREEIMPL_H
+
+#pragma once
+#include "OlcBpTree.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+template <typename IndexType, typename DataType, size_t Fanout>
+OlcBpTree<IndexType, DataType, Fanout>::~OlcBpTree() {
+  destroySubtree(root.load());
+  for (const IndexType *index : retired)
+    delete index;
+}
+
+// Release a node and all of its descendants, with the indexes of the leaves
+template <typename IndexType, typename DataType, size_t Fanout>
+void OlcBpTree<IndexType, DataType, Fanout>::destroySubtree(Node *node) {
+  size_t count = node->count.load();
+  if (node->isLeaf) {
+    Leaf *leaf = static_cast<Leaf *>(node);
+    if constexpr (!inlineIndexes) {
+      for (size_t i = 0; i < count; ++i)
+        delete leaf->indexes[i];
+    }
+    delete leaf;
+    return;
+  }
+  Inner *inner = static_cast<Inner *>(node);
+  for (size_t i = 0; i <= count; ++i)
+    destroySubtree(inner->children[i]);
+  delete inner;
+}
+
+// Keep an erased boxed index until the tree is destroyed, a reader may still
+// be comparing against it
+template <typename IndexType, typename DataType, size_t Fanout>
+void OlcBpTree<IndexType, DataType, Fanout>::retireIndex(IndexSlot slot) {
+  if constexpr (!inlineIndexes) {
+    std::lock_guard<std::mutex> lock(retiredMutex);
+    retired.push_back(slot);
+  }
+}
+
+template <typename IndexType, typename DataType, size_t Fanout>
+size_t OlcBpTree<IndexType, DataType, Fanout>::lowerBound(
+    const Node *node, size_t count, const IndexType &index) {
+  return (size_t)(std::lower_bound(node->indexes, node->indexes + count, index,
+                                   [](const IndexSlot &slot,
+                                      const IndexType &value) {
+                                     return indexOf(slot) < value;
+                                   }) -
+                  node->indexes);
+}
+
+template <typename IndexType, typename DataType, size_t Fanout>
+size_t OlcBpTree<IndexType, DataType, Fanout>::upperBound(
+    const Node *node, size_t count, const IndexType &index) {
+  return (size_t)(std::upper_bound(node->indexes, node->indexes + count, index,
+                                   [](const IndexType &value,
+                                      const IndexSlot &slot) {
+                                     return value < indexOf(slot);
+                                   }) -
+                  node->indexes);
+}
+
+// Descend to the leaf for index, validating every node after the child
+// pointer has been read from it and once more after the child is latched
+template <typename IndexType, typename DataType, size_t Fanout>
+bool OlcBpTree<IndexType, DataType, Fanout>::findLeaf(const IndexType *index,
+                                                      Leaf *&leaf,
+                                                      uint64_t &version) const {
+  Node *node = root.load(std::memory_order_acquire);
+  version = node->latch.readLock();
+  if (node != root.load(std::memory_order_acquire))
+    return false;
+  while (!node->isLeaf) {
+    const Inner *inner = static_cast<const Inner *>(node);
+    size_t count = countOf(inner, Fanout - 1);
+    Node *child = inner->children[index ? upperBound(inner, count, *index) : 0];
+    if (!inner->latch.validate(version))
+      return false;
+    uint64_t childVersion = child->latch.readLock();
+    if (!inner->latch.validate(version))
+      return false;
+    node = child;
+    version = childVersion;
+  }
+  leaf = static_cast<Leaf *>(node);
+  return true;
+}
+
+// Split the leaf, the upper half moves to a new right sibling
+template <typename IndexType, typename DataType, size_t Fanout>
+typename OlcBpTree<IndexType, DataType, Fanout>::Leaf *
+OlcBpTree<IndexType, DataType, Fanout>::splitLeaf(Leaf *leaf,
+                                                  IndexSlot &separator) {
+  size_t count = leaf->count.load(std::memory_order_relaxed);
+  size_t mid = count / 2;
+  Leaf *right = new Leaf();
+  std::copy(leaf->indexes + mid, leaf->indexes + count, right->indexes);
+  std::copy(leaf->data + mid, leaf->data + count, right->data);
+  right->count.store((uint16_t)(count - mid), std::memory_order_relaxed);
+  right->next.store(leaf->next.load(std::memory_order_relaxed),
+                    std::memory_order_relaxed);
+  separator = right->indexes[0];
+  // the right leaf is complete before a reader can reach it
+  leaf->next.store(right, std::memory_order_release);
+  leaf->count.store((uint16_t)mid, std::memory_order_release);
+  return right;
+}
+
+// Split the internal node, the middle index moves up as the separator
+template <typename IndexType, typename DataType, size_t Fanout>
+typename OlcBpTree<IndexType, DataType, Fanout>::Inner *
+OlcBpTree<IndexType, DataType, Fanout>::splitInner(Inner *inner,
+                                                   IndexSlot &separator) {
+  size_t count = inner->count.load(std::memory_order_relaxed);
+  size_t mid = count / 2;
+  Inner *right = new Inner();
+  separator = inner->indexes[mid];
+  std::copy(inner->indexes + mid + 1, inner->indexes + count, right->indexes);
+  std::copy(inner->children + mid + 1, inner->children + count + 1,
+            right->children);
+  right->count.store((uint16_t)(count - mid - 1), std::memory_order_relaxed);
+  inner->count.store((uint16_t)mid, std::memory_order_release);
+  return right;
+}
+
+template <typename IndexType, typename DataType, size_t Fanout>
+void OlcBpTree<IndexType, DataType, Fanout>::insertChild(Inner *inner,
+                                                         IndexSlot separator,
+                                                         Node *child) {
+  size_t count = inner->count.load(std::memory_order_relaxed);
+  size_t pos = upperBound(inner, count, indexOf(separator));
+  std::copy_backward(inner->indexes + pos, inner->indexes + count,
+                     inner->indexes + count + 1);
+  std::copy_backward(inner->children + pos + 1, inner->children + count + 1,
+                     inner->children + count + 2);
+  inner->indexes[pos] = separator;
+  inner->children[pos + 1] = child;
+  inner->count.store((uint16_t)(count + 1), std::memory_order_release);
+}
+
+template <typename IndexType, typename DataType, size_t Fanout>
+void OlcBpTree<IndexType, DataType, Fanout>::splitNode(Inner *parent,
+                                                       uint64_t parentVersion,
+                                                       Node *node,
+                                                       uint64_t version) {
+  if (parent && !parent->latch.tryUpgrade(parentVersion))
+    return;
+  if (!node->latch.tryUpgrade(version)) {
+    if (parent)
+      parent->latch.unlock();
+    return;
+  }
+  if (!parent && node != root.load(std::memory_order_acquire)) {
+    // the root was split in the meantime
+    node->latch.unlock();
+    return;
+  }
+
+  IndexSlot separator{};
+  Node *right = node->isLeaf
+                    ? static_cast<Node *>(
+                          splitLeaf(static_cast<Leaf *>(node), separator))
+                    : splitInner(static_cast<Inner *>(node), separator);
+  if (parent) {
+    insertChild(parent, separator, right);
+  } else {
+    Inner *newRoot = new Inner();
+    newRoot->indexes[0] = separator;
+    newRoot->children[0] = node;
+    newRoot->children[1] = right;
+    newRoot->count.store(1, std::memory_order_relaxed);
+    root.store(newRoot, std::memory_order_release);
+  }
+  node->latch.unlock();
+  if (parent)
+    parent->latch.unlock();
+}
+
+// Descend like findLeaf, but split every full node on the way, so that the
+// parent of the leaf always has room for a separator
+template <typename IndexType, typename DataType, size_t Fanout>
+bool OlcBpTree<IndexType, DataType, Fanout>::insertOrUpdate(
+    const IndexType &index, const DataType &data, bool assign) {
+  for (;;) {
+    Node *node = root.load(std::memory_order_acquire);
+    uint64_t version = node->latch.readLock();
+    if (node != root.load(std::memory_order_acquire))
+      continue;
+    Inner *parent = nullptr;
+    uint64_t parentVersion = 0;
+    bool restart = false;
+    while (!node->isLeaf) {
+      Inner *inner = static_cast<Inner *>(node);
+      size_t count = countOf(inner, Fanout - 1);
+      if (count == Fanout - 1) {
+        splitNode(parent, parentVersion, inner, version);
+        restart = true;
+        break;
+      }
+      Node *child = inner->children[upperBound(inner, count, index)];
+      if (!inner->latch.validate(version)) {
+        restart = true;
+        break;
+      }
+      uint64_t childVersion = child->latch.readLock();
+      if (!inner->latch.validate(version)) {
+        restart = true;
+        break;
+      }
+      parent = inner;
+      parentVersion = version;
+      node = child;
+      version = childVersion;
+    }
+    if (restart)
+      continue;
+
+    Leaf *leaf = static_cast<Leaf *>(node);
+    size_t count = countOf(leaf, Fanout);
+    size_t pos = lowerBound(leaf, count, index);
+    bool found = pos < count && indexOf(leaf->indexes[pos]) == index;
+    if (found && !assign) {
+      if (!leaf->latch.validate(version))
+        continue;
+      return false;
+    }
+    if (!found && count == Fanout) {
+      splitNode(parent, parentVersion, leaf, version);
+      continue;
+    }
+    // nothing changed since the leaf was read, so count and pos still hold
+    if (!leaf->latch.tryUpgrade(version))
+      continue;
+    if (found) {
+      leaf->data[pos] = data;
+      leaf->latch.unlock();
+      return false;
+    }
+    std::copy_backward(leaf->indexes + pos, leaf->indexes + count,
+                       leaf->indexes + count + 1);
+    std::copy_backward(leaf->data + pos, leaf->data + count,
+                       leaf->data + count + 1);
+    leaf->indexes[pos] = makeIndex(index);
+    leaf->data[pos] = data;
+    leaf->count.store((uint16_t)(count + 1), std::memory_order_release);
+    leaf->latch.unlock();
+    return true;
+  }
+}
+
+template <typename IndexType, typename DataType, size_t Fanout>
+bool OlcBpTree<IndexType, DataType, Fanout>::erase(const IndexType &index) {
+  for (;;) {
+    Leaf *leaf;
+    uint64_t version;
+    if (!findLeaf(&index, leaf, version))
+      continue;
+    size_t count = countOf(leaf, Fanout);
+    size_t pos = lowerBound(leaf, count, index);
+    if (pos == count || !(indexOf(leaf->indexes[pos]) == index)) {
+      if (!leaf->latch.validate(version))
+        continue;
+      return false;
+    }
+    if (!leaf->latch.tryUpgrade(version))
+      continue;
+    IndexSlot erased = leaf->indexes[pos];
+    std::copy(leaf->indexes + pos + 1, leaf->indexes + count,
+              leaf->indexes + pos);
+    std::copy(leaf->data + pos + 1, leaf->data + count, leaf->data + pos);
+    leaf->count.store((uint16_t)(count - 1), std::memory_order_release);
+    leaf->latch.unlock();
+    retireIndex(erased);
+    return true;
+  }
+}
+
+template <typename IndexType, typename DataType, size_t Fanout>
+bool OlcBpTree<IndexType, DataType, Fanout>::search(const IndexType &index,
+                                                    DataType &out) const {
+  for (;;) {
+    Leaf *leaf;
+    uint64_t version;
+    if (!findLeaf(&index, leaf, version))
+      continue;
+    size_t count = countOf(leaf, Fanout);
+    size_t pos = lowerBound(leaf, count, index);
+    if (pos == count || !(indexOf(leaf->indexes[pos]) == index)) {
+      if (!leaf->latch.validate(version))
+        continue;
+      return false;
+    }
+    DataType data = leaf->data[pos];
+    if (!leaf->latch.validate(version))
+      continue;
+    out = data;
+    return true;
+  }
+}
+
+template <typename IndexType, typename DataType, size_t Fanout>
+template <typename F>
+bool OlcBpTree<IndexType, DataType, Fanout>::modify(const IndexType &index,
+                                                    F f) {
+  for (;;) {
+    Leaf *leaf;
+    uint64_t version;
+    if (!findLeaf(&index, leaf, version))
+      continue;
+    size_t count = countOf(leaf, Fanout);
+    size_t pos = lowerBound(leaf, count, index);
+    if (pos == count || !(indexOf(leaf->indexes[pos]) == index)) {
+      if (!leaf->latch.validate(version))
+        continue;
+      return false;
+    }
+    if (!leaf->latch.tryUpgrade(version))
+      continue;
+    f(leaf->data[pos]);
+    leaf->latch.unlock();
+    return true;
+  }
+}
+
+// Walk the leaf chain, validating each leaf before its rows are kept. When a
+// leaf changed underneath, descend again from the last index kept.
+template <typename IndexType, typename DataType, size_t Fanout>
+std::vector<DataType> OlcBpTree<IndexType, DataType, Fanout>::rangeQuery(
+    const std::optional<IndexType> &minIndex,
+    const std::optional<IndexType> &maxIndex, const bool &leftInclusive,
+    const bool &rightInclusive) const {
+  std::vector<DataType> result;
+  std::optional<IndexType> from = minIndex;
+  bool inclusive = leftInclusive;
+  for (;;) {
+    Leaf *leaf;
+    uint64_t version;
+    if (!findLeaf(from ? &*from : nullptr, leaf, version))
+      continue;
+    bool firstLeaf = true;
+    IndexSlot last{}; // the last index kept, boxed indexes stay alive
+    bool kept = false;
+    for (;;) {
+      size_t mark = result.size();
+      size_t count = countOf(leaf, Fanout);
+      size_t i = 0;
+      if (firstLeaf && from) {
+        i = inclusive ? lowerBound(leaf, count, *from)
+                      : upperBound(leaf, count, *from);
+      }
+      bool done = false;
+      IndexSlot leafLast{};
+      for (; i < count; ++i) {
+        const IndexType &index = indexOf(leaf->indexes[i]);
+        if (maxIndex) {
+          if ((rightInclusive && index > *maxIndex) ||
+              (!rightInclusive && index >= *maxIndex)) {
+            done = true;
+            break;
+          }
+        }
+        result.push_back(leaf->data[i]);
+        leafLast = leaf->indexes[i];
+      }
+      Leaf *next = leaf->next.load(std::memory_order_acquire);
+      if (!leaf->latch.validate(version)) {
+        result.erase(result.begin() + mark, result.end());
+        break;
+      }
+      if (result.size() > mark) {
+        last = leafLast;
+        kept = true;
+      }
+      if (done || !next)
+        return result;
+      firstLeaf = false;
+      version = next->latch.readLock();
+      leaf = next;
+    }
+    // restart after the last index kept
+    if (kept) {
+      from = indexOf(last);
+      inclusive = false;
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef PROJECT_DB_PAGEFILE_H
+#define PROJECT_DB_PAGEFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @brief         A file of fixed-size pages, mapped shared into memory
+ *
+ * Pages are read and written in place and reach the file through the page
+ * cache; sync() waits until they are on disk. Growing the file remaps it,
+ * which may move the mapping, so page pointers are only valid until the next
+ * reserve() and callers keep page numbers instead.
+ */
+class PageFile {
+private:
+  int fd = -1;
+  char *bytes = nullptr;
+  size_t pageSize = 0;
+  size_t pages = 0; // pages in the file, all of them mapped
+
+public:
+  PageFile() = default;
+
+  /**
+   * @brief         Map an existing file, or create an empty one
+   *
+   * The file must hold whole pages. isOpen() is false if it cannot be opened
+   * or mapped.
+   */
+  PageFile(const std::string &filename, size_t pageSize)
+      : pageSize(pageSize) {
+    fd = open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+      return;
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size % pageSize != 0) {
+      closeFile();
+      return;
+    }
+    pages = (size_t)info.st_size / pageSize;
+    if (pages > 0 && !map())
+      closeFile();
+  }
+
+  PageFile(const PageFile &) = delete;
+  PageFile &operator=(const PageFile &) = delete;
+  PageFile(PageFile &&other) noexcept
+      : fd(std::exchange(other.fd, -1)),
+        bytes(std::exchange(other.bytes, nullptr)), pageSize(other.pageSize),
+        pages(std::exchange(other.pages, 0)) {}
+  PageFile &operator=(PageFile &&other) noexcept {
+    if (this != &other) {
+      closeFile();
+      fd = std::exchange(other.fd, -1);
+      bytes = std::exchange(other.bytes, nullptr);
+      pageSize = other.pageSize;
+      pages = std::exchange(other.pages, 0);
+    }
+    return *this;
+  }
+
+  ~PageFile() { closeFile(); }
+
+  bool isOpen() const { return fd >= 0; }
+  size_t pageCount() const { return pages; }
+  char *page(uint64_t id) { return bytes + id * pageSize; }
+  const char *page(uint64_t id) const { return bytes + id * pageSize; }
+
+  // Grow the file to at least count pages, new pages are zero
+  bool reserve(size_t count) {
+    if (count <= pages)
+      return true;
+    if (ftruncate(fd, (off_t)(count * pageSize)) != 0)
+      return false;
+    if (!bytes) {
+      pages = count;
+      return map();
+    }
+    void *moved = mremap(bytes, pages * pageSize, count * pageSize,
+                         MREMAP_MAYMOVE);
+    if (moved == MAP_FAILED)
+      return false;
+    bytes = static_cast<char *>(moved);
+    pages = count;
+    return true;
+  }
+
+  // Write the modified pages back and wait for the disk
+  bool sync() {
+    return !bytes || msync(bytes, pages * pageSize, MS_SYNC) == 0;
+  }
+
+private:
+  bool map() {
+    void *mapping = mmap(nullptr, pages * pageSize, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+      bytes = nullptr;
+      return false;
+    }
+    bytes = static_cast<char *>(mapping);
+    return true;
+  }
+
+  void closeFile() {
+    if (bytes)
+      munmap(bytes, pages * pageSize);
+    if (fd >= 0)
+      close(fd);
+    bytes = nullptr;
+    fd = -1;
+    pages = 0;
+  }
+};
+
+#endif // PROJECT_DB_PAGEFILE_H
@@ -0,0 +1,62 @@
+#ifndef PROJECT_DB_PARALLELSORT_H
+#define PROJECT_DB_PARALLELSORT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief         Stable sort that splits the range across threads
+ *
+ * Every thread stable-sorts one chunk, then neighbouring chunks are merged
+ * pairwise (again in parallel) until one sorted run is left. Small ranges
+ * are sorted on the calling thread.
+ *
+ * @param         first
+ * @param         last
+ * @param         comp
+ * @param         threads , #of threads to use, 0 or 1 sorts sequentially
+ */
+template <typename RandomIt, typename Compare>
+void parallelSort(RandomIt first, RandomIt last, Compare comp,
+                  size_t threads) {
+  constexpr size_t minChunk = 1 << 14; // not worth a thread below this
+  auto n = static_cast<size_t>(std::distance(first, last));
+  threads = std::min(threads, n / minChunk);
+  if (threads <= 1) {
+    std::stable_sort(first, last, comp);
+    return;
+  }
+
+  // chunk i covers [bounds[i], bounds[i + 1])
+  std::vector<RandomIt> bounds;
+  for (size_t i = 0; i < threads; ++i)
+    bounds.emplace_back(first + (long)(n * i / threads));
+  bounds.emplace_back(last);
+
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < threads; ++i) {
+    workers.emplace_back(
+        [&, i]() { std::stable_sort(bounds[i], bounds[i + 1], comp); });
+  }
+  for (auto &worker : workers)
+    worker.join();
+
+  // merge runs of width chunks into runs of 2 * width chunks
+  for (size_t width = 1; width < threads; width *= 2) {
+    workers.clear();
+    for (size_t i = 0; i + width < threads; i += 2 * width) {
+      RandomIt lo = bounds[i];
+      RandomIt mid = bounds[i + width];
+      RandomIt hi = bounds[std::min(i + 2 * width, threads)];
+      workers.emplace_back(
+          [lo, mid, hi, &comp]() { std::inplace_merge(lo, mid, hi, comp); });
+    }
+    for (auto &worker : workers)
+      worker.join();
+  }
+}
+
+#endif // PROJECT_DB_PARALLELSORT_H
@@ -0,0 +1,201 @@
+#ifndef PROJECT_DB_PERFCOUNTERS_H
+#define PROJECT_DB_PERFCOUNTERS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief         Hardware event counts of a measured region, or of one
+ *                operation of it after perOperation()
+ *
+ * An event the machine or the kernel does not let us count (no PMU in a
+ * virtual machine, perf_event_paranoid too high, a non-Linux build) is
+ * invalid and written as an empty field.
+ */
+struct PerfStats {
+  enum Event {
+    Cycles,
+    Instructions,
+    L1dMisses,
+    LlcMisses,
+    DtlbMisses,
+    BranchMisses,
+    EventCount
+  };
+  static constexpr const char *names[EventCount] = {
+      "Cycles",    "Instructions", "L1dMisses",
+      "LlcMisses", "DtlbMisses",   "BranchMisses"};
+
+  std::array<double, EventCount> values{};
+  std::array<bool, EventCount> valid{};
+
+  bool has(Event event) const { return valid[event]; }
+  double operator[](Event event) const { return values[event]; }
+
+  /** @brief The counts divided by the number of operations measured */
+  PerfStats perOperation(size_t operations) const {
+    PerfStats stats = *this;
+    for (double &value : stats.values)
+      value = operations ? value / (double)operations : 0;
+    return stats;
+  }
+
+  // the columns of operator<<, each name prefixed (e.g. "InsertCycles")
+  static std::string header(const std::string &prefix) {
+    std::string header;
+    for (const char *name : names)
+      header += (header.empty() ? "" : ",") + prefix + name;
+    return header;
+  }
+  friend std::ostream &operator<<(std::ostream &os, const PerfStats &stats) {
+    for (int event = 0; event < EventCount; ++event) {
+      if (event > 0)
+        os << ",";
+      if (stats.valid[event])
+        os << stats.values[event];
+    }
+    return os;
+  }
+};
+
+/**
+ * @brief         Counts the events of PerfStats for the calling thread with
+ *                perf_event_open, in user space only
+ *
+ * Each event has its own counter, so the ones that open are used even when
+ * others do not. When the kernel multiplexes more events than the PMU has
+ * counters, the counts are scaled up by the time each one ran.
+ */
+class PerfCounters {
+private:
+  std::array<int, PerfStats::EventCount> fds;
+  // the count, the time enabled and the time running of each event
+  using Reading = std::array<uint64_t, 3>;
+  std::array<Reading, PerfStats::EventCount> started{};
+
+#ifdef __linux__
+  static bool readCounts(int fd, Reading &reading) {
+    return fd >= 0 &&
+           read(fd, reading.data(), sizeof(reading)) == sizeof(reading);
+  }
+
+  static int open(uint32_t type, uint64_t config) {
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format =
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+
+  static uint64_t cacheEvent(uint64_t cache, uint64_t result) {
+    return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (result << 16);
+  }
+#endif
+
+public:
+  PerfCounters() {
+    fds.fill(-1);
+#ifdef __linux__
+    fds[PerfStats::Cycles] =
+        open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    fds[PerfStats::Instructions] =
+        open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    fds[PerfStats::L1dMisses] =
+        open(PERF_TYPE_HW_CACHE, cacheEvent(PERF_COUNT_HW_CACHE_L1D,
+                                            PERF_COUNT_HW_CACHE_RESULT_MISS));
+    fds[PerfStats::LlcMisses] =
+        open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    fds[PerfStats::DtlbMisses] =
+        open(PERF_TYPE_HW_CACHE, cacheEvent(PERF_COUNT_HW_CACHE_DTLB,
+                                            PERF_COUNT_HW_CACHE_RESULT_MISS));
+    fds[PerfStats::BranchMisses] =
+        open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+#endif
+  }
+
+  ~PerfCounters() {
+#ifdef __linux__
+    for (int fd : fds) {
+      if (fd >= 0)
+        close(fd);
+    }
+#endif
+  }
+
+  PerfCounters(const PerfCounters &) = delete;
+  PerfCounters &operator=(const PerfCounters &) = delete;
+
+  /** @brief Whether any of the events can be counted */
+  bool available() const {
+    for (int fd : fds) {
+      if (fd >= 0)
+        return true;
+    }
+    return false;
+  }
+
+  /** @brief Reset the counters to zero and start counting */
+  void start() {
+#ifdef __linux__
+    // the reset leaves the times enabled and running as they are, stop()
+    // scales by how much they grew since here
+    for (int event = 0; event < PerfStats::EventCount; ++event) {
+      int fd = fds[event];
+      if (fd < 0)
+        continue;
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      if (!readCounts(fd, started[event]))
+        started[event] = {};
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+
+  /** @brief Stop counting and return the counts since start() */
+  PerfStats stop() {
+    PerfStats stats;
+#ifdef __linux__
+    for (int fd : fds) {
+      if (fd >= 0)
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+    for (int event = 0; event < PerfStats::EventCount; ++event) {
+      Reading counts;
+      if (!readCounts(fds[event], counts))
+        continue;
+      uint64_t enabled = counts[1] - started[event][1];
+      uint64_t running = counts[2] - started[event][2];
+      stats.valid[event] = running > 0;
+      if (stats.valid[event])
+        stats.values[event] = (double)counts[0] * enabled / running;
+    }
+#endif
+    return stats;
+  }
+
+  /** @brief The counts of running op */
+  template <typename Op> PerfStats measure(Op op) {
+    start();
+    op();
+    return stop();
+  }
+};
+
+#endif // PROJECT_DB_PERFCOUNTERS_H
@@ -0,0 +1,233 @@
+#ifndef PROJECT_DB_STATICBPTREE_H
+#define PROJECT_DB_STATICBPTREE_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "NodePool.h"
+#include "NodeSearch.h"
+
+/**
+ * @brief         B+ tree whose fanout is a template parameter, so that every
+ *                node is one fixed-size block with its indexes, data and
+ *                children in std::arrays
+ *
+ * BpTree sizes its nodes at runtime and keeps their indexes, data and
+ * children in vectors, each behind a pointer of its own. Here a node is
+ * read without following any pointer but the one to it, and the search
+ * within a node covers all Fanout slots, so its steps are fixed at compile
+ * time however full the node is: integral indexes pad the unused slots with
+ * their largest value and use the SIMD search of NodeSearch on the whole
+ * array, other indexes a branch-free binary search. Nodes come
+ * from a NodePool and are aligned to cache lines; leafBytes and innerBytes
+ * tell how many lines or pages a fanout takes.
+ *
+ * Nodes are not merged on erase, so the tree does not shrink.
+ *
+ * @tparam        Fanout , the maximum number of children of an internal node
+ *                and of indexes in a leaf
+ */
+template <typename IndexType, typename DataType, size_t Fanout = 64>
+class StaticBpTree {
+private:
+  static_assert(Fanout >= 4 && Fanout <= UINT32_MAX, "unsupported fanout");
+
+  // integral indexes keep the slots from count on at sentinel
+  static constexpr bool padded =
+      std::is_integral_v<IndexType> && !std::is_same_v<IndexType, bool>;
+  static constexpr IndexType sentinel() {
+    if constexpr (padded)
+      return std::numeric_limits<IndexType>::max();
+    else
+      return IndexType();
+  }
+
+  struct alignas(64) Node {
+    const bool isLeaf;
+    uint32_t count = 0;
+    std::array<IndexType, Fanout> indexes{};
+
+    explicit Node(bool isLeaf) : isLeaf(isLeaf) {
+      if constexpr (padded)
+        indexes.fill(sentinel());
+    }
+
+    // Reset the slots from count on after the node shrank
+    void pad() {
+      if constexpr (padded)
+        std::fill(indexes.begin() + count, indexes.end(), sentinel());
+    }
+  };
+
+  struct Leaf : Node {
+    std::array<DataType, Fanout> data{};
+    Leaf *next = nullptr;
+
+    Leaf() : Node(true) {}
+  };
+
+  // count indexes separate count + 1 children, at most Fanout - 1 indexes
+  struct Inner : Node {
+    std::array<Node *, Fanout> children{};
+
+    Inner() : Node(false) {}
+  };
+
+  // slabs of about 256 KB
+  template <typename T>
+  static constexpr size_t slabNodes =
+      std::max<size_t>(1, (256 << 10) / sizeof(T));
+  NodePool<Leaf, slabNodes<Leaf>> leaves;
+  NodePool<Inner, slabNodes<Inner>> inners;
+  Node *root;
+  size_t count = 0;
+  size_t levels = 1;
+
+  // The internal nodes on the way down to a leaf and the child slot taken
+  // in each, for the splits to walk back up
+  struct Path {
+    std::array<std::pair<Inner *, size_t>, 64> entries;
+    size_t depth = 0;
+
+    void push(Inner *inner, size_t slot) { entries[depth++] = {inner, slot}; }
+    std::pair<Inner *, size_t> pop() { return entries[--depth]; }
+    bool empty() const { return depth == 0; }
+  };
+
+  // the largest power of two not above Fanout, the first step of a search
+  static constexpr size_t firstStep() {
+    size_t step = 1;
+    while (step * 2 <= Fanout)
+      step *= 2;
+    return step;
+  }
+
+  // The number of indexes of node less than index, or not greater than it if
+  // orEqual. pos only ever moves past indexes that are, by the largest steps
+  // first; a step that would leave the node's count still compares a slot in
+  // the array, so every search takes the same steps and the loop unrolls.
+  template <bool orEqual>
+  static size_t countBelow(const Node *node, const IndexType &index) {
+    const IndexType *indexes = node->indexes.data();
+    size_t count = node->count, pos = 0;
+    for (size_t step = firstStep(); step > 0; step /= 2) {
+      const IndexType &probe = indexes[std::min(pos + step, Fanout) - 1];
+      bool below = orEqual ? !(index < probe) : probe < index;
+      pos += step * (size_t)((pos + step <= count) & below);
+    }
+    return pos;
+  }
+
+  // The sentinels are never below index, nor is any slot past count when the
+  // index is the sentinel itself once the result is capped at count
+  static size_t lowerBound(const Node *node, const IndexType &index) {
+    if constexpr (padded)
+      return std::min<size_t>(NodeSearch<IndexType>::lowerBound(
+                                  node->indexes.data(), Fanout, index),
+                              node->count);
+    else
+      return countBelow<false>(node, index);
+  }
+  static size_t upperBound(const Node *node, const IndexType &index) {
+    if constexpr (padded)
+      return std::min<size_t>(NodeSearch<IndexType>::upperBound(
+                                  node->indexes.data(), Fanout, index),
+                              node->count);
+    else
+      return countBelow<true>(node, index);
+  }
+
+  // Find the leaf for index, recording the way down when path is given
+  Leaf *findLeaf(const IndexType &index, Path *path = nullptr) const;
+  Leaf *leftmostLeaf() const;
+  // Insert into the leaf at pos, splitting it first if it is full
+  DataType &insertIntoLeaf(Leaf *leaf, size_t pos, const IndexType &index,
+                           DataType data, Path &path);
+  // Add separator and the child right of it to the parent at the end of
+  // path, splitting parents up the path as they fill
+  void insertChild(Path &path, IndexType separator, Node *child);
+  void destroySubtree(Node *node);
+
+public:
+  // bytes of a leaf and of an internal node
+  static constexpr size_t leafBytes = sizeof(Leaf);
+  static constexpr size_t innerBytes = sizeof(Inner);
+
+  StaticBpTree() : root(leaves.create()) {}
+
+  StaticBpTree(const StaticBpTree &) = delete;
+  StaticBpTree &operator=(const StaticBpTree &) = delete;
+
+  ~StaticBpTree() { destroySubtree(root); }
+
+  /**
+   * @brief         Insert a index-data pair into the tree
+   *
+   * @param         index
+   * @param         data
+   * @return        true if the insertion is successful
+   * @return        false if the index already exists
+   */
+  bool insert(const IndexType &index, const DataType &data);
+
+  /**
+   * @brief         Remove index from the tree
+   *
+   * @param         index
+   * @return        true if the removal is successful
+   * @return        false if the index is not found
+   */
+  bool erase(const IndexType &index);
+
+  /**
+   * @brief         search for a specific index
+   *
+   * @param         index
+   * @return        DataType *, nullptr if not found; valid until the next
+   *                insertion or removal
+   */
+  DataType *search(const IndexType &index);
+  const DataType *search(const IndexType &index) const {
+    return const_cast<StaticBpTree *>(this)->search(index);
+  }
+
+  /**
+   * @brief         Reference to the data of index, inserted with a default
+   *                value if the index does not exist yet
+   */
+  DataType &operator[](const IndexType &index);
+
+  /**
+   * @brief         Range query in the tree
+   *
+   * @param         minIndex , if input is std::nullopt, start from the leftmost
+   * @param         maxIndex , if input is std::nullopt, end at the rightmost
+   * @return        std::vector<DataType *>, valid until the next modification
+   */
+  std::vector<DataType *>
+  rangeQuery(const std::optional<IndexType> &minIndex,
+             const std::optional<IndexType> &maxIndex,
+             const bool &leftInclusive = true,
+             const bool &rightInclusive = true);
+
+  /**
+   * @brief         #of index-data pairs in the tree
+   */
+  size_t size() const { return count; }
+
+  /**
+   * @brief         #of levels, 1 for a tree that is a single leaf
+   */
+  size_t height() const { return levels; }
+};
+
+#include "StaticBpTreeImpl.h"
+
+#endif // PROJECT_DB_STATICBPTREE_H
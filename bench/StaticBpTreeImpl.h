@@ -0,0 +1,214 @@
+#ifndef PROJECT_DB_STATICBPTREEIMPL_H
+#define PROJECT_DB_STATICBPTREEIMPL_H
+
+#pragma once
+#include "StaticBpTree.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// Release a node and all of its descendants
+template <typename IndexType, typename DataType, size_t Fanout>
+void StaticBpTree<IndexType, DataType, Fanout>::destroySubtree(Node *node) {
+  if (node->isLeaf) {
+    leaves.destroy(static_cast<Leaf *>(node));
+    return;
+  }
+  Inner *inner = static_cast<Inner *>(node);
+  for (size_t i = 0; i <= inner->count; ++i)
+    destroySubtree(inner->children[i]);
+  inners.destroy(inner);
+}
+
+// Child i of an internal node holds the indexes from separator i - 1 up to
+// separator i, so the way down takes the first separator greater than index
+template <typename IndexType, typename DataType, size_t Fanout>
+typename StaticBpTree<IndexType, DataType, Fanout>::Leaf *
+StaticBpTree<IndexType, DataType, Fanout>::findLeaf(const IndexType &index,
+                                                    Path *path) const {
+  Node *node = root;
+  while (!node->isLeaf) {
+    Inner *inner = static_cast<Inner *>(node);
+    size_t slot = upperBound(inner, index);
+    if (path)
+      path->push(inner, slot);
+    node = inner->children[slot];
+  }
+  return static_cast<Leaf *>(node);
+}
+
+template <typename IndexType, typename DataType, size_t Fanout>
+typename StaticBpTree<IndexType, DataType, Fanout>::Leaf *
+StaticBpTree<IndexType, DataType, Fanout>::leftmostLeaf() const {
+  Node *node = root;
+  while (!node->isLeaf)
+    node = static_cast<Inner *>(node)->children[0];
+  return static_cast<Leaf *>(node);
+}
+
+template <typename IndexType, typename DataType, size_t Fanout>
+DataType &StaticBpTree<IndexType, DataType, Fanout>::insertIntoLeaf(
+    Leaf *leaf, size_t pos, const IndexType &index, DataType data,
+    Path &path) {
+  if (leaf->count == Fanout) {
+    // the upper half moves to a new right sibling
+    constexpr size_t half = Fanout / 2;
+    Leaf *right = leaves.create();
+    std::move(leaf->indexes.begin() + half, leaf->indexes.end(),
+              right->indexes.begin());
+    std::move(leaf->data.begin() + half, leaf->data.end(),
+              right->data.begin());
+    right->count = Fanout - half;
+    leaf->count = half;
+    leaf->pad();
+    right->next = leaf->next;
+    leaf->next = right;
+    insertChild(path, right->indexes[0], right);
+    if (pos > half) {
+      leaf = right;
+      pos -= half;
+    }
+  }
+  std::move_backward(leaf->indexes.begin() + pos,
+                     leaf->indexes.begin() + leaf->count,
+                     leaf->indexes.begin() + leaf->count + 1);
+  std::move_backward(leaf->data.begin() + pos,
+                     leaf->data.begin() + leaf->count,
+                     leaf->data.begin() + leaf->count + 1);
+  leaf->indexes[pos] = index;
+  leaf->data[pos] = std::move(data);
+  ++leaf->count;
+  ++count;
+  return leaf->data[pos];
+}
+
+template <typename IndexType, typename DataType, size_t Fanout>
+void StaticBpTree<IndexType, DataType, Fanout>::insertChild(
+    Path &path, IndexType separator, Node *child) {
+  // the separator goes in at slot, the child right after it
+  auto add = [](Inner *inner, size_t slot, IndexType &separator,
+                Node *child) {
+    std::move_backward(inner->indexes.begin() + slot,
+                       inner->indexes.begin() + inner->count,
+                       inner->indexes.begin() + inner->count + 1);
+    std::move_backward(inner->children.begin() + slot + 1,
+                       inner->children.begin() + inner->count + 1,
+                       inner->children.begin() + inner->count + 2);
+    inner->indexes[slot] = std::move(separator);
+    inner->children[slot + 1] = child;
+    ++inner->count;
+  };
+
+  while (!path.empty()) {
+    auto [parent, slot] = path.pop();
+    if (parent->count < Fanout - 1) {
+      add(parent, slot, separator, child);
+      return;
+    }
+    // the full parent keeps the separators left of the middle one, which
+    // moves up, and hands the ones right of it to a new sibling
+    constexpr size_t middle = (Fanout - 1) / 2;
+    Inner *right = inners.create();
+    std::move(parent->indexes.begin() + middle + 1,
+              parent->indexes.begin() + (Fanout - 1), right->indexes.begin());
+    std::copy(parent->children.begin() + middle + 1, parent->children.end(),
+              right->children.begin());
+    right->count = Fanout - 2 - middle;
+    parent->count = middle;
+    IndexType promoted = std::move(parent->indexes[middle]);
+    parent->pad();
+    if (slot <= middle)
+      add(parent, slot, separator, child);
+    else
+      add(right, slot - middle - 1, separator, child);
+    separator = std::move(promoted);
+    child = right;
+  }
+
+  Inner *newRoot = inners.create();
+  newRoot->indexes[0] = std::move(separator);
+  newRoot->children[0] = root;
+  newRoot->children[1] = child;
+  newRoot->count = 1;
+  root = newRoot;
+  ++levels;
+}
+
+template <typename IndexType, typename DataType, size_t Fanout>
+bool StaticBpTree<IndexType, DataType, Fanout>::insert(const IndexType &index,
+                                                       const DataType &data) {
+  Path path;
+  Leaf *leaf = findLeaf(index, &path);
+  size_t pos = lowerBound(leaf, index);
+  if (pos < leaf->count && !(index < leaf->indexes[pos]))
+    return false;
+  insertIntoLeaf(leaf, pos, index, data, path);
+  return true;
+}
+
+template <typename IndexType, typename DataType, size_t Fanout>
+bool StaticBpTree<IndexType, DataType, Fanout>::erase(const IndexType &index) {
+  Leaf *leaf = findLeaf(index);
+  size_t pos = lowerBound(leaf, index);
+  if (pos == leaf->count || index < leaf->indexes[pos])
+    return false;
+  std::move(leaf->indexes.begin() + pos + 1,
+            leaf->indexes.begin() + leaf->count, leaf->indexes.begin() + pos);
+  std::move(leaf->data.begin() + pos + 1, leaf->data.begin() + leaf->count,
+            leaf->data.begin() + pos);
+  --leaf->count;
+  leaf->pad();
+  --count;
+  return true;
+}
+
+template <typename IndexType, typename DataType, size_t Fanout>
+DataType *
+StaticBpTree<IndexType, DataType, Fanout>::search(const IndexType &index) {
+  Leaf *leaf = findLeaf(index);
+  size_t pos = lowerBound(leaf, index);
+  if (pos == leaf->count || index < leaf->indexes[pos])
+    return nullptr;
+  return &leaf->data[pos];
+}
+
+template <typename IndexType, typename DataType, size_t Fanout>
+DataType &
+StaticBpTree<IndexType, DataType, Fanout>::operator[](const IndexType &index) {
+  Path path;
+  Leaf *leaf = findLeaf(index, &path);
+  size_t pos = lowerBound(leaf, index);
+  if (pos < leaf->count && !(index < leaf->indexes[pos]))
+    return leaf->data[pos];
+  return insertIntoLeaf(leaf, pos, index, DataType(), path);
+}
+
+// Walk the leaves from the first index in the range until one is past it
+template <typename IndexType, typename DataType, size_t Fanout>
+std::vector<DataType *> StaticBpTree<IndexType, DataType, Fanout>::rangeQuery(
+    const std::optional<IndexType> &minIndex,
+    const std::optional<IndexType> &maxIndex, const bool &leftInclusive,
+    const bool &rightInclusive) {
+  std::vector<DataType *> result;
+  Leaf *leaf = minIndex ? findLeaf(*minIndex) : leftmostLeaf();
+  size_t pos = !minIndex       ? 0
+               : leftInclusive ? lowerBound(leaf, *minIndex)
+                               : upperBound(leaf, *minIndex);
+  for (; leaf; leaf = leaf->next, pos = 0) {
+    size_t end = leaf->count;
+    if (maxIndex) {
+      end = rightInclusive ? upperBound(leaf, *maxIndex)
+                           : lowerBound(leaf, *maxIndex);
+    }
+    for (; pos < end; ++pos)
+      result.push_back(&leaf->data[pos]);
+    if (end < leaf->count)
+      break;
+  }
+  return result;
+}
+
+#endif // PROJECT_DB_STATICBPTREEIMPL_H
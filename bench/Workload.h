@@ -0,0 +1,323 @@
+#ifndef PROJECT_DB_WORKLOAD_H
+#define PROJECT_DB_WORKLOAD_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "BpTree.h"
+#include "LatencyHistogram.h"
+
+// YCSB style workloads: an operation mix, a key distribution and a
+// pre-generated operation sequence that is replayed on every container
+
+enum class KeyDistribution { Uniform, Zipfian, Latest, Hotspot };
+
+inline const char *distributionName(KeyDistribution distribution) {
+  switch (distribution) {
+  case KeyDistribution::Uniform:
+    return "uniform";
+  case KeyDistribution::Zipfian:
+    return "zipfian";
+  case KeyDistribution::Latest:
+    return "latest";
+  case KeyDistribution::Hotspot:
+    return "hotspot";
+  }
+  return "unknown";
+}
+
+// Fractions of each operation type, they should add up to 1
+struct WorkloadMix {
+  std::string name;
+  double read;
+  double update;
+  double insert;
+  double scan;
+  double readModifyWrite;
+  KeyDistribution distribution; // the distribution YCSB uses for this mix
+  size_t maxScanLength;
+};
+
+// The core YCSB workloads A-F, in the order YCSB recommends running them
+// (the inserting workloads D and E last)
+inline std::vector<WorkloadMix> ycsbWorkloads() {
+  return {
+      {"A", 0.50, 0.50, 0.00, 0.00, 0.00, KeyDistribution::Zipfian, 0},
+      {"B", 0.95, 0.05, 0.00, 0.00, 0.00, KeyDistribution::Zipfian, 0},
+      {"C", 1.00, 0.00, 0.00, 0.00, 0.00, KeyDistribution::Zipfian, 0},
+      {"F", 0.50, 0.00, 0.00, 0.00, 0.50, KeyDistribution::Zipfian, 0},
+      {"D", 0.95, 0.00, 0.05, 0.00, 0.00, KeyDistribution::Latest, 0},
+      {"E", 0.00, 0.00, 0.05, 0.95, 0.00, KeyDistribution::Zipfian, 100},
+  };
+}
+
+/**
+ * @brief         Zipfian ranks in [0, items) after Gray et al., "Quickly
+ *                generating billion-record synthetic databases"
+ *
+ * Rank 0 is the most popular. The item count may grow between calls, zeta is
+ * then extended incrementally instead of being recomputed.
+ */
+class ZipfianGenerator {
+private:
+  double theta;
+  double alpha;
+  double zeta2;
+  double zetaN;
+  size_t items;
+
+  static double zeta(size_t from, size_t to, double theta, double initial) {
+    double sum = initial;
+    for (size_t i = from; i < to; ++i)
+      sum += 1.0 / std::pow((double)(i + 1), theta);
+    return sum;
+  }
+
+public:
+  explicit ZipfianGenerator(size_t items, double theta = 0.99)
+      : theta(theta), alpha(1.0 / (1.0 - theta)),
+        zeta2(zeta(0, 2, theta, 0.0)), zetaN(zeta(0, items, theta, 0.0)),
+        items(items) {}
+
+  template <typename Rng> size_t next(Rng &rng, size_t itemCount) {
+    if (itemCount > items) {
+      zetaN = zeta(items, itemCount, theta, zetaN);
+      items = itemCount;
+    }
+    double eta = (1.0 - std::pow(2.0 / (double)items, 1.0 - theta)) /
+                 (1.0 - zeta2 / zetaN);
+    double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+    double uz = u * zetaN;
+    if (uz < 1.0)
+      return 0;
+    if (uz < 1.0 + std::pow(0.5, theta))
+      return 1;
+    auto rank = (size_t)((double)items * std::pow(eta * u - eta + 1.0, alpha));
+    return rank < items ? rank : items - 1;
+  }
+};
+
+// Picks the record to operate on among the first recordCount records
+class KeyChooser {
+private:
+  KeyDistribution distribution;
+  ZipfianGenerator zipfian;
+  double hotSetFraction = 0.2; // fraction of the records that are hot
+  double hotOpFraction = 0.8;  // fraction of the operations hitting them
+
+  // spread the popular ranks over the key space like YCSB's scrambled zipfian
+  static uint64_t scramble(uint64_t rank) {
+    rank ^= rank >> 33;
+    rank *= 0xff51afd7ed558ccdULL;
+    rank ^= rank >> 33;
+    rank *= 0xc4ceb9fe1a85ec53ULL;
+    rank ^= rank >> 33;
+    return rank;
+  }
+
+public:
+  KeyChooser(KeyDistribution distribution, size_t recordCount)
+      : distribution(distribution), zipfian(recordCount) {}
+
+  template <typename Rng> size_t next(Rng &rng, size_t recordCount) {
+    switch (distribution) {
+    case KeyDistribution::Zipfian:
+      return scramble(zipfian.next(rng, recordCount)) % recordCount;
+    case KeyDistribution::Latest:
+      // the most recently inserted records are the most popular
+      return recordCount - 1 - zipfian.next(rng, recordCount);
+    case KeyDistribution::Hotspot: {
+      auto hot = std::max<size_t>(1, (size_t)(hotSetFraction * recordCount));
+      std::uniform_real_distribution<double> coin(0.0, 1.0);
+      if (coin(rng) < hotOpFraction || hot == recordCount)
+        return std::uniform_int_distribution<size_t>(0, hot - 1)(rng);
+      return std::uniform_int_distribution<size_t>(hot, recordCount - 1)(rng);
+    }
+    case KeyDistribution::Uniform:
+    default:
+      return std::uniform_int_distribution<size_t>(0, recordCount - 1)(rng);
+    }
+  }
+};
+
+struct Operation {
+  enum Type { Read, Update, Insert, Scan, ReadModifyWrite } type;
+  const std::string *key;
+  int value;         // written by Update and Insert
+  size_t scanLength; // only used by Scan
+};
+
+/**
+ * @brief         The keys of a workload run: the loaded rows of the dataset
+ *                followed by the keys inserted by the operations
+ */
+class KeySpace {
+private:
+  const std::vector<std::pair<std::string, int>> &data;
+  size_t loaded;
+  std::deque<std::string> inserted; // a deque keeps references stable
+
+public:
+  KeySpace(const std::vector<std::pair<std::string, int>> &data,
+           size_t loaded)
+      : data(data), loaded(loaded), inserted() {}
+
+  size_t size() const { return loaded + inserted.size(); }
+  const std::string &operator[](size_t record) const {
+    return record < loaded ? data[record].first : inserted[record - loaded];
+  }
+  // a new key that is not in the dataset, derived from an existing name, or
+  // from "key" when nothing was loaded
+  const std::string &add() {
+    size_t record = size();
+    const std::string &base = loaded ? data[record % loaded].first : "key";
+    inserted.emplace_back(base + "#" + std::to_string(record));
+    return inserted.back();
+  }
+};
+
+/**
+ * @brief         Generate the operations of one workload run
+ *
+ * Inserts add records to the key space, so consecutive runs over the same
+ * key space continue where the previous one stopped.
+ */
+template <typename Rng>
+std::vector<Operation> generateOperations(const WorkloadMix &mix,
+                                          KeyDistribution distribution,
+                                          KeySpace &keys, size_t operations,
+                                          Rng &rng) {
+  KeyChooser chooser(distribution, keys.size());
+  std::uniform_real_distribution<double> coin(0.0, 1.0);
+  std::vector<Operation> ops;
+  ops.reserve(operations);
+  for (size_t i = 0; i < operations; ++i) {
+    double r = coin(rng);
+    int value = (int)i;
+    // there is nothing to read in an empty key space, so it is filled first
+    if ((r -= mix.insert) < 0 || keys.size() == 0) {
+      ops.push_back({Operation::Insert, &keys.add(), value, 0});
+      continue;
+    }
+    const std::string *key = &keys[chooser.next(rng, keys.size())];
+    if ((r -= mix.update) < 0) {
+      ops.push_back({Operation::Update, key, value, 0});
+    } else if ((r -= mix.scan) < 0) {
+      size_t length =
+          std::uniform_int_distribution<size_t>(1, mix.maxScanLength)(rng);
+      ops.push_back({Operation::Scan, key, 0, length});
+    } else if ((r -= mix.readModifyWrite) < 0) {
+      ops.push_back({Operation::ReadModifyWrite, key, 0, 0});
+    } else {
+      ops.push_back({Operation::Read, key, 0, 0});
+    }
+  }
+  return ops;
+}
+
+// Container adapters: lookups without inserting, and ordered scans for the
+// containers that keep their keys sorted
+
+template <typename MapType>
+typename MapType::mapped_type *lookup(MapType &map, const std::string &key) {
+  auto it = map.find(key);
+  return it == map.end() ? nullptr : &it->second;
+}
+
+template <typename K, typename V, typename P>
+V *lookup(BpTree<K, V, P> &tree, const K &key) {
+  return tree.search(key);
+}
+
+template <typename MapType> struct OrderedScan {
+  static constexpr bool supported = false;
+  static size_t scan(MapType &, const std::string &, size_t) { return 0; }
+};
+
+template <typename K, typename V, typename C>
+struct OrderedScan<std::map<K, V, C>> {
+  static constexpr bool supported = true;
+  static size_t scan(std::map<K, V, C> &map, const K &from, size_t length) {
+    size_t sum = 0, visited = 0;
+    for (auto it = map.lower_bound(from); it != map.end() && visited < length;
+         ++it, ++visited)
+      sum += (size_t)it->second;
+    return sum;
+  }
+};
+
+template <typename K, typename V, typename P>
+struct OrderedScan<BpTree<K, V, P>> {
+  static constexpr bool supported = true;
+  static size_t scan(BpTree<K, V, P> &tree, const K &from, size_t length) {
+    size_t sum = 0;
+    tree.scan(from, length,
+              [&sum](const K &, V &data) { sum += (size_t)data; });
+    return sum;
+  }
+};
+
+// Run one operation, returns a checksum of the data it read
+template <typename MapType>
+size_t runOperation(MapType &map, const Operation &op) {
+  switch (op.type) {
+  case Operation::Read:
+    if (auto *data = lookup(map, *op.key))
+      return (size_t)*data;
+    break;
+  case Operation::Update:
+    if (auto *data = lookup(map, *op.key))
+      *data = op.value;
+    break;
+  case Operation::Insert:
+    map[*op.key] = op.value;
+    break;
+  case Operation::Scan:
+    return OrderedScan<MapType>::scan(map, *op.key, op.scanLength);
+  case Operation::ReadModifyWrite:
+    if (auto *data = lookup(map, *op.key))
+      *data += 1;
+    break;
+  }
+  return 0;
+}
+
+/**
+ * @brief         Replay the operations on the container
+ *
+ * @param         latency , if given, every operation is timed into it
+ * @return        size_t, a checksum of the data read so that the reads are
+ *                not optimized away
+ */
+template <typename MapType>
+size_t runOperations(MapType &map, const std::vector<Operation> &ops,
+                     LatencyHistogram *latency = nullptr) {
+  size_t checksum = 0;
+  for (const auto &op : ops) {
+    if (latency)
+      latency->time([&]() { checksum += runOperation(map, op); });
+    else
+      checksum += runOperation(map, op);
+  }
+  return checksum;
+}
+
+// Apply only the inserts of a run, to keep the key space of containers that
+// skip a workload in line with the others
+template <typename MapType>
+void applyInserts(MapType &map, const std::vector<Operation> &ops) {
+  for (const auto &op : ops) {
+    if (op.type == Operation::Insert)
+      map[*op.key] = op.value;
+  }
+}
+
+#endif // PROJECT_DB_WORKLOAD_H
@@ -0,0 +1,477 @@
+#ifndef PROJECT_DB_WRITEAHEADLOG_H
+#define PROJECT_DB_WRITEAHEADLOG_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "BpTree.h"
+#include "Dataset.h"
+
+/**
+ * @brief         How indexes and data are written to log records and
+ *                checkpoints: as raw bytes, or length-prefixed for strings
+ */
+template <typename T> struct LogCodec {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "only trivially copyable types and strings can be logged");
+
+  static void write(std::string &out, const T &value) {
+    out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+  }
+  static bool read(const char *&p, const char *end, T &value) {
+    if ((size_t)(end - p) < sizeof(T))
+      return false;
+    std::memcpy(&value, p, sizeof(T));
+    p += sizeof(T);
+    return true;
+  }
+};
+
+template <> struct LogCodec<std::string> {
+  static void write(std::string &out, const std::string &value) {
+    LogCodec<uint32_t>::write(out, (uint32_t)value.size());
+    out.append(value);
+  }
+  static bool read(const char *&p, const char *end, std::string &value) {
+    uint32_t size;
+    if (!LogCodec<uint32_t>::read(p, end, size) || (size_t)(end - p) < size)
+      return false;
+    value.assign(p, size);
+    p += size;
+    return true;
+  }
+};
+
+// FNV-1a over the bytes, continuing from hash
+inline uint64_t logChecksum(const char *data, size_t size,
+                            uint64_t hash = 0xcbf29ce484222325ULL) {
+  for (size_t i = 0; i < size; ++i)
+    hash = (hash ^ (unsigned char)data[i]) * 0x100000001b3ULL;
+  return hash;
+}
+
+// fsync() a directory, which makes the entries created or renamed in it
+// durable; the data of a file does not carry its directory entry
+inline bool syncDirectory(const std::string &path) {
+  int dir = open(path.c_str(), O_RDONLY | O_DIRECTORY);
+  bool ok = dir >= 0 && fsync(dir) == 0;
+  if (dir >= 0)
+    close(dir);
+  return ok;
+}
+
+// The directory holding path, "." for a bare name
+inline std::string parentDirectory(const std::string &path) {
+  size_t slash = path.find_last_of('/');
+  if (slash == std::string::npos)
+    return ".";
+  return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+// write() all of the bytes
+inline bool writeAll(int fd, const char *data, size_t size) {
+  while (size > 0) {
+    ssize_t written = write(fd, data, size);
+    if (written < 0 && errno == EINTR)
+      continue;
+    if (written <= 0)
+      return false;
+    data += written;
+    size -= (size_t)written;
+  }
+  return true;
+}
+
+/**
+ * @brief         Append-only log of typed records with group commit
+ *
+ * A record is its payload size, type, log sequence number (LSN), payload and
+ * a checksum of all of them, so that a record torn by a crash is recognized.
+ * Records are collected in memory and written and synced together once
+ * commitBatch of them are pending, or on commit(): a record is durable once
+ * the commit that wrote it returned.
+ */
+class WriteAheadLog {
+private:
+  static constexpr size_t headerSize =
+      sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint64_t);
+
+  int fd = -1;
+  std::string pending; // records not written yet
+  size_t pendingRecords = 0;
+  size_t commitBatch = 1;
+  uint64_t nextLsn = 1;
+  size_t written = 0; // bytes in the file
+  size_t syncs = 0;
+
+public:
+  WriteAheadLog() = default;
+
+  /**
+   * @brief         Open the log for appending, keeping its first validBytes
+   *                (the intact records found by replay) and dropping the rest
+   */
+  WriteAheadLog(const std::string &filename, size_t validBytes,
+                uint64_t nextLsn, size_t commitBatch)
+      : commitBatch(std::max<size_t>(commitBatch, 1)), nextLsn(nextLsn),
+        written(validBytes) {
+    // appending, so that writes follow clear() too
+    // the directory is synced in case the log was just created, so that the
+    // first commits do not depend on an entry that may not survive a crash
+    fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd >= 0 && (ftruncate(fd, (off_t)validBytes) != 0 ||
+                    !syncDirectory(parentDirectory(filename)))) {
+      close(fd);
+      fd = -1;
+    }
+  }
+
+  WriteAheadLog(const WriteAheadLog &) = delete;
+  WriteAheadLog &operator=(const WriteAheadLog &) = delete;
+  WriteAheadLog(WriteAheadLog &&other) noexcept { *this = std::move(other); }
+  WriteAheadLog &operator=(WriteAheadLog &&other) noexcept {
+    if (this != &other) {
+      closeFile();
+      fd = std::exchange(other.fd, -1);
+      pending = std::move(other.pending);
+      pendingRecords = std::exchange(other.pendingRecords, 0);
+      commitBatch = other.commitBatch;
+      nextLsn = other.nextLsn;
+      written = other.written;
+      syncs = other.syncs;
+    }
+    return *this;
+  }
+
+  // pending records are committed
+  ~WriteAheadLog() { closeFile(); }
+
+  bool isOpen() const { return fd >= 0; }
+  // bytes written and pending
+  size_t size() const { return written + pending.size(); }
+  uint64_t lastLsn() const { return nextLsn - 1; }
+  size_t syncCount() const { return syncs; }
+
+  /**
+   * @brief         Append a record, committing the group if it is full
+   *
+   * @return        false if the commit failed
+   */
+  bool append(uint8_t type, const std::string &payload) {
+    size_t start = pending.size();
+    LogCodec<uint32_t>::write(pending, (uint32_t)payload.size());
+    LogCodec<uint8_t>::write(pending, type);
+    LogCodec<uint64_t>::write(pending, nextLsn++);
+    pending.append(payload);
+    uint64_t checksum =
+        logChecksum(pending.data() + start, pending.size() - start);
+    LogCodec<uint64_t>::write(pending, checksum);
+    return ++pendingRecords < commitBatch || commit();
+  }
+
+  /**
+   * @brief         Write the pending records and wait until they are on disk
+   */
+  bool commit() {
+    if (pendingRecords == 0)
+      return true;
+    if (!writeAll(fd, pending.data(), pending.size()) || fdatasync(fd) != 0)
+      return false;
+    written += pending.size();
+    pending.clear();
+    pendingRecords = 0;
+    ++syncs;
+    return true;
+  }
+
+  /**
+   * @brief         Drop every record, the LSNs continue where they were
+   */
+  bool clear() {
+    pending.clear();
+    pendingRecords = 0;
+    written = 0;
+    return ftruncate(fd, 0) == 0 && fdatasync(fd) == 0;
+  }
+
+  /**
+   * @brief         Read the intact records of a log in order
+   *
+   * Reading stops at the first record that is cut short or fails its
+   * checksum: that one and everything after it were never committed.
+   *
+   * @tparam        Visitor , called as visit(lsn, type, payload, payloadEnd)
+   * @return        size_t, the bytes of intact records
+   */
+  template <typename Visitor>
+  static size_t replay(const std::string &filename, Visitor visit) {
+    MappedFile file(filename);
+    if (!file.data())
+      return 0;
+    const char *p = file.data(), *end = p + file.size();
+    const char *intact = p;
+    while ((size_t)(end - p) >= headerSize + sizeof(uint64_t)) {
+      const char *record = p;
+      uint32_t size;
+      uint8_t type;
+      uint64_t lsn, checksum;
+      LogCodec<uint32_t>::read(p, end, size);
+      LogCodec<uint8_t>::read(p, end, type);
+      LogCodec<uint64_t>::read(p, end, lsn);
+      if ((size_t)(end - p) < size + sizeof(uint64_t))
+        break;
+      const char *payload = p;
+      p += size;
+      LogCodec<uint64_t>::read(p, end, checksum);
+      if (checksum != logChecksum(record, headerSize + size))
+        break;
+      visit(lsn, type, payload, payload + size);
+      intact = p;
+    }
+    return (size_t)(intact - file.data());
+  }
+
+private:
+  void closeFile() {
+    if (fd >= 0) {
+      commit();
+      close(fd);
+      fd = -1;
+    }
+  }
+};
+
+/**
+ * @brief         A BpTree whose updates are logged for durability
+ *
+ * The directory holds the checkpoint, a snapshot of the tree with the LSN of
+ * the last update in it, and the log of the updates after it. Opening the
+ * tree loads the checkpoint and replays the log. A checkpoint is written to a
+ * new file that replaces the old one atomically, and the log is only cleared
+ * after that; records already in the checkpoint are skipped by their LSN if
+ * the clearing was lost.
+ */
+template <typename IndexType, typename DataType> class LoggedBpTree {
+private:
+  enum RecordType : uint8_t { Insert = 1, Erase = 2, Assign = 3 };
+  static constexpr uint64_t checkpointMagic = 0x3154504b43504221; // "!BPCKPT1"
+
+  BpTree<IndexType, DataType> tree;
+  std::string directory;
+  WriteAheadLog log;
+  size_t checkpointBytes = 0;
+  bool opened = false;
+  std::string record; // reused for every log record
+
+  std::string checkpointFile() const { return directory + "/checkpoint"; }
+  std::string logFile() const { return directory + "/wal"; }
+
+  bool logged(RecordType type, const IndexType &index, const DataType *data) {
+    record.clear();
+    LogCodec<IndexType>::write(record, index);
+    if (data)
+      LogCodec<DataType>::write(record, *data);
+    if (!log.append(type, record))
+      return false;
+    // a checkpoint starts the log over once it has grown large
+    return log.size() < checkpointBytes || checkpoint();
+  }
+
+  // Apply a record read back from the log
+  void apply(uint8_t type, const char *p, const char *end) {
+    IndexType index;
+    DataType data;
+    if (!LogCodec<IndexType>::read(p, end, index))
+      return;
+    if (type == Erase)
+      tree.erase(index);
+    else if (!LogCodec<DataType>::read(p, end, data))
+      return;
+    else if (type == Insert)
+      tree.insert(index, data);
+    else if (type == Assign)
+      tree[index] = data;
+  }
+
+  // Load the checkpoint into the tree, false if it is damaged
+  bool loadCheckpoint(uint64_t &lsn);
+
+public:
+  struct Options {
+    size_t commitBatch = 64;           // records per sync
+    size_t checkpointBytes = 64 << 20; // log size that triggers a checkpoint
+  };
+
+  /**
+   * @brief         Open the tree in directory, creating it if needed, and
+   *                recover its content from the checkpoint and the log
+   *
+   * isOpen() is false if the files cannot be opened or the checkpoint is
+   * damaged.
+   */
+  explicit LoggedBpTree(const std::string &directory, Options options = {});
+
+  bool isOpen() const { return opened; }
+  // the tree with every update so far, committed or not
+  const BpTree<IndexType, DataType> &view() const { return tree; }
+  const WriteAheadLog &writeAheadLog() const { return log; }
+
+  /**
+   * @brief         search for a specific index
+   *
+   * @return        const DataType *, nullptr if not found. Updates go through
+   *                assign() so that they are logged.
+   */
+  const DataType *search(const IndexType &index) { return tree.search(index); }
+
+  /**
+   * @brief         Log and insert a index-data pair
+   *
+   * @return        false if the index already exists or logging failed
+   */
+  bool insert(const IndexType &index, const DataType &data) {
+    if (tree.search(index))
+      return false;
+    tree.insert(index, data);
+    return logged(Insert, index, &data);
+  }
+
+  /**
+   * @brief         Log and remove index
+   *
+   * @return        false if the index is not found or logging failed
+   */
+  bool erase(const IndexType &index) {
+    if (!tree.erase(index))
+      return false;
+    return logged(Erase, index, nullptr);
+  }
+
+  /**
+   * @brief         Log and store data for index, inserting it if needed: the
+   *                logged form of tree[index] = data
+   */
+  bool assign(const IndexType &index, const DataType &data) {
+    tree[index] = data;
+    return logged(Assign, index, &data);
+  }
+
+  /**
+   * @brief         Make every update so far durable
+   */
+  bool commit() { return log.commit(); }
+
+  /**
+   * @brief         Snapshot the tree and start the log over
+   */
+  bool checkpoint();
+};
+
+// Load the checkpoint: magic, LSN, count, the pairs in index order, then the
+// checksum of all of it. A missing checkpoint is an empty tree.
+template <typename IndexType, typename DataType>
+bool LoggedBpTree<IndexType, DataType>::loadCheckpoint(uint64_t &lsn) {
+  lsn = 0;
+  MappedFile file(checkpointFile());
+  if (!file.data())
+    return access(checkpointFile().c_str(), F_OK) != 0;
+  if (file.size() < 4 * sizeof(uint64_t))
+    return false;
+  const char *p = file.data(), *end = p + file.size() - sizeof(uint64_t);
+  const char *stored = end;
+  uint64_t magic, count, checksum;
+  LogCodec<uint64_t>::read(p, end, magic);
+  LogCodec<uint64_t>::read(stored, stored + sizeof(uint64_t), checksum);
+  if (magic != checkpointMagic ||
+      checksum != logChecksum(file.data(), file.size() - sizeof(uint64_t)))
+    return false;
+  LogCodec<uint64_t>::read(p, end, lsn);
+  LogCodec<uint64_t>::read(p, end, count);
+  std::vector<std::pair<IndexType, DataType>> pairs(count);
+  for (auto &[index, data] : pairs) {
+    if (!LogCodec<IndexType>::read(p, end, index) ||
+        !LogCodec<DataType>::read(p, end, data))
+      return false;
+  }
+  tree.bulkLoad(pairs.begin(), pairs.end());
+  return true;
+}
+
+// Constructor: load the checkpoint, replay the intact records after it, and
+// reopen the log without its torn tail
+template <typename IndexType, typename DataType>
+LoggedBpTree<IndexType, DataType>::LoggedBpTree(const std::string &directory,
+                                                Options options)
+    : directory(directory), checkpointBytes(options.checkpointBytes) {
+  if (mkdir(directory.c_str(), 0755) == 0) {
+    if (!syncDirectory(parentDirectory(directory)))
+      return;
+  } else if (errno != EEXIST) {
+    return;
+  }
+  uint64_t checkpointLsn;
+  if (!loadCheckpoint(checkpointLsn))
+    return;
+  uint64_t lastLsn = checkpointLsn;
+  size_t validBytes = WriteAheadLog::replay(
+      logFile(), [&](uint64_t lsn, uint8_t type, const char *payload,
+                     const char *payloadEnd) {
+        if (lsn > checkpointLsn)
+          apply(type, payload, payloadEnd);
+        lastLsn = std::max(lastLsn, lsn);
+      });
+  log = WriteAheadLog(logFile(), validBytes, lastLsn + 1, options.commitBatch);
+  opened = log.isOpen();
+}
+
+// Checkpoint: commit the log, write the snapshot to a temporary file, sync
+// it, rename it over the old checkpoint, sync the directory so that the
+// rename is durable, and only then clear the log
+template <typename IndexType, typename DataType>
+bool LoggedBpTree<IndexType, DataType>::checkpoint() {
+  if (!log.commit())
+    return false;
+  std::string temporary = checkpointFile() + ".tmp";
+  int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    return false;
+  std::string buffer;
+  uint64_t checksum = logChecksum(nullptr, 0);
+  bool ok = true;
+  auto flush = [&]() {
+    checksum = logChecksum(buffer.data(), buffer.size(), checksum);
+    ok = ok && writeAll(fd, buffer.data(), buffer.size());
+    buffer.clear();
+  };
+  LogCodec<uint64_t>::write(buffer, checkpointMagic);
+  LogCodec<uint64_t>::write(buffer, log.lastLsn());
+  LogCodec<uint64_t>::write(buffer, (uint64_t)tree.size());
+  const auto &snapshot = tree;
+  for (auto it = snapshot.begin(); it != snapshot.end(); ++it) {
+    LogCodec<IndexType>::write(buffer, it.index());
+    LogCodec<DataType>::write(buffer, it.data());
+    if (buffer.size() >= (1 << 20))
+      flush();
+  }
+  flush();
+  LogCodec<uint64_t>::write(buffer, checksum);
+  ok = ok && writeAll(fd, buffer.data(), buffer.size()) && fsync(fd) == 0;
+  close(fd);
+  ok = ok && rename(temporary.c_str(), checkpointFile().c_str()) == 0;
+  ok = ok && syncDirectory(directory);
+  return ok && log.clear();
+}
+
+#endif // PROJECT_DB_WRITEAHEADLOG_H
@@ -1,133 +1,709 @@
 #include <algorithm>
+#include <array>
 #include <chrono>
+#include <cmath>
 #include <fstream>
+#include <functional>
+#include <iterator>
 #include <iostream>
 #include <map>
+#include <random>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+#include "AllocationCounter.h"
+#include "BenchRunner.h"
+#include "BenchUtils.h"
 #include "BpTree.h"
+#include "CommandLine.h"
+#include "FlatHashMap.h"
+#include "LatencyHistogram.h"
+#include "PerfCounters.h"
+#include "Workload.h"
 
 using namespace std;
 using namespace std::chrono;
 
+// The phases of a run, in the order of their columns. Insert runs first and
+// Delete last, the lookup phases in between look up keys in the order their
+// name says and never insert.
+enum Phase {
+  Insert,
+  Delete,
+  Access,   // the inserted keys in row order
+  Shuffled, // the inserted keys in a random order
+  Sorted,   // the inserted keys in ascending order
+  Reverse,  // the inserted keys in descending order
+  Zipfian,  // inserted keys drawn from a scrambled Zipfian distribution
+  Negative, // keys that were not inserted
+  PhaseCount
+};
+const char *const phaseNames[PhaseCount] = {
+    "Insert", "Delete", "Access", "Shuffled",
+    "Sorted", "Reverse", "Zipfian", "Negative"};
+// their names for --phases
+const char *const phaseOptions[PhaseCount] = {
+    "insert", "erase", "access", "shuffled",
+    "sorted", "reverse", "zipfian", "negative"};
+
 struct BenchmarkResult {
   string container;
   size_t dataSize;
-  double insertTime;
-  double deleteTime;
-  double accessTime;
+  // per phase, NaN for the phases that did not run
+  array<double, PhaseCount> times;
+  // per-operation latency percentiles of each phase
+  array<LatencyHistogram::Summary, PhaseCount> latencies;
+  // hardware events per operation of each phase
+  array<PerfStats, PhaseCount> events;
+  // heap use of the whole run, and per entry once everything is inserted
+  AllocationStats memory;
+  double bytesPerEntry;
+  // shape of the B+ trees once everything is inserted, empty for the others
+  size_t height;
+  size_t nodes;
+  double fillFactor;
+  string levelOccupancy; // per level from the root, separated by '|'
 };
 
-vector<pair<string, int>> readCSV(const string &filename) {
-  vector<pair<string, int>> data;
-  ifstream file(filename);
-  string line, name;
-  int id;
+// What to run, from the command line (see usage())
+struct Config {
+  string dataFile = "../data/data.csv";
+  string key = "key"; // the column whose values are the keys
+  vector<string> containers; // every registered one when empty
+  vector<size_t> scales;     // the default sweep when empty
+  unsigned phases = (1u << PhaseCount) - 1; // Insert always runs
+  size_t threads = thread::hardware_concurrency(); // loading and bulk sorts
+  size_t order = 0; // of the B+ trees, their default when 0
+  string format = "csv";
+  string output; // the default depends on the format
+  string statsOutput = "../data/results/benchmark1_stats.csv";
+  bool list = false;
+
+  bool runs(Phase phase) const { return phases >> phase & 1; }
+};
+
+// The keys of each lookup phase, built once per scale
+struct AccessOrders {
+  array<vector<const string *>, PhaseCount> keys;
+  vector<string> absent; // those of the Negative phase
+};
+
+// A B+Tree that is built with one bulk load instead of one insert per row
+struct BulkLoadedBpTree : BpTree<string, int> {
+  using BpTree::BpTree;
+  size_t threads = thread::hardware_concurrency(); // to sort the rows
+};
+
+// A B+Tree that is inserted into, accessed and erased in batches of rows
+struct BatchedBpTree : BpTree<string, int> {
+  using BpTree::BpTree;
+};
+const size_t batchSize = 1000;
+
+template <typename K, typename V, typename P>
+true_type isBpTree(const BpTree<K, V, P> *);
+false_type isBpTree(...);
 
-  while (getline(file, line)) {
-    stringstream ss(line);
-    getline(ss, name, ',');
-    ss >> id;
-    data.emplace_back(name, id);
+// A new container, with the B+ tree order and threads of the config
+template <typename MapType> MapType makeMap(const Config &config) {
+  if constexpr (decltype(isBpTree((MapType *)nullptr))::value) {
+    MapType tree = config.order > 0 ? MapType(config.order) : MapType();
+    if constexpr (is_same_v<MapType, BulkLoadedBpTree>)
+      tree.threads = config.threads;
+    return tree;
+  } else {
+    return MapType();
   }
+}
 
-  return data;
+template <typename MapType>
+void insertAll(MapType &map, const vector<pair<string, int>> &data,
+               size_t dataSize, LatencyHistogram &latency) {
+  for (size_t i = 0; i < dataSize; ++i) {
+    latency.time([&]() { map[data[i].first] = data[i].second; });
+  }
+}
+
+// a single load, so there are no per-insert latencies to record
+void insertAll(BulkLoadedBpTree &tree, const vector<pair<string, int>> &data,
+               size_t dataSize, LatencyHistogram &) {
+  tree.bulkLoadUnsorted(data.begin(), data.begin() + (long)dataSize,
+                        tree.threads);
+}
+
+// The data of key, nullptr if it is absent
+template <typename MapType>
+int *findData(MapType &map, const string &key, long) {
+  auto it = map.find(key);
+  return it == map.end() ? nullptr : &it->second;
+}
+
+template <typename MapType>
+auto findData(MapType &tree, const string &key, int)
+    -> decltype(tree.search(key)) {
+  return tree.search(key);
+}
+
+template <typename MapType>
+void lookupAll(MapType &map, const vector<const string *> &keys,
+               LatencyHistogram &latency) {
+  int sum = 0;
+  for (const string *key : keys) {
+    latency.time([&]() {
+      int *data = findData(map, *key, 0);
+      sum += data ? *data : 0;
+    });
+  }
+  volatile int value = sum;
+  (void)value;
+}
+
+template <typename MapType>
+void eraseAll(MapType &map, const vector<pair<string, int>> &data,
+              size_t dataSize, LatencyHistogram &latency) {
+  for (size_t i = 0; i < dataSize; i++) {
+    latency.time([&]() { map.erase(data[i].first); });
+  }
+}
+
+// Run op on each batch of rows in [0, dataSize); every operation of a batch
+// is recorded with the batch's time divided by its size
+template <typename Op>
+void forEachBatch(size_t dataSize, LatencyHistogram &latency, Op op) {
+  for (size_t begin = 0; begin < dataSize; begin += batchSize) {
+    size_t end = min(begin + batchSize, dataSize);
+    uint64_t start = TickClock::now();
+    op(begin, end);
+    uint64_t perOperation =
+        TickClock::toNs(TickClock::now() - start) / (end - begin);
+    for (size_t i = begin; i < end; ++i)
+      latency.record(perOperation);
+  }
+}
+
+void insertAll(BatchedBpTree &tree, const vector<pair<string, int>> &data,
+               size_t dataSize, LatencyHistogram &latency) {
+  forEachBatch(dataSize, latency, [&](size_t begin, size_t end) {
+    tree.insertBatch(data.begin() + (long)begin, data.begin() + (long)end);
+  });
+}
+
+void lookupAll(BatchedBpTree &tree, const vector<const string *> &keys,
+               LatencyHistogram &latency) {
+  vector<string> batch;
+  vector<int *> found;
+  forEachBatch(keys.size(), latency, [&](size_t begin, size_t end) {
+    batch.clear();
+    found.clear();
+    for (size_t i = begin; i < end; ++i)
+      batch.push_back(*keys[i]);
+    tree.searchBatch(batch.begin(), batch.end(), back_inserter(found));
+    int sum = 0;
+    for (int *data : found)
+      sum += data ? *data : 0;
+    volatile int value = sum;
+    (void)value;
+  });
+}
+
+void eraseAll(BatchedBpTree &tree, const vector<pair<string, int>> &data,
+              size_t dataSize, LatencyHistogram &latency) {
+  vector<string> keys;
+  forEachBatch(dataSize, latency, [&](size_t begin, size_t end) {
+    keys.clear();
+    for (size_t i = begin; i < end; ++i)
+      keys.push_back(data[i].first);
+    tree.eraseBatch(keys.begin(), keys.end());
+  });
+}
+
+// Fill the shape columns of a result for the containers with stats(), the B+
+// trees and the types derived from them
+template <typename MapType>
+void treeStats(const MapType &, BenchmarkResult &, long) {}
+
+template <typename MapType>
+auto treeStats(const MapType &tree, BenchmarkResult &result, int)
+    -> decltype(tree.stats(), void()) {
+  auto stats = tree.stats();
+  result.height = stats.height;
+  result.nodes = stats.nodes;
+  result.fillFactor = stats.fillFactor;
+  ostringstream occupancy;
+  for (const auto &level : stats.levels) {
+    occupancy << (occupancy.tellp() > 0 ? "|" : "")
+              << (double)level.indexes / level.capacity;
+  }
+  result.levelOccupancy = occupancy.str();
 }
 
 template <typename MapType>
 BenchmarkResult benchmark(const vector<pair<string, int>> &data,
-                          size_t dataSize, const string &containerName) {
-  MapType map;
-  auto start = high_resolution_clock::now();
+                          size_t dataSize, const AccessOrders &orders,
+                          const string &containerName, const Config &config) {
+  AllocationCounter allocations;
+  MapType map = makeMap<MapType>(config);
+  array<LatencyHistogram, PhaseCount> latencies;
+  PerfCounters counters;
+  BenchmarkResult result{containerName, dataSize};
+  result.times.fill(NAN);
 
-  // Insert
-  for (size_t i = 0; i < dataSize; ++i) {
-    map[data[i].first] = data[i].second;
+  // Time op(latency) as the phase, whose operations are one per row
+  auto measure = [&](Phase phase, auto op) {
+    auto start = high_resolution_clock::now();
+    counters.start();
+    op(latencies[phase]);
+    PerfStats events = counters.stop();
+    auto end = high_resolution_clock::now();
+    result.times[phase] =
+        duration_cast<nanoseconds>(end - start).count() / 1e6;
+    result.events[phase] = events.perOperation(dataSize);
+  };
+
+  measure(Insert, [&](LatencyHistogram &latency) {
+    insertAll(map, data, dataSize, latency);
+  });
+  // an empty field for --scales 0
+  result.bytesPerEntry =
+      dataSize ? (double)allocations.stats().liveBytes / (double)dataSize
+               : NAN;
+  treeStats(map, result, 0);
+
+  for (Phase phase : {Access, Shuffled, Sorted, Reverse, Zipfian, Negative}) {
+    if (!config.runs(phase))
+      continue;
+    measure(phase, [&](LatencyHistogram &latency) {
+      lookupAll(map, orders.keys[phase], latency);
+    });
   }
-  auto end = high_resolution_clock::now();
-  double insertTime = duration_cast<nanoseconds>(end - start).count() / 1e6;
 
-  // Access
-  start = high_resolution_clock::now();
-  for (size_t i = 0; i < dataSize; ++i) {
-    volatile int value = map[data[i].first];
+  if (config.runs(Delete)) {
+    measure(Delete, [&](LatencyHistogram &latency) {
+      eraseAll(map, data, dataSize, latency);
+    });
   }
-  end = high_resolution_clock::now();
-  double accessTime = duration_cast<nanoseconds>(end - start).count() / 1e6;
 
-  // Delete
-  start = high_resolution_clock::now();
-  for (size_t i = 0; i < dataSize; i++) {
-    map.erase(data[i].first);
+  for (int phase = 0; phase < PhaseCount; ++phase)
+    result.latencies[phase] = latencies[phase].summary();
+  result.memory = allocations.stats();
+  return result;
+}
+
+// The columns of a result that are summarized over its runs
+string metricsHeader() {
+  string header;
+  for (const char *phase : phaseNames)
+    header += string(phase) + "Time(ms),";
+  for (const char *phase : phaseNames)
+    header += LatencyHistogram::Summary::header(phase) + ",";
+  for (const char *phase : phaseNames)
+    header += PerfStats::header(phase) + ",";
+  return header + AllocationStats::header() +
+         ",BytesPerEntry,Height,Nodes,FillFactor";
+}
+
+// One run's values of the metricsHeader() columns, and its level occupancy.
+// The latencies of a phase that did not run are NaN, like its time.
+Sample toSample(const BenchmarkResult &result) {
+  Sample sample;
+  vector<double> &values = sample.values;
+  values.assign(result.times.begin(), result.times.end());
+  for (int phase = 0; phase < PhaseCount; ++phase) {
+    const LatencyHistogram::Summary &latency = result.latencies[phase];
+    bool ran = !isnan(result.times[phase]);
+    for (uint64_t value :
+         {latency.p50, latency.p90, latency.p99, latency.p999, latency.max})
+      values.push_back(ran ? (double)value : NAN);
+  }
+  for (const PerfStats &events : result.events) {
+    for (int event = 0; event < PerfStats::EventCount; ++event)
+      values.push_back(events.valid[event] ? events.values[event] : NAN);
   }
-  end = high_resolution_clock::now();
-  double deleteTime = duration_cast<nanoseconds>(end - start).count() / 1e6;
+  const AllocationStats &memory = result.memory;
+  values.insert(values.end(),
+                {(double)memory.allocations, (double)memory.allocatedBytes,
+                 (double)memory.liveBytes, (double)memory.peakBytes,
+                 result.bytesPerEntry, (double)result.height,
+                 (double)result.nodes, result.fillFactor});
+  sample.text = result.levelOccupancy;
+  return sample;
+}
 
-  return {containerName, dataSize, insertTime, deleteTime, accessTime};
+// A run of a container over the first dataSize rows
+using ContainerRun =
+    function<Sample(const vector<pair<string, int>> &, size_t,
+                    const AccessOrders &, const Config &)>;
+
+// The containers --containers selects from, in their default order
+vector<pair<string, ContainerRun>> &registry() {
+  static vector<pair<string, ContainerRun>> containers;
+  return containers;
+}
+
+// Adds MapType to the registry when the program starts; a container is
+// registered with one global Registration
+template <typename MapType> struct Registration {
+  explicit Registration(const string &name) {
+    auto run = [name](const vector<pair<string, int>> &data, size_t dataSize,
+                      const AccessOrders &orders, const Config &config) {
+      return toSample(
+          benchmark<MapType>(data, dataSize, orders, name, config));
+    };
+    registry().emplace_back(name, run);
+  }
+};
+
+Registration<unordered_map<string, int>> unorderedMap("unordered_map");
+Registration<unordered_map<string, int, CustomHashFNV1A>>
+    unorderedMapFnv1a("unordered_map_fnv1a");
+Registration<unordered_map<string, int, CustomHashMod>>
+    unorderedMapMod("unordered_map_mod");
+Registration<FlatHashMap<string, int>> flatHashMap("flat_hash_map");
+Registration<map<string, int>> orderedMap("map");
+Registration<BpTree<string, int>> bpTree("B+Tree");
+Registration<BpTree<string, int, HeapNodes>> heapBpTree("B+Tree_heap");
+Registration<BulkLoadedBpTree> bulkLoadedBpTree("B+Tree_bulk");
+Registration<BatchedBpTree> batchedBpTree("B+Tree_batch");
+
+// The runs of one container at one scale, summarized per metric
+struct Summary {
+  string container;
+  size_t dataSize;
+  size_t repetitions;
+  vector<SampleStats> metrics;
+  string levelOccupancy;
+};
+
+Summary summarize(const string &container, size_t dataSize,
+                  const vector<Sample> &samples) {
+  Summary summary{container, dataSize, samples.size()};
+  size_t metrics = samples.empty() ? 0 : samples.front().values.size();
+  for (size_t metric = 0; metric < metrics; ++metric) {
+    vector<double> values;
+    for (const Sample &sample : samples)
+      values.push_back(sample.values[metric]);
+    summary.metrics.push_back(SampleStats::of(values));
+  }
+  if (!samples.empty())
+    summary.levelOccupancy = samples.back().text;
+  return summary;
+}
+
+vector<string> metricNames() {
+  vector<string> names;
+  istringstream header(metricsHeader());
+  for (string name; getline(header, name, ',');)
+    names.push_back(name);
+  return names;
+}
+
+// The medians, one row per container and scale
+string resultsHeader() {
+  return "Container,DataSize,Repetitions," + metricsHeader() +
+         ",LevelOccupancy";
+}
+
+void writeResult(ostream &os, const Summary &summary) {
+  os << summary.container << "," << summary.dataSize << ","
+     << summary.repetitions;
+  for (const SampleStats &metric : summary.metrics) {
+    os << ",";
+    if (!isnan(metric.median))
+      os << metric.median;
+  }
+  os << "," << summary.levelOccupancy;
 }
 
-void printResults(const vector<BenchmarkResult> &results) {
-  cout << "Container,DataSize,InsertTime(ms),DeleteTime(ms),AccessTime(ms)"
-       << endl;
+void printResults(const vector<Summary> &results) {
+  cout << resultsHeader() << endl;
   for (const auto &result : results) {
-    cout << result.container << "," << result.dataSize << ","
-         << result.insertTime << "," << result.deleteTime << ","
-         << result.accessTime << endl;
+    writeResult(cout, result);
+    cout << endl;
   }
 }
 
-void saveResultsToCSV(const vector<BenchmarkResult> &results,
+void saveResultsToCSV(const vector<Summary> &results,
                       const string &filename) {
   ofstream file(filename);
-  file << "Container,DataSize,InsertTime(ms),DeleteTime(ms),AccessTime(ms)\n";
+  file << resultsHeader() << "\n";
   for (const auto &result : results) {
-    file << result.container << "," << result.dataSize << ","
-         << result.insertTime << "," << result.deleteTime << ","
-         << result.accessTime << "\n";
+    writeResult(file, result);
+    file << "\n";
   }
 }
 
-unsigned naive_mod_hash(const string &key, size_t tableSize) {
-  unsigned hash = 0;
-  for (char c : key) {
-    hash = (hash * 256 + c) % tableSize;
+// The spread of every metric, one row per container, scale and metric
+void saveStatsToCSV(const vector<Summary> &results, const string &filename) {
+  vector<string> names = metricNames();
+  ofstream file(filename);
+  file << "Container,DataSize,Metric," << SampleStats::header() << "\n";
+  for (const auto &result : results) {
+    for (size_t metric = 0; metric < result.metrics.size(); ++metric) {
+      file << result.container << "," << result.dataSize << ","
+           << names[metric] << "," << result.metrics[metric] << "\n";
+    }
   }
-  return hash;
 }
 
-struct CustomHashMod {
-  size_t operator()(const string &key) const {
-    return naive_mod_hash(key, 10000000);
+// The summaries with every metric's statistics, null where there are none
+void saveResultsToJSON(const vector<Summary> &results,
+                       const string &filename) {
+  vector<string> names = metricNames();
+  ofstream file(filename);
+  auto number = [&file](double value) -> ostream & {
+    return isnan(value) ? file << "null" : file << value;
+  };
+  file << "[";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const Summary &result = results[i];
+    file << (i > 0 ? "," : "") << "\n  {\"container\": \"" << result.container
+         << "\", \"dataSize\": " << result.dataSize
+         << ", \"repetitions\": " << result.repetitions
+         << ", \"levelOccupancy\": \"" << result.levelOccupancy
+         << "\",\n   \"metrics\": {";
+    for (size_t metric = 0; metric < result.metrics.size(); ++metric) {
+      const SampleStats &stats = result.metrics[metric];
+      file << (metric > 0 ? "," : "") << "\n    \"" << names[metric]
+           << "\": {\"median\": ";
+      number(stats.median) << ", \"mean\": ";
+      number(stats.mean) << ", \"stddev\": ";
+      number(stats.stddev) << ", \"ci95Low\": ";
+      number(stats.ciLow) << ", \"ci95High\": ";
+      number(stats.ciHigh) << "}";
+    }
+    file << "}}";
   }
-};
+  file << "\n]\n";
+}
+
+void usage() {
+  cerr << "Usage: ./mainBench1 [options]\n"
+          "  --data FILE          dataset (../data/data.csv)\n"
+          "  --key key|studentID  column whose values are the keys (key)\n"
+          "  --containers A,B     containers to run, see --list (all)\n"
+          "  --scales N,M         numbers of rows (a sweep up to 1.3M)\n"
+          "  --phases P,Q         insert plus any of access,shuffled,sorted,\n"
+          "                       reverse,zipfian,negative,erase (all)\n"
+          "  --threads N          threads to load the data and sort bulk "
+          "loads\n"
+          "  --order N            order of the B+ trees (their default)\n"
+          "  --format csv|json    format of the results (csv)\n"
+          "  --output FILE        results file "
+          "(../data/results/benchmark1_results.csv or .json)\n"
+          "  --stats FILE         statistics of every metric, for csv "
+          "(../data/results/benchmark1_stats.csv)\n"
+          "  --list               print the containers and exit\n"
+          "  --warmup N, --repetitions N, --seed S, --isolate\n"
+          "                       see bench/BenchRunner.h\n";
+}
+
+vector<string> splitList(const string &list) {
+  vector<string> items;
+  istringstream stream(list);
+  for (string item; getline(stream, item, ',');) {
+    if (!item.empty())
+      items.push_back(item);
+  }
+  return items;
+}
 
-unsigned fnv_hash_1a_32(void *key, int len) {
-  unsigned char *p = static_cast<unsigned char *>(key);
-  unsigned h = 0x811c9dc5;
-  for (int i = 0; i < len; i++) {
-    h = (h ^ p[i]) * 0x01000193;
+// Read the options into config; false with a message if one is invalid
+bool parseConfig(int argc, char *argv[], Config &config) {
+  for (int i = 1; i < argc; ++i) {
+    string option = argv[i];
+    // a numeric value, false with a message if it is not one
+    auto number = [&option](const string &text, auto &value) {
+      if (parseWholeNumber(text, value))
+        return true;
+      cerr << "Invalid number for " << option << ": " << text << endl;
+      return false;
+    };
+    int runnerArguments = BenchRunner::Options::arguments(argv[i]);
+    if (runnerArguments >= 0) {
+      if (runnerArguments > 0) {
+        uint64_t value;
+        if (i + 1 >= argc) {
+          cerr << "Missing value: " << option << endl;
+          return false;
+        }
+        if (!number(argv[i + 1], value))
+          return false;
+      }
+      i += runnerArguments;
+      continue;
+    }
+    if (option == "--help")
+      return false;
+    if (option == "--list") {
+      config.list = true;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      cerr << "Unknown option or missing value: " << option << endl;
+      return false;
+    }
+    string value = argv[++i];
+    if (option == "--data") {
+      config.dataFile = value;
+    } else if (option == "--key") {
+      config.key = value;
+    } else if (option == "--containers") {
+      config.containers = splitList(value);
+    } else if (option == "--scales") {
+      config.scales.clear();
+      for (const string &item : splitList(value)) {
+        size_t scale;
+        if (!number(item, scale))
+          return false;
+        config.scales.push_back(scale);
+      }
+    } else if (option == "--phases") {
+      config.phases = 1u << Insert;
+      for (const string &phase : splitList(value)) {
+        auto named = find(begin(phaseOptions), end(phaseOptions), phase);
+        if (named == end(phaseOptions)) {
+          cerr << "Unknown phase: " << phase << endl;
+          return false;
+        }
+        config.phases |= 1u << (named - begin(phaseOptions));
+      }
+    } else if (option == "--threads") {
+      if (!number(value, config.threads))
+        return false;
+      config.threads = max<size_t>(config.threads, 1);
+    } else if (option == "--order") {
+      if (!number(value, config.order))
+        return false;
+    } else if (option == "--format") {
+      config.format = value;
+    } else if (option == "--output") {
+      config.output = value;
+    } else if (option == "--stats") {
+      config.statsOutput = value;
+    } else {
+      cerr << "Unknown option: " << option << endl;
+      return false;
+    }
   }
-  return h;
+
+  if (config.key != "key" && config.key != "studentID") {
+    cerr << "Unknown key column: " << config.key << endl;
+    return false;
+  }
+  if (config.format != "csv" && config.format != "json") {
+    cerr << "Unknown format: " << config.format << endl;
+    return false;
+  }
+  if (config.order != 0 && config.order < 3) {
+    cerr << "The B+ tree order must be at least 3" << endl;
+    return false;
+  }
+  for (const string &container : config.containers) {
+    auto named = [&container](const auto &entry) {
+      return entry.first == container;
+    };
+    if (none_of(registry().begin(), registry().end(), named)) {
+      cerr << "Unknown container: " << container << endl;
+      return false;
+    }
+  }
+  if (config.output.empty())
+    config.output = "../data/results/benchmark1_results." + config.format;
+  return true;
 }
 
-struct CustomHashFNV1A {
-  size_t operator()(const string &key) const {
-    return fnv_hash_1a_32((void *)key.data(), key.size());
+// The keys of the configured column, each with its row number as data
+vector<pair<string, int>> readKeys(const Config &config) {
+  Dataset dataset = loadDataset(config.dataFile, config.threads);
+  vector<pair<string, int>> data;
+  data.reserve(dataset.size());
+  for (size_t i = 0; i < dataset.size(); ++i) {
+    string key = config.key == "studentID" ? to_string(dataset.studentIds[i])
+                                           : string(dataset.keys[i]);
+    data.emplace_back(move(key), (int)i);
   }
-};
+  return data;
+}
 
-int main() {
+// The keys of the lookup phases the config runs, the same for every
+// container of a scale
+AccessOrders makeAccessOrders(const vector<pair<string, int>> &data,
+                              size_t dataSize, const Config &config) {
+  AccessOrders orders;
+  mt19937_64 rng(dataSize);
+  vector<const string *> &rows = orders.keys[Access];
+  for (size_t i = 0; i < dataSize; ++i)
+    rows.push_back(&data[i].first);
+  if (config.runs(Shuffled)) {
+    orders.keys[Shuffled] = rows;
+    shuffle(orders.keys[Shuffled].begin(), orders.keys[Shuffled].end(), rng);
+  }
+  if (config.runs(Sorted) || config.runs(Reverse)) {
+    vector<const string *> sorted = rows;
+    sort(sorted.begin(), sorted.end(),
+         [](const string *a, const string *b) { return *a < *b; });
+    orders.keys[Reverse].assign(sorted.rbegin(), sorted.rend());
+    orders.keys[Sorted] = move(sorted);
+  }
+  if (config.runs(Zipfian)) {
+    KeyChooser chooser(KeyDistribution::Zipfian, dataSize);
+    for (size_t i = 0; i < dataSize; ++i)
+      orders.keys[Zipfian].push_back(rows[chooser.next(rng, dataSize)]);
+  }
+  if (config.runs(Negative)) {
+    // an inserted key with its characters shuffled, which keeps the length
+    // and the alphabet of the keys; '~' is appended to the few that exist
+    unordered_set<string_view> inserted;
+    for (const string *key : rows)
+      inserted.insert(*key);
+    orders.absent.reserve(dataSize);
+    for (size_t i = 0; i < dataSize; ++i) {
+      string key = *rows[rng() % dataSize];
+      shuffle(key.begin(), key.end(), rng);
+      while (inserted.count(key))
+        key += '~';
+      orders.absent.push_back(move(key));
+    }
+    for (const string &key : orders.absent)
+      orders.keys[Negative].push_back(&key);
+  }
+  if (!config.runs(Access))
+    rows.clear();
+  return orders;
+}
+
+int main(int argc, char *argv[]) {
+  Config config;
+  if (!parseConfig(argc, argv, config)) {
+    usage();
+    return 1;
+  }
+  if (config.list) {
+    for (const auto &entry : registry())
+      cout << entry.first << endl;
+    return 0;
+  }
+  BenchRunner runner(BenchRunner::Options::parse(argc, argv));
+  const BenchRunner::Options &options = runner.settings();
+  cout << "Warmup runs " << options.warmup << ", repetitions "
+       << options.repetitions << ", seed " << options.seed
+       << (options.isolate ? ", one process per run" : "") << endl;
   cout << "Reading data from file" << endl;
-  vector<pair<string, int>> data = readCSV("../data/data.csv");
+  vector<pair<string, int>> data = readKeys(config);
   cout << "Data read successfully" << endl;
-  // vector<size_t> scales = {500, 20000, 500000, 10000000};
-  vector<size_t> scales(50);
-  generate(scales.begin(), scales.end(),
-           [n = 0]() mutable { return n += 10000 * (1 + n / 200000); });
-  vector<BenchmarkResult> results;
+  vector<size_t> scales = config.scales;
+  if (scales.empty()) {
+    scales.resize(50);
+    generate(scales.begin(), scales.end(),
+             [n = 0]() mutable { return n += 10000 * (1 + n / 200000); });
+  }
+  vector<Summary> results;
 
   for (size_t scale : scales) {
     if (scale > data.size()) {
@@ -136,17 +712,31 @@ int main() {
       continue;
     }
     cout << "Benchmarking with scale " << scale << "..." << endl;
-    results.push_back(
-        benchmark<unordered_map<string, int>>(data, scale, "unordered_map"));
-    results.push_back(benchmark<unordered_map<string, int, CustomHashFNV1A>>(
-        data, scale, "unordered_map_fnv1a"));
-    results.push_back(benchmark<unordered_map<string, int, CustomHashMod>>(
-        data, scale, "unordered_map_mod"));
-    results.push_back(benchmark<map<string, int>>(data, scale, "map"));
-    results.push_back(benchmark<BpTree<string, int>>(data, scale, "B+Tree"));
+    AccessOrders orders = makeAccessOrders(data, scale, config);
+    vector<BenchRunner::Case> cases;
+    for (const auto &[name, run] : registry()) {
+      bool selected = config.containers.empty() ||
+                      find(config.containers.begin(), config.containers.end(),
+                           name) != config.containers.end();
+      if (!selected)
+        continue;
+      auto runScale = [&data, scale, &orders, &config, run = run]() {
+        return run(data, scale, orders, config);
+      };
+      cases.push_back({name, runScale});
+    }
+
+    vector<vector<Sample>> samples = runner.run(cases);
+    for (size_t i = 0; i < cases.size(); ++i)
+      results.push_back(summarize(cases[i].name, scale, samples[i]));
   }
 
-  saveResultsToCSV(results, "../data/results/benchmark1_results.csv");
+  if (config.format == "json") {
+    saveResultsToJSON(results, config.output);
+  } else {
+    saveResultsToCSV(results, config.output);
+    saveStatsToCSV(results, config.statsOutput);
+  }
   printResults(results);
   return 0;
 }
@@ -0,0 +1,369 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "BenchUtils.h"
+#include "BpTree.h"
+
+using namespace std;
+using namespace std::chrono;
+
+struct BenchmarkResult {
+  string container;
+  size_t dataSize;
+  string phase;
+  double selectivity; // fraction of the keys hit by one range query
+  size_t operations;
+  size_t rows; // rows returned by the range queries, same for all containers
+  double time;
+};
+
+// A range of keys [lo, hi]
+struct KeyRange {
+  string lo;
+  string hi;
+};
+
+// One step of the mixed workload, replayed identically for every container
+struct MixedOp {
+  enum Type { Insert, Erase, Range } type;
+  size_t row;     // row of data to insert or erase
+  KeyRange range; // only used by Range
+};
+
+// Ratios of the mixed workload, the rest of the operations are erases
+struct MixedWorkload {
+  double insertRatio;
+  double rangeRatio;
+  double selectivity;
+  size_t operations;
+};
+
+// Range scans: a full scan for the hash maps, an ordered walk for map and
+// the leaf chain for the B+Tree
+
+template <typename MapType>
+size_t rangeCollect(MapType &map, const KeyRange &range, vector<int> &out) {
+  for (const auto &entry : map) {
+    if (entry.first >= range.lo && entry.first <= range.hi)
+      out.emplace_back(entry.second);
+  }
+  return out.size();
+}
+
+template <typename K, typename V, typename C>
+size_t rangeCollect(map<K, V, C> &ordered, const KeyRange &range,
+                    vector<int> &out) {
+  auto end = ordered.upper_bound(range.hi);
+  for (auto it = ordered.lower_bound(range.lo); it != end; ++it)
+    out.emplace_back(it->second);
+  return out.size();
+}
+
+template <typename K, typename V, typename P>
+size_t rangeCollect(BpTree<K, V, P> &tree, const KeyRange &range,
+                    vector<int> &out) {
+  tree.visitRange(range.lo, range.hi,
+                  [&out](const K &, V &data) { out.emplace_back(data); });
+  return out.size();
+}
+
+template <typename MapType>
+size_t rangeCount(MapType &map, const KeyRange &range) {
+  size_t count = 0;
+  for (const auto &entry : map) {
+    if (entry.first >= range.lo && entry.first <= range.hi)
+      ++count;
+  }
+  return count;
+}
+
+template <typename K, typename V, typename C>
+size_t rangeCount(map<K, V, C> &ordered, const KeyRange &range) {
+  return (size_t)distance(ordered.lower_bound(range.lo),
+                          ordered.upper_bound(range.hi));
+}
+
+template <typename K, typename V, typename P>
+size_t rangeCount(BpTree<K, V, P> &tree, const KeyRange &range) {
+  return tree.countRange(range.lo, range.hi);
+}
+
+// Percentiles of the keys: the hash maps sort a copy of their keys, map
+// walks its keys once and the B+Tree selects each one by rank
+
+template <typename MapType>
+size_t percentiles(MapType &map, const vector<double> &fractions,
+                   vector<string> &out) {
+  vector<string> keys;
+  for (const auto &entry : map)
+    keys.push_back(entry.first);
+  sort(keys.begin(), keys.end());
+  for (double fraction : fractions) {
+    size_t rank = max<size_t>(1, (size_t)ceil(fraction * keys.size()));
+    out.push_back(keys[rank - 1]);
+  }
+  return out.size();
+}
+
+template <typename K, typename V, typename C>
+size_t percentiles(map<K, V, C> &ordered, const vector<double> &fractions,
+                   vector<string> &out) {
+  auto it = ordered.begin();
+  size_t position = 0;
+  for (double fraction : fractions) {
+    size_t rank = max<size_t>(1, (size_t)ceil(fraction * ordered.size()));
+    advance(it, (long)(rank - 1 - position));
+    position = rank - 1;
+    out.push_back(it->first);
+  }
+  return out.size();
+}
+
+template <typename K, typename V, typename P>
+size_t percentiles(BpTree<K, V, P> &tree, const vector<double> &fractions,
+                   vector<string> &out) {
+  for (double fraction : fractions)
+    out.push_back(tree.percentile(fraction).index());
+  return out.size();
+}
+
+// Random ranges that each cover selectivity * dataSize of the sorted keys
+vector<KeyRange> makeRanges(const vector<string> &sortedKeys,
+                            double selectivity, size_t count,
+                            mt19937_64 &rng) {
+  size_t width = max<size_t>(1, (size_t)(selectivity * sortedKeys.size()));
+  width = min(width, sortedKeys.size());
+  uniform_int_distribution<size_t> start(0, sortedKeys.size() - width);
+  vector<KeyRange> ranges;
+  for (size_t i = 0; i < count; ++i) {
+    size_t lo = start(rng);
+    ranges.push_back({sortedKeys[lo], sortedKeys[lo + width - 1]});
+  }
+  return ranges;
+}
+
+// Interleave inserts of absent rows, erases of present rows and range
+// queries. Rows after dataSize start out absent, so inserts add new keys
+// while there are any; otherwise they re-insert erased rows or update.
+vector<MixedOp> makeMixedOps(const vector<string> &sortedKeys,
+                             size_t dataSize, size_t totalRows,
+                             const MixedWorkload &workload, mt19937_64 &rng) {
+  vector<size_t> present(dataSize), absent;
+  for (size_t i = 0; i < dataSize; ++i)
+    present[i] = i;
+  for (size_t i = min(totalRows, dataSize * 2); i > dataSize; --i)
+    absent.push_back(i - 1);
+
+  vector<KeyRange> ranges =
+      makeRanges(sortedKeys, workload.selectivity, workload.operations, rng);
+  uniform_real_distribution<double> coin(0.0, 1.0);
+  vector<MixedOp> ops;
+  for (size_t i = 0; i < workload.operations; ++i) {
+    double r = coin(rng);
+    if (r < workload.rangeRatio) {
+      ops.push_back({MixedOp::Range, 0, ranges[i]});
+    } else if (r < workload.rangeRatio + workload.insertRatio ||
+               present.empty()) {
+      if (absent.empty()) {
+        // nothing left to add, update a present row instead
+        size_t row = present[uniform_int_distribution<size_t>(
+            0, present.size() - 1)(rng)];
+        ops.push_back({MixedOp::Insert, row, {}});
+        continue;
+      }
+      size_t pick = uniform_int_distribution<size_t>(0, absent.size() - 1)(rng);
+      ops.push_back({MixedOp::Insert, absent[pick], {}});
+      present.push_back(absent[pick]);
+      absent[pick] = absent.back();
+      absent.pop_back();
+    } else {
+      size_t pick =
+          uniform_int_distribution<size_t>(0, present.size() - 1)(rng);
+      ops.push_back({MixedOp::Erase, present[pick], {}});
+      absent.push_back(present[pick]);
+      present[pick] = present.back();
+      present.pop_back();
+    }
+  }
+  return ops;
+}
+
+double elapsedMs(high_resolution_clock::time_point start) {
+  auto end = high_resolution_clock::now();
+  return duration_cast<nanoseconds>(end - start).count() / 1e6;
+}
+
+template <typename MapType>
+vector<BenchmarkResult>
+benchmark(const vector<pair<string, int>> &data, size_t dataSize,
+          const vector<double> &selectivities,
+          const vector<vector<KeyRange>> &rangesBySelectivity,
+          const MixedWorkload &workload, const vector<MixedOp> &mixedOps,
+          const string &containerName) {
+  vector<BenchmarkResult> results;
+  MapType map;
+
+  // Insert
+  auto start = high_resolution_clock::now();
+  for (size_t i = 0; i < dataSize; ++i) {
+    map[data[i].first] = data[i].second;
+  }
+  results.push_back({containerName, dataSize, "insert", 0.0, dataSize, 0,
+                     elapsedMs(start)});
+
+  // Range queries, materialized and counted, per selectivity
+  vector<int> out;
+  for (size_t s = 0; s < selectivities.size(); ++s) {
+    const auto &ranges = rangesBySelectivity[s];
+    size_t rows = 0;
+    start = high_resolution_clock::now();
+    for (const auto &range : ranges) {
+      out.clear();
+      rows += rangeCollect(map, range, out);
+    }
+    results.push_back({containerName, dataSize, "range_collect",
+                       selectivities[s], ranges.size(), rows,
+                       elapsedMs(start)});
+
+    rows = 0;
+    start = high_resolution_clock::now();
+    for (const auto &range : ranges) {
+      rows += rangeCount(map, range);
+    }
+    results.push_back({containerName, dataSize, "range_count",
+                       selectivities[s], ranges.size(), rows,
+                       elapsedMs(start)});
+  }
+
+  // Every percentile of the keys, from 1 to 100
+  vector<double> fractions;
+  for (int p = 1; p <= 100; ++p)
+    fractions.push_back(p / 100.0);
+  vector<string> keys;
+  start = high_resolution_clock::now();
+  size_t rows = percentiles(map, fractions, keys);
+  results.push_back({containerName, dataSize, "percentiles", 0.0,
+                     fractions.size(), rows, elapsedMs(start)});
+
+  // Mixed inserts, erases and range counts
+  rows = 0;
+  start = high_resolution_clock::now();
+  for (const auto &op : mixedOps) {
+    switch (op.type) {
+    case MixedOp::Insert:
+      map[data[op.row].first] = data[op.row].second;
+      break;
+    case MixedOp::Erase:
+      map.erase(data[op.row].first);
+      break;
+    case MixedOp::Range:
+      rows += rangeCount(map, op.range);
+      break;
+    }
+  }
+  results.push_back({containerName, dataSize, "mixed", workload.selectivity,
+                     mixedOps.size(), rows, elapsedMs(start)});
+
+  // Delete every row the mixed workload may have touched
+  size_t touchedRows = min(data.size(), dataSize * 2);
+  start = high_resolution_clock::now();
+  for (size_t i = 0; i < touchedRows; i++) {
+    map.erase(data[i].first);
+  }
+  results.push_back({containerName, dataSize, "erase", 0.0, touchedRows, 0,
+                     elapsedMs(start)});
+  return results;
+}
+
+void printResults(const vector<BenchmarkResult> &results) {
+  cout << "Container,DataSize,Phase,Selectivity,Operations,Rows,Time(ms)"
+       << endl;
+  for (const auto &result : results) {
+    cout << result.container << "," << result.dataSize << "," << result.phase
+         << "," << result.selectivity << "," << result.operations << ","
+         << result.rows << "," << result.time << endl;
+  }
+}
+
+void saveResultsToCSV(const vector<BenchmarkResult> &results,
+                      const string &filename) {
+  ofstream file(filename);
+  file << "Container,DataSize,Phase,Selectivity,Operations,Rows,Time(ms)\n";
+  for (const auto &result : results) {
+    file << result.container << "," << result.dataSize << "," << result.phase
+         << "," << result.selectivity << "," << result.operations << ","
+         << result.rows << "," << result.time << "\n";
+  }
+}
+
+template <typename MapType>
+void runContainer(vector<BenchmarkResult> &results,
+                  const vector<pair<string, int>> &data, size_t scale,
+                  const vector<double> &selectivities,
+                  const vector<vector<KeyRange>> &ranges,
+                  const MixedWorkload &workload, const vector<MixedOp> &ops,
+                  const string &containerName) {
+  auto containerResults = benchmark<MapType>(
+      data, scale, selectivities, ranges, workload, ops, containerName);
+  results.insert(results.end(), containerResults.begin(),
+                 containerResults.end());
+}
+
+int main() {
+  cout << "Reading data from file" << endl;
+  vector<pair<string, int>> data = readCSV("../data/data.csv");
+  cout << "Data read successfully" << endl;
+  vector<size_t> scales = {500, 20000, 500000, 10000000};
+  // fraction of the keys covered by one range query
+  vector<double> selectivities = {0.0001, 0.001, 0.01, 0.1};
+  // a full scan per query for the hash maps, so keep the counts small
+  size_t rangeQueries = 100;
+  MixedWorkload workload = {0.45, 0.02, 0.001, 10000};
+  vector<BenchmarkResult> results;
+
+  for (size_t scale : scales) {
+    if (scale > data.size()) {
+      cerr << "Scale " << scale << " is larger than the available data size."
+           << endl;
+      continue;
+    }
+    cout << "Benchmarking with scale " << scale << "..." << endl;
+    // the same queries and operations are replayed for every container
+    mt19937_64 rng(scale);
+    vector<string> sortedKeys;
+    for (size_t i = 0; i < scale; ++i)
+      sortedKeys.push_back(data[i].first);
+    sort(sortedKeys.begin(), sortedKeys.end());
+    vector<vector<KeyRange>> ranges;
+    for (double selectivity : selectivities)
+      ranges.push_back(makeRanges(sortedKeys, selectivity, rangeQueries, rng));
+    vector<MixedOp> ops =
+        makeMixedOps(sortedKeys, scale, data.size(), workload, rng);
+
+    runContainer<unordered_map<string, int>>(results, data, scale,
+                                             selectivities, ranges, workload,
+                                             ops, "unordered_map");
+    runContainer<unordered_map<string, int, CustomHashFNV1A>>(
+        results, data, scale, selectivities, ranges, workload, ops,
+        "unordered_map_fnv1a");
+    runContainer<unordered_map<string, int, CustomHashMod>>(
+        results, data, scale, selectivities, ranges, workload, ops,
+        "unordered_map_mod");
+    runContainer<map<string, int>>(results, data, scale, selectivities,
+                                   ranges, workload, ops, "map");
+    runContainer<BpTree<string, int>>(results, data, scale, selectivities,
+                                      ranges, workload, ops, "B+Tree");
+  }
+
+  saveResultsToCSV(results, "../data/results/benchmark2_results.csv");
+  printResults(results);
+  return 0;
+}
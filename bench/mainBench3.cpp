@@ -0,0 +1,301 @@
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "BenchUtils.h"
+#include "BpTree.h"
+#include "CommandLine.h"
+#include "ConcurrentMaps.h"
+#include "FlatHashMap.h"
+#include "LatencyHistogram.h"
+#include "Workload.h"
+
+using namespace std;
+using namespace std::chrono;
+
+struct BenchmarkResult {
+  string container;
+  size_t dataSize;
+  string workload;
+  string distribution;
+  size_t threads;
+  size_t operations;
+  double time;
+  double throughput; // operations per second
+  LatencyHistogram::Summary latency;
+};
+
+// One workload mix run with one key distribution, and its operations
+struct WorkloadRun {
+  WorkloadMix mix;
+  KeyDistribution distribution;
+  vector<Operation> ops;
+};
+
+double elapsedMs(high_resolution_clock::time_point start) {
+  auto end = high_resolution_clock::now();
+  return duration_cast<nanoseconds>(end - start).count() / 1e6;
+}
+
+template <typename MapType>
+void benchmark(vector<BenchmarkResult> &results,
+               const vector<pair<string, int>> &data, size_t dataSize,
+               const vector<WorkloadRun> &runs, const string &containerName) {
+  MapType map;
+  // Load
+  auto start = high_resolution_clock::now();
+  for (size_t i = 0; i < dataSize; ++i) {
+    map[data[i].first] = data[i].second;
+  }
+  double loadTime = elapsedMs(start);
+  results.push_back({containerName, dataSize, "load", "sequential", 1,
+                     dataSize, loadTime, dataSize / loadTime * 1e3, {}});
+
+  // Run the workloads one after the other on the loaded container
+  volatile size_t checksum = 0;
+  for (const auto &run : runs) {
+    if (run.mix.scan > 0 && !OrderedScan<MapType>::supported) {
+      // no ordered scans, only keep the key space in line with the others
+      applyInserts(map, run.ops);
+      continue;
+    }
+    LatencyHistogram latency;
+    start = high_resolution_clock::now();
+    checksum = checksum + runOperations(map, run.ops, &latency);
+    double time = elapsedMs(start);
+    results.push_back({containerName, dataSize, run.mix.name,
+                       distributionName(run.distribution), 1, run.ops.size(),
+                       time, run.ops.size() / time * 1e3, latency.summary()});
+  }
+}
+
+// Pin the calling thread to one core, so that threads do not migrate during
+// a run
+void pinThread(size_t index) {
+#ifdef __linux__
+  size_t cores = max<size_t>(1, thread::hardware_concurrency());
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(index % cores, &set);
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+template <typename ConcurrentMap>
+void benchmarkThreads(vector<BenchmarkResult> &results,
+                      const vector<pair<string, int>> &data, size_t dataSize,
+                      const vector<WorkloadRun> &runs,
+                      const vector<size_t> &threadCounts,
+                      const string &containerName) {
+  ConcurrentMap map;
+  for (size_t i = 0; i < dataSize; ++i) {
+    map.upsert(data[i].first, data[i].second);
+  }
+
+  for (const auto &run : runs) {
+    for (size_t threads : threadCounts) {
+      // every thread replays its own slice of the operations
+      vector<LatencyHistogram> latencies(threads);
+      atomic<size_t> checksum{0};
+      atomic<size_t> ready{0};
+      atomic<bool> go{false};
+      vector<thread> workers;
+      for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+          pinThread(t);
+          size_t begin = run.ops.size() * t / threads;
+          size_t end = run.ops.size() * (t + 1) / threads;
+          // start barrier: wait until every thread is ready
+          ready.fetch_add(1);
+          while (!go.load(memory_order_acquire)) {
+          }
+          size_t sum = 0; // thread local, so that threads share no line
+          for (size_t i = begin; i < end; ++i) {
+            latencies[t].time(
+                [&]() { sum += runConcurrentOperation(map, run.ops[i]); });
+          }
+          checksum += sum;
+        });
+      }
+      while (ready.load() < threads) {
+        this_thread::yield();
+      }
+      auto start = high_resolution_clock::now();
+      go.store(true, memory_order_release);
+      for (auto &worker : workers) {
+        worker.join();
+      }
+      double time = elapsedMs(start);
+
+      LatencyHistogram latency;
+      for (const auto &threadLatency : latencies) {
+        latency.merge(threadLatency);
+      }
+      results.push_back({containerName, dataSize, run.mix.name,
+                         distributionName(run.distribution), threads,
+                         run.ops.size(), time, run.ops.size() / time * 1e3,
+                         latency.summary()});
+    }
+  }
+}
+
+string resultsHeader() {
+  return "Container,DataSize,Workload,Distribution,Threads,Operations,"
+         "Time(ms),Throughput(ops/s)," +
+         LatencyHistogram::Summary::header("");
+}
+
+void writeResult(ostream &os, const BenchmarkResult &result) {
+  os << result.container << "," << result.dataSize << "," << result.workload
+     << "," << result.distribution << "," << result.threads << ","
+     << result.operations << ","
+     << result.time << "," << result.throughput << "," << result.latency;
+}
+
+void printResults(const vector<BenchmarkResult> &results) {
+  cout << resultsHeader() << endl;
+  for (const auto &result : results) {
+    writeResult(cout, result);
+    cout << endl;
+  }
+}
+
+void saveResultsToCSV(const vector<BenchmarkResult> &results,
+                      const string &filename) {
+  ofstream file(filename);
+  file << resultsHeader() << "\n";
+  for (const auto &result : results) {
+    writeResult(file, result);
+    file << "\n";
+  }
+}
+
+// Every mix under every distribution, single-threaded
+void runWorkloads(const vector<pair<string, int>> &data,
+                  const vector<size_t> &scales,
+                  vector<BenchmarkResult> &results) {
+  vector<KeyDistribution> distributions = {
+      KeyDistribution::Uniform, KeyDistribution::Zipfian,
+      KeyDistribution::Latest, KeyDistribution::Hotspot};
+  size_t operations = 100000; // per workload run
+
+  for (size_t scale : scales) {
+    if (scale > data.size()) {
+      cerr << "Scale " << scale << " is larger than the available data size."
+           << endl;
+      continue;
+    }
+    cout << "Benchmarking with scale " << scale << "..." << endl;
+    // the same operations are replayed for every container
+    mt19937_64 rng(scale);
+    KeySpace keys(data, scale);
+    vector<WorkloadRun> runs;
+    for (const auto &mix : ycsbWorkloads()) {
+      for (KeyDistribution distribution : distributions) {
+        runs.push_back({mix, distribution,
+                        generateOperations(mix, distribution, keys,
+                                           operations, rng)});
+      }
+    }
+
+    benchmark<unordered_map<string, int>>(results, data, scale, runs,
+                                          "unordered_map");
+    benchmark<unordered_map<string, int, CustomHashFNV1A>>(
+        results, data, scale, runs, "unordered_map_fnv1a");
+    benchmark<unordered_map<string, int, CustomHashMod>>(
+        results, data, scale, runs, "unordered_map_mod");
+    benchmark<FlatHashMap<string, int>>(results, data, scale, runs,
+                                        "flat_hash_map");
+    benchmark<map<string, int>>(results, data, scale, runs, "map");
+    benchmark<BpTree<string, int>>(results, data, scale, runs, "B+Tree");
+  }
+}
+
+// The read-only and read/update mixes on 1, 2, 4, ... maxThreads threads
+void runScaling(const vector<pair<string, int>> &data,
+                const vector<size_t> &scales, size_t maxThreads,
+                vector<BenchmarkResult> &results) {
+  vector<size_t> threadCounts;
+  for (size_t threads = 1; threads < maxThreads; threads *= 2)
+    threadCounts.push_back(threads);
+  threadCounts.push_back(maxThreads);
+  size_t operations = 1000000; // per run, split across the threads
+
+  for (size_t scale : scales) {
+    if (scale > data.size()) {
+      cerr << "Scale " << scale << " is larger than the available data size."
+           << endl;
+      continue;
+    }
+    cout << "Benchmarking with scale " << scale << " on up to " << maxThreads
+         << " threads..." << endl;
+    mt19937_64 rng(scale);
+    KeySpace keys(data, scale);
+    vector<WorkloadRun> runs;
+    for (const auto &mix : ycsbWorkloads()) {
+      if (mix.insert > 0 || mix.scan > 0)
+        continue; // keep the key set fixed across the thread counts
+      runs.push_back({mix, mix.distribution,
+                      generateOperations(mix, mix.distribution, keys,
+                                         operations, rng)});
+    }
+
+    benchmarkThreads<ShardedHashMap<string, int>>(
+        results, data, scale, runs, threadCounts, "unordered_map_sharded");
+    benchmarkThreads<SharedMutexMap<map<string, int>>>(
+        results, data, scale, runs, threadCounts, "map_shared_mutex");
+    benchmarkThreads<SharedMutexMap<BpTree<string, int>>>(
+        results, data, scale, runs, threadCounts, "B+Tree_shared_mutex");
+    benchmarkThreads<OlcTreeMap<string, int>>(results, data, scale, runs,
+                                              threadCounts, "B+Tree_olc");
+  }
+}
+
+int main(int argc, char *argv[]) {
+  // --threads N switches to the multi-threaded scaling runs
+  size_t maxThreads = 0;
+  for (int i = 1; i < argc; ++i) {
+    string option = argv[i];
+    if (option != "--threads") {
+      cerr << "Unknown option: " << option << endl;
+    } else if (i + 1 >= argc) {
+      cerr << "Missing value: " << option << endl;
+    } else if (!parseWholeNumber(argv[++i], maxThreads)) {
+      cerr << "Invalid number for " << option << ": " << argv[i] << endl;
+    } else {
+      continue;
+    }
+    cerr << "Usage: " << argv[0] << " [--threads N]" << endl;
+    return 1;
+  }
+
+  cout << "Reading data from file" << endl;
+  vector<pair<string, int>> data = readCSV("../data/data.csv");
+  cout << "Data read successfully" << endl;
+  vector<size_t> scales = {500, 20000, 500000, 10000000};
+  vector<BenchmarkResult> results;
+
+  if (maxThreads > 0) {
+    runScaling(data, scales, maxThreads, results);
+    saveResultsToCSV(results,
+                     "../data/results/benchmark3_threads_results.csv");
+  } else {
+    runWorkloads(data, scales, results);
+    saveResultsToCSV(results, "../data/results/benchmark3_results.csv");
+  }
+  printResults(results);
+  return 0;
+}
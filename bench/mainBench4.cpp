@@ -0,0 +1,174 @@
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "BpTree.h"
+#include "Dataset.h"
+#include "FlatHashMap.h"
+
+using namespace std;
+using namespace std::chrono;
+
+struct BenchmarkResult {
+  string container;
+  size_t dataSize;
+  string phase;
+  size_t operations;
+  double time;
+  double throughput; // operations per second
+};
+
+// A studentID the node search does not recognize as integral, so that the
+// tree falls back to std::lower_bound/upper_bound
+struct BinarySearchKey {
+  uint64_t value;
+
+  bool operator<(const BinarySearchKey &other) const {
+    return value < other.value;
+  }
+  bool operator>(const BinarySearchKey &other) const {
+    return value > other.value;
+  }
+  bool operator>=(const BinarySearchKey &other) const {
+    return value >= other.value;
+  }
+  bool operator==(const BinarySearchKey &other) const {
+    return value == other.value;
+  }
+  bool operator!=(const BinarySearchKey &other) const {
+    return value != other.value;
+  }
+};
+
+template <typename MapType, typename Key>
+const int *findData(MapType &map, const Key &key) {
+  auto it = map.find(key);
+  return it == map.end() ? nullptr : &it->second;
+}
+
+template <typename K, typename V, typename P>
+const int *findData(BpTree<K, V, P> &tree, const K &key) {
+  return tree.search(key);
+}
+
+double elapsedMs(high_resolution_clock::time_point start) {
+  auto end = high_resolution_clock::now();
+  return duration_cast<nanoseconds>(end - start).count() / 1e6;
+}
+
+template <typename MapType, typename Key>
+void benchmark(vector<BenchmarkResult> &results, const vector<Key> &keys,
+               size_t dataSize, const vector<Key> &hits,
+               const vector<Key> &misses, const string &containerName) {
+  MapType map;
+  auto start = high_resolution_clock::now();
+  for (size_t i = 0; i < dataSize; ++i) {
+    map[keys[i]] = (int)i;
+  }
+  double time = elapsedMs(start);
+  results.push_back({containerName, dataSize, "insert", dataSize, time,
+                     dataSize / time * 1e3});
+
+  volatile size_t checksum = 0;
+  for (const auto *lookups : {&hits, &misses}) {
+    size_t found = 0;
+    start = high_resolution_clock::now();
+    for (const Key &key : *lookups) {
+      if (const int *data = findData(map, key))
+        found += (size_t)*data + 1;
+    }
+    time = elapsedMs(start);
+    checksum = checksum + found;
+    results.push_back({containerName, dataSize,
+                       lookups == &hits ? "lookup_hit" : "lookup_miss",
+                       lookups->size(), time, lookups->size() / time * 1e3});
+  }
+}
+
+// Run one container on the first dataSize studentIDs, converted to the Key
+// type the container is indexed by
+template <typename MapType, typename Key>
+void runContainer(vector<BenchmarkResult> &results,
+                  const vector<uint64_t> &ids, size_t dataSize,
+                  const vector<uint64_t> &hits, const vector<uint64_t> &misses,
+                  const string &containerName) {
+  auto convert = [](const vector<uint64_t> &from, size_t count) {
+    vector<Key> to;
+    to.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+      to.push_back(Key{from[i]});
+    return to;
+  };
+  benchmark<MapType, Key>(results, convert(ids, dataSize), dataSize,
+                          convert(hits, hits.size()),
+                          convert(misses, misses.size()), containerName);
+}
+
+void printResults(const vector<BenchmarkResult> &results) {
+  cout << "Container,DataSize,Phase,Operations,Time(ms),Throughput(ops/s)"
+       << endl;
+  for (const auto &result : results) {
+    cout << result.container << "," << result.dataSize << "," << result.phase
+         << "," << result.operations << "," << result.time << ","
+         << result.throughput << endl;
+  }
+}
+
+void saveResultsToCSV(const vector<BenchmarkResult> &results,
+                      const string &filename) {
+  ofstream file(filename);
+  file << "Container,DataSize,Phase,Operations,Time(ms),Throughput(ops/s)\n";
+  for (const auto &result : results) {
+    file << result.container << "," << result.dataSize << "," << result.phase
+         << "," << result.operations << "," << result.time << ","
+         << result.throughput << "\n";
+  }
+}
+
+int main() {
+  cout << "Reading data from file" << endl;
+  Dataset dataset = loadDataset("../data/data.csv");
+  const vector<uint64_t> &ids = dataset.studentIds;
+  cout << "Data read successfully" << endl;
+  vector<size_t> scales = {500, 20000, 500000, 10000000};
+  size_t lookups = 1000000; // per phase
+  vector<BenchmarkResult> results;
+
+  for (size_t scale : scales) {
+    if (scale > ids.size()) {
+      cerr << "Scale " << scale << " is larger than the available data size."
+           << endl;
+      continue;
+    }
+    cout << "Benchmarking with scale " << scale << "..." << endl;
+    // random loaded ids, and their neighbours, which are hardly ever loaded
+    mt19937_64 rng(scale);
+    uniform_int_distribution<size_t> row(0, scale - 1);
+    vector<uint64_t> hits, misses;
+    for (size_t i = 0; i < lookups; ++i) {
+      hits.push_back(ids[row(rng)]);
+      misses.push_back(ids[row(rng)] + 1);
+    }
+
+    runContainer<unordered_map<uint64_t, int>, uint64_t>(
+        results, ids, scale, hits, misses, "unordered_map");
+    runContainer<FlatHashMap<uint64_t, int>, uint64_t>(
+        results, ids, scale, hits, misses, "flat_hash_map");
+    runContainer<map<uint64_t, int>, uint64_t>(results, ids, scale, hits,
+                                               misses, "map");
+    runContainer<BpTree<BinarySearchKey, int>, BinarySearchKey>(
+        results, ids, scale, hits, misses, "B+Tree_binary");
+    runContainer<BpTree<uint64_t, int>, uint64_t>(results, ids, scale, hits,
+                                                  misses, "B+Tree_simd");
+  }
+
+  saveResultsToCSV(results, "../data/results/benchmark4_results.csv");
+  printResults(results);
+  return 0;
+}
@@ -0,0 +1,217 @@
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <malloc.h>
+#include <unistd.h>
+
+#include "BpTree.h"
+#include "Dataset.h"
+#include "DiskBpTree.h"
+
+using namespace std;
+using namespace std::chrono;
+
+struct BenchmarkResult {
+  string container;
+  size_t dataSize;
+  string phase;
+  size_t operations;
+  double time;
+  // growth of the resident set during the phase, for lookups since the
+  // restart before them
+  size_t residentBytes;
+  size_t fileBytes; // size of the tree file, 0 for the in-memory tree
+  size_t rejected;  // inserts the build refused, as duplicates or for space
+};
+
+// the dataset keys are two names of 3 to 8 letters joined by '_', at most 17
+// bytes; a shorter FixedKey would cut them and make some collide
+using DiskKey = FixedKey<24>;
+const string dataFile = "../data/data.csv";
+
+double elapsedMs(high_resolution_clock::time_point start) {
+  auto end = high_resolution_clock::now();
+  return duration_cast<nanoseconds>(end - start).count() / 1e6;
+}
+
+// Resident set of the process, freed heap memory is returned first so that
+// it is not reused unnoticed by the next phase
+size_t residentBytes() {
+  malloc_trim(0);
+  size_t pages = 0, resident = 0;
+  ifstream statm("/proc/self/statm");
+  statm >> pages >> resident;
+  return resident * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+size_t residentGrowth(size_t before) {
+  size_t now = residentBytes();
+  return now > before ? now - before : 0;
+}
+
+// Drop the cached pages of a file, so that it is read from disk again
+void evictFromPageCache(const string &filename) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+  }
+}
+
+template <typename Tree, typename Key>
+void lookup(vector<BenchmarkResult> &results, Tree &tree,
+            const vector<Key> &keys, size_t residentBefore, size_t fileBytes,
+            const string &containerName, size_t dataSize) {
+  size_t found = 0;
+  auto start = high_resolution_clock::now();
+  for (const Key &key : keys) {
+    if (auto *data = tree.search(key))
+      found += (size_t)*data + 1;
+  }
+  double time = elapsedMs(start);
+  volatile size_t checksum = found;
+  (void)checksum;
+  results.push_back({containerName, dataSize, "lookup", keys.size(), time,
+                     residentGrowth(residentBefore), fileBytes, 0});
+}
+
+// The in-memory tree: built row by row, and restarted the way it is today,
+// by parsing the CSV file and bulk loading the first dataSize rows
+void benchmarkMemory(vector<BenchmarkResult> &results, const Dataset &dataset,
+                     size_t dataSize, const vector<size_t> &lookupRows) {
+  const string containerName = "B+Tree";
+  {
+    size_t before = residentBytes();
+    auto start = high_resolution_clock::now();
+    BpTree<string, int> tree;
+    for (size_t i = 0; i < dataSize; ++i)
+      tree.insert(string(dataset.keys[i]), (int)i);
+    double time = elapsedMs(start);
+    results.push_back({containerName, dataSize, "build", dataSize, time,
+                       residentGrowth(before), 0, 0});
+  }
+
+  vector<string> keys;
+  for (size_t row : lookupRows)
+    keys.emplace_back(dataset.keys[row]);
+  size_t before = residentBytes();
+  auto start = high_resolution_clock::now();
+  BpTree<string, int> tree;
+  {
+    Dataset reloaded = loadDataset(dataFile);
+    vector<pair<string, int>> rows;
+    rows.reserve(dataSize);
+    for (size_t i = 0; i < dataSize; ++i)
+      rows.emplace_back(reloaded.keys[i], (int)i);
+    tree.bulkLoadUnsorted(rows.begin(), rows.end());
+  }
+  double time = elapsedMs(start);
+  results.push_back({containerName, dataSize, "restart", 1, time,
+                     residentGrowth(before), 0, 0});
+  lookup(results, tree, keys, before, 0, containerName, dataSize);
+}
+
+// The disk tree: built row by row into a new file, then restarted by
+// reopening the file with none of it in the page cache
+template <size_t PageSize>
+void benchmarkDisk(vector<BenchmarkResult> &results, const Dataset &dataset,
+                   size_t dataSize, const vector<size_t> &lookupRows,
+                   const string &containerName) {
+  const string filename = "../data/bench5_" + to_string(PageSize) + ".db";
+  remove(filename.c_str());
+  size_t fileBytes = 0;
+  {
+    size_t before = residentBytes();
+    size_t rejected = 0;
+    auto start = high_resolution_clock::now();
+    DiskBpTree<DiskKey, int, PageSize> tree(filename);
+    for (size_t i = 0; i < dataSize; ++i)
+      rejected += !tree.insert(DiskKey(dataset.keys[i]), (int)i);
+    tree.sync();
+    double time = elapsedMs(start);
+    fileBytes = tree.fileSize();
+    if (rejected > 0) {
+      cerr << containerName << " refused " << rejected << " of " << dataSize
+           << " inserts" << endl;
+    }
+    results.push_back({containerName, dataSize, "build", dataSize, time,
+                       residentGrowth(before), fileBytes, rejected});
+  }
+  evictFromPageCache(filename);
+
+  vector<DiskKey> keys;
+  for (size_t row : lookupRows)
+    keys.emplace_back(dataset.keys[row]);
+  size_t before = residentBytes();
+  auto start = high_resolution_clock::now();
+  DiskBpTree<DiskKey, int, PageSize> tree(filename);
+  double time = elapsedMs(start);
+  results.push_back({containerName, dataSize, "restart", 1, time,
+                     residentGrowth(before), fileBytes, 0});
+  lookup(results, tree, keys, before, fileBytes, containerName, dataSize);
+  remove(filename.c_str());
+}
+
+void printResults(const vector<BenchmarkResult> &results) {
+  cout << "Container,DataSize,Phase,Operations,Time(ms),ResidentBytes,"
+          "FileBytes,Rejected"
+       << endl;
+  for (const auto &result : results) {
+    cout << result.container << "," << result.dataSize << "," << result.phase
+         << "," << result.operations << "," << result.time << ","
+         << result.residentBytes << "," << result.fileBytes << ","
+         << result.rejected << endl;
+  }
+}
+
+void saveResultsToCSV(const vector<BenchmarkResult> &results,
+                      const string &filename) {
+  ofstream file(filename);
+  file << "Container,DataSize,Phase,Operations,Time(ms),ResidentBytes,"
+          "FileBytes,Rejected\n";
+  for (const auto &result : results) {
+    file << result.container << "," << result.dataSize << "," << result.phase
+         << "," << result.operations << "," << result.time << ","
+         << result.residentBytes << "," << result.fileBytes << ","
+         << result.rejected << "\n";
+  }
+}
+
+int main() {
+  cout << "Reading data from file" << endl;
+  Dataset dataset = loadDataset(dataFile);
+  cout << "Data read successfully" << endl;
+  vector<size_t> scales = {500, 20000, 500000, 10000000};
+  size_t lookups = 1000000;
+  vector<BenchmarkResult> results;
+
+  for (size_t scale : scales) {
+    if (scale > dataset.size()) {
+      cerr << "Scale " << scale << " is larger than the available data size."
+           << endl;
+      continue;
+    }
+    cout << "Benchmarking with scale " << scale << "..." << endl;
+    mt19937_64 rng(scale);
+    uniform_int_distribution<size_t> row(0, scale - 1);
+    vector<size_t> lookupRows;
+    for (size_t i = 0; i < lookups; ++i)
+      lookupRows.push_back(row(rng));
+
+    benchmarkMemory(results, dataset, scale, lookupRows);
+    benchmarkDisk<4096>(results, dataset, scale, lookupRows, "DiskB+Tree_4K");
+    benchmarkDisk<16384>(results, dataset, scale, lookupRows,
+                         "DiskB+Tree_16K");
+  }
+
+  saveResultsToCSV(results, "../data/results/benchmark5_results.csv");
+  printResults(results);
+  return 0;
+}
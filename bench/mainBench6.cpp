@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "BenchUtils.h"
+#include "BpTree.h"
+#include "WriteAheadLog.h"
+
+using namespace std;
+using namespace std::chrono;
+
+struct BenchmarkResult {
+  string container;
+  size_t commitBatch; // records per sync, 0 without a log
+  size_t dataSize;
+  string phase;
+  size_t operations;
+  double time;
+  size_t syncs; // of the log, for the insert phases
+  size_t bytes; // log or checkpoint bytes written
+};
+
+using LoggedTree = LoggedBpTree<string, int>;
+const string directory = "../data/bench6_wal";
+const vector<size_t> commitBatches = {1, 8, 64, 512, 4096};
+// a sync takes tens of microseconds to milliseconds, so the small commit
+// batches insert fewer rows to keep their runs short
+const size_t maxSyncs = 20000;
+// the throughput runs never checkpoint by themselves
+const LoggedTree::Options noCheckpoints = {1, ~(size_t)0};
+
+double elapsedMs(high_resolution_clock::time_point start) {
+  auto end = high_resolution_clock::now();
+  return duration_cast<nanoseconds>(end - start).count() / 1e6;
+}
+
+size_t fileSize(const string &filename) {
+  ifstream file(filename, ios::binary | ios::ate);
+  return file ? (size_t)file.tellg() : 0;
+}
+
+void removeTree() {
+  remove((directory + "/wal").c_str());
+  remove((directory + "/checkpoint").c_str());
+  remove(directory.c_str());
+}
+
+// Inserts without a log, the upper bound for the logged runs
+void benchmarkUnlogged(vector<BenchmarkResult> &results,
+                       const vector<pair<string, int>> &data,
+                       size_t dataSize) {
+  auto start = high_resolution_clock::now();
+  BpTree<string, int> tree;
+  for (size_t i = 0; i < dataSize; ++i)
+    tree.insert(data[i].first, data[i].second);
+  double time = elapsedMs(start);
+  results.push_back({"B+Tree", 0, dataSize, "insert", dataSize, time, 0, 0});
+}
+
+// Inserts with one sync per commitBatch of them
+void benchmarkCommitBatch(vector<BenchmarkResult> &results,
+                          const vector<pair<string, int>> &data,
+                          size_t dataSize, size_t commitBatch) {
+  removeTree();
+  size_t operations = min(dataSize, commitBatch * maxSyncs);
+  LoggedTree::Options options = noCheckpoints;
+  options.commitBatch = commitBatch;
+  auto start = high_resolution_clock::now();
+  LoggedTree tree(directory, options);
+  for (size_t i = 0; i < operations; ++i)
+    tree.insert(data[i].first, data[i].second);
+  tree.commit();
+  double time = elapsedMs(start);
+  const WriteAheadLog &log = tree.writeAheadLog();
+  results.push_back({"B+Tree+WAL", commitBatch, dataSize, "insert",
+                     operations, time, log.syncCount(), log.size()});
+}
+
+// Recovery of all rows from the log alone, a checkpoint of them, and
+// recovery from the checkpoint
+void benchmarkRecovery(vector<BenchmarkResult> &results,
+                       const vector<pair<string, int>> &data,
+                       size_t dataSize) {
+  const size_t commitBatch = commitBatches.back();
+  removeTree();
+  {
+    LoggedTree::Options options = noCheckpoints;
+    options.commitBatch = commitBatch;
+    LoggedTree tree(directory, options);
+    for (size_t i = 0; i < dataSize; ++i)
+      tree.insert(data[i].first, data[i].second);
+  }
+  size_t logBytes = fileSize(directory + "/wal");
+  {
+    auto start = high_resolution_clock::now();
+    LoggedTree tree(directory, noCheckpoints);
+    double time = elapsedMs(start);
+    results.push_back({"B+Tree+WAL", commitBatch, dataSize, "recover_log",
+                       tree.view().size(), time, 0, logBytes});
+
+    start = high_resolution_clock::now();
+    tree.checkpoint();
+    time = elapsedMs(start);
+    results.push_back({"B+Tree+WAL", commitBatch, dataSize, "checkpoint",
+                       tree.view().size(), time, 0,
+                       fileSize(directory + "/checkpoint")});
+  }
+  auto start = high_resolution_clock::now();
+  LoggedTree tree(directory, noCheckpoints);
+  double time = elapsedMs(start);
+  results.push_back({"B+Tree+WAL", commitBatch, dataSize,
+                     "recover_checkpoint", tree.view().size(), time, 0,
+                     fileSize(directory + "/checkpoint")});
+  removeTree();
+}
+
+void printResults(const vector<BenchmarkResult> &results) {
+  cout << "Container,CommitBatch,DataSize,Phase,Operations,Time(ms),"
+          "Throughput(ops/s),Syncs,Bytes"
+       << endl;
+  for (const auto &result : results) {
+    cout << result.container << "," << result.commitBatch << ","
+         << result.dataSize << "," << result.phase << "," << result.operations
+         << "," << result.time << ","
+         << result.operations / (result.time / 1000) << "," << result.syncs
+         << "," << result.bytes << endl;
+  }
+}
+
+void saveResultsToCSV(const vector<BenchmarkResult> &results,
+                      const string &filename) {
+  ofstream file(filename);
+  file << "Container,CommitBatch,DataSize,Phase,Operations,Time(ms),"
+          "Throughput(ops/s),Syncs,Bytes\n";
+  for (const auto &result : results) {
+    file << result.container << "," << result.commitBatch << ","
+         << result.dataSize << "," << result.phase << "," << result.operations
+         << "," << result.time << ","
+         << result.operations / (result.time / 1000) << "," << result.syncs
+         << "," << result.bytes << "\n";
+  }
+}
+
+int main() {
+  cout << "Reading data from file" << endl;
+  vector<pair<string, int>> data = readCSV("../data/data.csv");
+  cout << "Data read successfully" << endl;
+  vector<size_t> scales = {500, 20000, 500000, 10000000};
+  vector<BenchmarkResult> results;
+
+  for (size_t scale : scales) {
+    if (scale > data.size()) {
+      cerr << "Scale " << scale << " is larger than the available data size."
+           << endl;
+      continue;
+    }
+    cout << "Benchmarking with scale " << scale << "..." << endl;
+    benchmarkUnlogged(results, data, scale);
+    for (size_t commitBatch : commitBatches)
+      benchmarkCommitBatch(results, data, scale, commitBatch);
+    benchmarkRecovery(results, data, scale);
+  }
+
+  removeTree();
+  saveResultsToCSV(results, "../data/results/benchmark6_results.csv");
+  printResults(results);
+  return 0;
+}
@@ -0,0 +1,163 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "BenchUtils.h"
+#include "Hashes.h"
+
+using namespace std;
+using namespace std::chrono;
+
+struct BenchmarkResult {
+  string hash;
+  size_t dataSize;
+  double gbPerSecond; // hashing the keys alone
+  double nsPerKey;
+  double insertTime; // unordered_map, ms
+  double lookupTime;
+  size_t collisions; // keys whose full hash value another key has too
+  size_t buckets;
+  size_t maxBucket; // keys in the longest bucket
+  double emptyBuckets; // fraction of buckets without keys
+  // keys compared by a successful lookup on average: 1 + load factor / 2 for
+  // a uniform hash
+  double probes;
+};
+
+// bytes hashed per throughput measurement, in passes over the keys
+const size_t throughputBytes = 32 << 20;
+
+double elapsedMs(high_resolution_clock::time_point start) {
+  auto end = high_resolution_clock::now();
+  return duration_cast<nanoseconds>(end - start).count() / 1e6;
+}
+
+// The hashes under test: one line adds a hash to every measurement
+template <typename Visitor> void forEachHash(Visitor visit) {
+  visit(std::hash<string>(), "std::hash");
+  visit(CustomHashFNV1A(), "fnv1a");
+  visit(CustomHashMod(), "mod");
+  visit(WyHash(), "wyhash");
+  visit(Xxh3StyleHash(), "xxh3_style");
+  visit(Crc32cHash(), "crc32c");
+  visit(MultiplyMixHash(), "multiply_mix");
+}
+
+template <typename Hash>
+BenchmarkResult benchmark(const vector<string> &keys, const string &hashName) {
+  Hash hash;
+  BenchmarkResult result{hashName, keys.size()};
+
+  size_t bytes = 0;
+  for (const string &key : keys)
+    bytes += key.size();
+  size_t passes = max<size_t>(1, throughputBytes / bytes);
+  size_t sum = 0;
+  auto start = high_resolution_clock::now();
+  for (size_t pass = 0; pass < passes; ++pass) {
+    for (const string &key : keys)
+      sum += hash(key);
+  }
+  double time = elapsedMs(start);
+  volatile size_t checksum = sum;
+  (void)checksum;
+  result.gbPerSecond = bytes * passes / (time * 1e6);
+  result.nsPerKey = time * 1e6 / (keys.size() * passes);
+
+  vector<size_t> values;
+  values.reserve(keys.size());
+  for (const string &key : keys)
+    values.push_back(hash(key));
+  sort(values.begin(), values.end());
+  for (size_t i = 0; i < values.size(); ++i) {
+    bool shared = (i > 0 && values[i - 1] == values[i]) ||
+                  (i + 1 < values.size() && values[i + 1] == values[i]);
+    result.collisions += shared;
+  }
+
+  unordered_map<string, int, Hash> map;
+  start = high_resolution_clock::now();
+  for (size_t i = 0; i < keys.size(); ++i)
+    map.emplace(keys[i], (int)i);
+  result.insertTime = elapsedMs(start);
+  size_t found = 0;
+  start = high_resolution_clock::now();
+  for (const string &key : keys)
+    found += map.count(key);
+  result.lookupTime = elapsedMs(start);
+  volatile size_t foundKeys = found;
+  (void)foundKeys;
+
+  result.buckets = map.bucket_count();
+  size_t empty = 0, compared = 0;
+  for (size_t bucket = 0; bucket < map.bucket_count(); ++bucket) {
+    size_t length = map.bucket_size(bucket);
+    empty += length == 0;
+    result.maxBucket = max(result.maxBucket, length);
+    compared += length * (length + 1) / 2;
+  }
+  result.emptyBuckets = (double)empty / map.bucket_count();
+  result.probes = (double)compared / map.size();
+  return result;
+}
+
+void printResults(const vector<BenchmarkResult> &results) {
+  cout << "Hash,DataSize,GB/s,ns/key,InsertTime(ms),LookupTime(ms),"
+          "Collisions,Buckets,MaxBucket,EmptyBuckets,Probes"
+       << endl;
+  for (const auto &result : results) {
+    cout << result.hash << "," << result.dataSize << "," << result.gbPerSecond
+         << "," << result.nsPerKey << "," << result.insertTime << ","
+         << result.lookupTime << "," << result.collisions << ","
+         << result.buckets << "," << result.maxBucket << ","
+         << result.emptyBuckets << "," << result.probes << endl;
+  }
+}
+
+void saveResultsToCSV(const vector<BenchmarkResult> &results,
+                      const string &filename) {
+  ofstream file(filename);
+  file << "Hash,DataSize,GB/s,ns/key,InsertTime(ms),LookupTime(ms),"
+          "Collisions,Buckets,MaxBucket,EmptyBuckets,Probes\n";
+  for (const auto &result : results) {
+    file << result.hash << "," << result.dataSize << "," << result.gbPerSecond
+         << "," << result.nsPerKey << "," << result.insertTime << ","
+         << result.lookupTime << "," << result.collisions << ","
+         << result.buckets << "," << result.maxBucket << ","
+         << result.emptyBuckets << "," << result.probes << "\n";
+  }
+}
+
+int main() {
+  cout << "Reading data from file" << endl;
+  vector<pair<string, int>> data = readCSV("../data/data.csv");
+  cout << "Data read successfully" << endl;
+  vector<size_t> scales = {500, 20000, 500000, 10000000};
+  vector<BenchmarkResult> results;
+
+  for (size_t scale : scales) {
+    if (scale > data.size()) {
+      cerr << "Scale " << scale << " is larger than the available data size."
+           << endl;
+      continue;
+    }
+    cout << "Benchmarking with scale " << scale << "..." << endl;
+    vector<string> keys;
+    keys.reserve(scale);
+    for (size_t i = 0; i < scale; ++i)
+      keys.push_back(data[i].first);
+    forEachHash([&](auto hash, const string &name) {
+      results.push_back(benchmark<decltype(hash)>(keys, name));
+    });
+  }
+
+  saveResultsToCSV(results, "../data/results/benchmark7_results.csv");
+  printResults(results);
+  return 0;
+}
@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "BenchUtils.h"
+#include "BpTree.h"
+#include "StaticBpTree.h"
+
+using namespace std;
+using namespace std::chrono;
+
+struct BenchmarkResult {
+  string tree;
+  string key; // the key column
+  size_t fanout;
+  size_t leafBytes; // 0 for the B+Tree, whose nodes are vectors
+  size_t dataSize;
+  size_t height;
+  double insertTime;
+  double searchTime;
+  double rangeTime;
+  size_t rangeKeys; // keys returned by all range queries
+};
+
+const size_t rangeLength = 100; // keys per range query
+const size_t rangeQueries = 10000;
+
+double elapsedMs(high_resolution_clock::time_point start) {
+  auto end = high_resolution_clock::now();
+  return duration_cast<nanoseconds>(end - start).count() / 1e6;
+}
+
+// The keys of one column with their row numbers, in row order, in a random
+// order for the lookups, and sorted for the range bounds
+template <typename Key> struct Keys {
+  vector<pair<Key, int>> rows;
+  vector<Key> shuffled;
+  vector<Key> sorted;
+
+  Keys(vector<pair<Key, int>> rowKeys) : rows(move(rowKeys)) {
+    for (const auto &row : rows)
+      shuffled.push_back(row.first);
+    sorted = shuffled;
+    sort(sorted.begin(), sorted.end());
+    shuffle(shuffled.begin(), shuffled.end(), mt19937(8));
+  }
+};
+
+// The height of either tree
+template <typename K, typename V, typename P>
+size_t heightOf(const BpTree<K, V, P> &tree) {
+  return tree.stats().height;
+}
+
+template <typename K, typename V, size_t F>
+size_t heightOf(const StaticBpTree<K, V, F> &tree) {
+  return tree.height();
+}
+
+template <typename Tree, typename Key>
+BenchmarkResult benchmark(Tree &tree, const Keys<Key> &keys,
+                          BenchmarkResult result) {
+  size_t dataSize = keys.rows.size();
+  auto start = high_resolution_clock::now();
+  for (const auto &[key, row] : keys.rows)
+    tree.insert(key, row);
+  result.insertTime = elapsedMs(start);
+  result.height = heightOf(tree);
+
+  size_t sum = 0;
+  start = high_resolution_clock::now();
+  for (const Key &key : keys.shuffled)
+    sum += (size_t)*tree.search(key);
+  result.searchTime = elapsedMs(start);
+
+  mt19937 rng(result.fanout);
+  size_t starts = dataSize > rangeLength ? dataSize - rangeLength + 1 : 1;
+  size_t last = min(rangeLength, dataSize) - 1;
+  start = high_resolution_clock::now();
+  for (size_t i = 0; i < rangeQueries; ++i) {
+    size_t first = rng() % starts;
+    auto range = tree.rangeQuery(keys.sorted[first], keys.sorted[first + last]);
+    result.rangeKeys += range.size();
+    sum += (size_t)*range.front();
+  }
+  result.rangeTime = elapsedMs(start);
+  volatile size_t checksum = sum;
+  (void)checksum;
+  return result;
+}
+
+// Both trees at each of the fanouts
+template <size_t... Fanouts, typename Key>
+void sweep(vector<BenchmarkResult> &results, const Keys<Key> &keys,
+           const string &keyName) {
+  size_t dataSize = keys.rows.size();
+  auto run = [&](auto fanoutConstant) {
+    constexpr size_t fanout = decltype(fanoutConstant)::value;
+    {
+      StaticBpTree<Key, int, fanout> tree;
+      results.push_back(benchmark(
+          tree, keys,
+          {"StaticB+Tree", keyName, fanout,
+           StaticBpTree<Key, int, fanout>::leafBytes, dataSize}));
+    }
+    // fanout children and fanout indexes per leaf, like the static tree
+    BpTree<Key, int> tree(fanout, fanout);
+    results.push_back(
+        benchmark(tree, keys, {"B+Tree", keyName, fanout, 0, dataSize}));
+  };
+  (run(integral_constant<size_t, Fanouts>()), ...);
+}
+
+void printResults(const vector<BenchmarkResult> &results) {
+  cout << "Tree,Key,Fanout,LeafBytes,DataSize,Height,InsertTime(ms),"
+          "SearchTime(ms),RangeTime(ms),Insert(ns/op),Search(ns/op),"
+          "Range(ns/key)"
+       << endl;
+  for (const auto &result : results) {
+    cout << result.tree << "," << result.key << "," << result.fanout << ","
+         << result.leafBytes << "," << result.dataSize << "," << result.height
+         << "," << result.insertTime << "," << result.searchTime << ","
+         << result.rangeTime << ","
+         << result.insertTime * 1e6 / result.dataSize << ","
+         << result.searchTime * 1e6 / result.dataSize << ","
+         << result.rangeTime * 1e6 / result.rangeKeys << endl;
+  }
+}
+
+void saveResultsToCSV(const vector<BenchmarkResult> &results,
+                      const string &filename) {
+  ofstream file(filename);
+  file << "Tree,Key,Fanout,LeafBytes,DataSize,Height,InsertTime(ms),"
+          "SearchTime(ms),RangeTime(ms),Insert(ns/op),Search(ns/op),"
+          "Range(ns/key)\n";
+  for (const auto &result : results) {
+    file << result.tree << "," << result.key << "," << result.fanout << ","
+         << result.leafBytes << "," << result.dataSize << "," << result.height
+         << "," << result.insertTime << "," << result.searchTime << ","
+         << result.rangeTime << ","
+         << result.insertTime * 1e6 / result.dataSize << ","
+         << result.searchTime * 1e6 / result.dataSize << ","
+         << result.rangeTime * 1e6 / result.rangeKeys << "\n";
+  }
+}
+
+int main() {
+  cout << "Reading data from file" << endl;
+  Dataset dataset = loadDataset("../data/data.csv");
+  cout << "Data read successfully" << endl;
+  vector<size_t> scales = {500, 20000, 500000, 10000000};
+  vector<BenchmarkResult> results;
+
+  for (size_t scale : scales) {
+    if (scale > dataset.size()) {
+      cerr << "Scale " << scale << " is larger than the available data size."
+           << endl;
+      continue;
+    }
+    cout << "Benchmarking with scale " << scale << "..." << endl;
+    vector<pair<string, int>> names;
+    vector<pair<uint64_t, int>> ids;
+    for (size_t i = 0; i < scale; ++i) {
+      names.emplace_back(dataset.keys[i], (int)i);
+      ids.emplace_back(dataset.studentIds[i], (int)i);
+    }
+    sweep<8, 16, 32, 64, 128, 256, 512>(results, Keys<string>(move(names)),
+                                        "key");
+    sweep<8, 16, 32, 64, 128, 256, 512>(results, Keys<uint64_t>(move(ids)),
+                                        "studentID");
+  }
+
+  saveResultsToCSV(results, "../data/results/benchmark8_results.csv");
+  printResults(results);
+  return 0;
+}
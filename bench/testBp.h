@@ -1,10 +1,40 @@
 #ifndef PROJECT_DB_TEST_BPTREE_H
 #define PROJECT_DB_TEST_BPTREE_H
 
+#include "AllocationCounter.h"
+#include "BenchRunner.h"
 #include "BpTree.h"
+#include "Dataset.h"
+#include "DiskBpTree.h"
+#include "FlatHashMap.h"
+#include "Hashes.h"
+#include "LatencyHistogram.h"
+#include "NodeIndexes.h"
+#include "NodeSearch.h"
+#include "OlcBpTree.h"
+#include "PerfCounters.h"
+#include "StaticBpTree.h"
+#include "Workload.h"
+#include "WriteAheadLog.h"
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <map>
 #include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 class BpTreeTest {
 public:
@@ -15,6 +45,27 @@ public:
     testGetMinMax();
     testRangeQuery();
     testCountRange();
+    testIterators();
+    testOrderStatistics();
+    testBatches();
+    testNodePolicies();
+    testBoxedData();
+    testBulkLoad();
+    testNodeSearch();
+    testStringIndexes();
+    testOlcBpTree();
+    testStaticBpTree();
+    testDataset();
+    testDiskBpTree();
+    testWriteAheadLog();
+    testHashes();
+    testFlatHashMap();
+    testTreeStats();
+    testAllocationCounter();
+    testLatencyHistogram();
+    testWorkload();
+    testPerfCounters();
+    testBenchRunner();
     std::cout << "All tests passed!" << std::endl;
   }
 
@@ -58,7 +109,7 @@ private:
     for (int i = 1; i < 20; ++i) {
       assert(tree.insert(i, "d"));
     }
-    std::shared_ptr<std::string> dataIn5 = tree.search(5);
+    std::string *dataIn5 = tree.search(5);
     assert(dataIn5 != nullptr);
     // update the data
     *dataIn5 = "five";
@@ -101,6 +152,1214 @@ private:
     assert(tree.countRange(-1, std::nullopt) == 21);
     std::cout << "testCountRange passed!" << std::endl;
   }
+
+  static void testIterators() {
+    BpTree<int, int> tree(4);
+    assert(tree.begin() == tree.end());
+    std::map<int, int> reference;
+    std::mt19937 rng(13);
+    for (int i = 0; i < 3000; ++i) {
+      int key = (int)(rng() % 2000) - 1000;
+      if (rng() % 4 == 0) {
+        reference.erase(key);
+        tree.erase(key);
+      } else if (reference.emplace(key, i).second) {
+        tree.insert(key, i);
+      }
+    }
+
+    // both directions, and writes through the iterator
+    auto expected = reference.begin();
+    for (auto it = tree.begin(); it != tree.end(); ++it, ++expected) {
+      assert(it->first == expected->first && it.data() == expected->second);
+      it->second += 1;
+    }
+    assert(expected == reference.end());
+    auto backwards = reference.rbegin();
+    const auto &constTree = tree;
+    for (auto it = constTree.end(); it != constTree.begin(); ++backwards) {
+      --it;
+      auto [index, data] = *it;
+      assert(index == backwards->first && data == backwards->second + 1);
+    }
+    assert(backwards == reference.rend());
+
+    for (int key = -1001; key <= 1000; key += 7) {
+      auto lower = tree.lower_bound(key);
+      auto upper = constTree.upper_bound(key);
+      auto lowerRef = reference.lower_bound(key);
+      auto upperRef = reference.upper_bound(key);
+      assert((lower == tree.end()) == (lowerRef == reference.end()));
+      assert((upper == constTree.end()) == (upperRef == reference.end()));
+      if (lowerRef != reference.end())
+        assert(lower.index() == lowerRef->first);
+      if (upperRef != reference.end())
+        assert(upper.index() == upperRef->first);
+      BpTree<int, int>::const_iterator converted = lower;
+      assert(converted == constTree.lower_bound(key));
+    }
+
+    // visitRange and countRange against the map for every bound inclusion
+    for (int round = 0; round < 200; ++round) {
+      int lo = (int)(rng() % 2100) - 1050, hi = lo + (int)(rng() % 300);
+      bool left = rng() % 2, right = rng() % 2;
+      auto first = left ? reference.lower_bound(lo) : reference.upper_bound(lo);
+      auto last = right ? reference.upper_bound(hi) : reference.lower_bound(hi);
+      size_t count = first == reference.end() || first->first > hi
+                         ? 0
+                         : (size_t)std::distance(first, last);
+      assert(tree.countRange(lo, hi, left, right) == count);
+      size_t visited = tree.visitRange(
+          lo, hi,
+          [&first](const int &index, int &) {
+            assert(index == first->first);
+            ++first;
+          },
+          left, right);
+      assert(visited == count);
+    }
+    // a visitor returning false stops the scan
+    size_t stopped = tree.visitRange(std::nullopt, std::nullopt,
+                                     [](const int &index, int &) {
+                                       return index < 0;
+                                     });
+    assert(stopped == (size_t)std::distance(reference.begin(),
+                                            reference.lower_bound(0)) +
+                          1);
+    std::cout << "testIterators passed!" << std::endl;
+  }
+
+  // rank, select and counts after every kind of split, borrow and merge
+  template <typename Tree>
+  static void checkOrderStatistics(Tree &tree, std::map<int, int> &reference,
+                                   std::mt19937 &rng) {
+    for (int round = 0; round < 20000; ++round) {
+      int key = (int)(rng() % 3000);
+      if (rng() % 5 < 2) {
+        reference.erase(key);
+        tree.erase(key);
+      } else if (rng() % 2) {
+        reference.emplace(key, key);
+        tree.insert(key, key);
+      } else {
+        reference[key] = key;
+        tree[key] = key;
+      }
+      if (round % 1000 != 0)
+        continue;
+      assert(tree.size() == reference.size());
+      size_t i = 0;
+      for (auto &entry : reference) {
+        assert(tree.rank(entry.first) == i);
+        assert(tree.select(i).index() == entry.first);
+        ++i;
+      }
+      assert(tree.select(i) == tree.end());
+    }
+    for (int round = 0; round < 500; ++round) {
+      int lo = (int)(rng() % 3100) - 50, hi = lo + (int)(rng() % 1000) - 100;
+      bool left = rng() % 2, right = rng() % 2;
+      size_t count = 0;
+      for (auto &entry : reference) {
+        if ((left ? entry.first >= lo : entry.first > lo) &&
+            (right ? entry.first <= hi : entry.first < hi))
+          ++count;
+      }
+      assert(tree.countRange(lo, hi, left, right) == count);
+      assert(tree.countRange(std::nullopt, hi, left, right) ==
+             (size_t)std::distance(reference.begin(),
+                                   right ? reference.upper_bound(hi)
+                                         : reference.lower_bound(hi)));
+    }
+  }
+
+  static void testOrderStatistics() {
+    std::mt19937 rng(21);
+    for (size_t order : {3, 4, 7, 64}) {
+      BpTree<int, int> tree(order);
+      std::map<int, int> reference;
+      checkOrderStatistics(tree, reference, rng);
+    }
+    // bulk loaded trees start out with their counts
+    std::vector<std::pair<int, int>> sorted;
+    std::map<int, int> reference;
+    for (int i = 0; i < 3000; i += 2) {
+      sorted.emplace_back(i, i);
+      reference.emplace(i, i);
+    }
+    BpTree<int, int, HeapNodes> loaded(sorted.begin(), sorted.end(), 5, 0.6);
+    assert(loaded.size() == 1500 && loaded.rank(1001) == 501);
+    checkOrderStatistics(loaded, reference, rng);
+
+    // nearest-rank percentiles of 1..100
+    BpTree<int, int> percentiles(4);
+    assert(percentiles.percentile(0.5) == percentiles.end());
+    for (int i = 100; i >= 1; --i)
+      percentiles.insert(i, -i);
+    assert(percentiles.percentile(0.0).index() == 1);
+    assert(percentiles.percentile(0.5).index() == 50);
+    assert(percentiles.percentile(0.955).index() == 96);
+    assert(percentiles.percentile(1.0).index() == 100);
+    std::cout << "testOrderStatistics passed!" << std::endl;
+  }
+
+  // batches with duplicates and indexes that are already there or missing,
+  // order 0 for the default node size
+  template <typename Index> static void checkBatches(size_t order) {
+    BpTree<Index, int> tree =
+        order ? BpTree<Index, int>(order) : BpTree<Index, int>();
+    std::map<Index, int> reference;
+    std::mt19937 rng(5);
+    auto randomIndex = [&rng]() {
+      if constexpr (std::is_same_v<Index, std::string>)
+        return "key" + std::to_string(rng() % 5000);
+      else
+        return (Index)(rng() % 5000);
+    };
+    for (int round = 0; round < 60; ++round) {
+      std::vector<std::pair<Index, int>> pairs;
+      size_t inserted = 0;
+      for (int i = 0; i < 200; ++i) {
+        pairs.emplace_back(randomIndex(), round * 1000 + i);
+        inserted += reference.emplace(pairs.back()).second;
+      }
+      assert(tree.insertBatch(pairs.begin(), pairs.end()) == inserted);
+
+      std::vector<Index> indexes;
+      size_t erased = 0;
+      for (int i = 0; i < 150; ++i) {
+        indexes.emplace_back(randomIndex());
+        erased += reference.erase(indexes.back());
+      }
+      assert(tree.eraseBatch(indexes.begin(), indexes.end()) == erased);
+      assert(tree.size() == reference.size());
+
+      std::vector<int *> found;
+      tree.searchBatch(indexes.begin(), indexes.end(),
+                       std::back_inserter(found));
+      for (int i = 0; i < 200; ++i)
+        indexes.emplace_back(pairs[(size_t)i].first);
+      tree.searchBatch(indexes.begin() + 150, indexes.end(),
+                       std::back_inserter(found));
+      assert(found.size() == indexes.size());
+      for (size_t i = 0; i < indexes.size(); ++i) {
+        auto it = reference.find(indexes[i]);
+        assert((found[i] != nullptr) == (it != reference.end()));
+        assert(!found[i] || *found[i] == it->second);
+      }
+    }
+    auto expected = reference.begin();
+    for (auto it = tree.begin(); it != tree.end(); ++it, ++expected)
+      assert(it.index() == expected->first && it.data() == expected->second);
+  }
+
+  static void testBatches() {
+    checkBatches<int>(3);
+    checkBatches<int>(5);
+    checkBatches<uint64_t>(0);
+    checkBatches<std::string>(4);
+    std::cout << "testBatches passed!" << std::endl;
+  }
+
+  // random inserts and erases checked against std::map, so that recycled
+  // nodes from merges are reused by later splits
+  template <typename Tree> static void checkAgainstMap(Tree &tree) {
+    std::map<int, int> reference;
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> keys(0, 2000);
+    for (int round = 0; round < 20000; ++round) {
+      int key = keys(rng);
+      if (rng() % 3 == 0) {
+        bool erased = reference.erase(key) == 1;
+        assert(tree.erase(key) == erased);
+      } else {
+        bool inserted = reference.emplace(key, key * 2).second;
+        assert(tree.insert(key, key * 2) == inserted);
+      }
+    }
+    for (int key = 0; key <= 2000; ++key) {
+      auto data = tree.search(key);
+      assert((data != nullptr) == (reference.count(key) == 1));
+      if (data)
+        assert(*data == key * 2);
+    }
+    assert(tree.countRange(std::nullopt, std::nullopt) == reference.size());
+  }
+
+  static void testNodePolicies() {
+    BpTree<int, int> pooled(4);
+    checkAgainstMap(pooled);
+    BpTree<int, int, HeapNodes> heap(4);
+    checkAgainstMap(heap);
+    // moving the tree hands over its nodes
+    BpTree<int, int> moved(std::move(pooled));
+    assert(moved.countRange(std::nullopt, std::nullopt) > 0);
+    // and leaves it empty but usable, by construction and by assignment
+    assert(pooled.size() == 0 && pooled.begin() == pooled.end());
+    assert(pooled.search(1) == nullptr);
+    assert(pooled.insert(1, 10) && *pooled.search(1) == 10);
+    size_t heapSize = heap.size();
+    BpTree<int, int, HeapNodes> assigned(4);
+    assigned.insert(-7, 70);
+    assigned = std::move(heap);
+    assert(assigned.search(-7) == nullptr && assigned.size() == heapSize);
+    assert(heap.size() == 0);
+    for (int i = 0; i < 100; ++i)
+      assert(heap.insert(i, i));
+    assert(heap.size() == 100 && *heap.search(42) == 42);
+    moved = std::move(pooled);
+    assert(moved.size() == 1 && pooled.size() == 0);
+    std::cout << "testNodePolicies passed!" << std::endl;
+  }
+
+  static void testBoxedData() {
+    // too large to be stored inline, so the leaves keep pointers to it
+    using Record = std::array<int, 32>;
+    BpTree<int, Record> tree(3);
+    Record &first = tree[0];
+    first.fill(7);
+    for (int i = 1; i < 50; ++i) {
+      tree[i].fill(i);
+    }
+    // boxed data does not move when the leaves split
+    assert(&first == tree.search(0));
+    assert((*tree.search(0))[31] == 7);
+    auto result = tree.rangeQuery(10, 12);
+    assert(result.size() == 3 && (*result[2])[0] == 12);
+    std::cout << "testBoxedData passed!" << std::endl;
+  }
+
+  static void testBulkLoad() {
+    std::vector<std::pair<int, int>> sorted;
+    for (int i = 0; i < 1000; ++i) {
+      sorted.emplace_back(i * 2, i);
+    }
+    BpTree<int, int> tree(sorted.begin(), sorted.end(), 5, 0.7);
+    assert(tree.countRange(std::nullopt, std::nullopt) == 1000);
+    assert(tree.getMin() == 0 && tree.getMax() == 1998);
+    for (int i = 0; i < 1000; ++i) {
+      assert(*tree.search(i * 2) == i);
+      assert(tree.search(i * 2 + 1) == nullptr);
+    }
+    // the loaded tree keeps working for updates
+    for (int i = 0; i < 1000; ++i) {
+      assert(tree.insert(i * 2 + 1, -i));
+    }
+    for (int i = 0; i < 2000; i += 3) {
+      assert(tree.erase(i));
+    }
+    assert(tree.countRange(std::nullopt, std::nullopt) == 2000 - 667);
+
+    // a low fill factor still leaves every node but the root half full
+    for (size_t size : {3, 9, 17, 100, 1000}) {
+      BpTree<int, int> sparse(sorted.begin(), sorted.begin() + (long)size, 17,
+                              0.1);
+      auto stats = sparse.stats();
+      for (size_t level = 1; level < stats.height; ++level) {
+        const auto &occupancy = stats.levels[level];
+        assert(2 * occupancy.indexes >= occupancy.capacity);
+      }
+      assert(sparse.size() == size);
+    }
+
+    // unsorted input with a duplicate, the first pair wins
+    std::vector<std::pair<int, int>> unsorted(sorted.rbegin(), sorted.rend());
+    unsorted.emplace_back(10, -1);
+    BpTree<int, int> other(3);
+    other.bulkLoadUnsorted(unsorted.begin(), unsorted.end(), 4);
+    assert(other.countRange(std::nullopt, std::nullopt) == 1000);
+    assert(*other.search(10) == 5);
+    for (int i = 0; i < 2000; i += 2) {
+      assert(other.erase(i));
+    }
+    assert(other.countRange(std::nullopt, std::nullopt) == 0);
+
+    // large enough to be sorted by several threads
+    std::vector<int> values(100000);
+    for (size_t i = 0; i < values.size(); ++i) {
+      values[i] = (int)((i * 7919) % values.size());
+    }
+    parallelSort(values.begin(), values.end(), std::less<int>(), 4);
+    assert(std::is_sorted(values.begin(), values.end()));
+    std::cout << "testBulkLoad passed!" << std::endl;
+  }
+
+  // the SIMD search against std::lower_bound/upper_bound, with duplicates,
+  // negative values and sizes around the vector width and the linear window
+  template <typename Key> static void checkNodeSearch() {
+    std::mt19937_64 rng(3);
+    for (size_t size : {0, 1, 3, 7, 8, 9, 16, 17, 31, 64, 100, 257, 1000}) {
+      std::vector<Key> keys(size);
+      for (auto &key : keys)
+        key = (Key)(rng() % 64) - (std::is_signed_v<Key> ? 32 : 0);
+      std::sort(keys.begin(), keys.end());
+      for (int probe = -40; probe < 70; ++probe) {
+        Key key = (Key)probe;
+        auto lower = std::lower_bound(keys.begin(), keys.end(), key);
+        auto upper = std::upper_bound(keys.begin(), keys.end(), key);
+        assert(NodeSearch<Key>::lowerBound(keys.data(), size, key) ==
+               (size_t)(lower - keys.begin()));
+        assert(NodeSearch<Key>::upperBound(keys.data(), size, key) ==
+               (size_t)(upper - keys.begin()));
+      }
+    }
+  }
+
+  static void testNodeSearch() {
+    checkNodeSearch<int16_t>();
+    checkNodeSearch<int32_t>();
+    checkNodeSearch<uint32_t>();
+    checkNodeSearch<int64_t>();
+    checkNodeSearch<uint64_t>();
+    // unsigned keys with the top bit set still sort above the small ones
+    std::vector<uint32_t> keys = {1, 2, 3, 0x80000000u, 0x80000001u,
+                                  0xfffffff0u, 0xffffffffu, 0xffffffffu};
+    assert(NodeSearch<uint32_t>::lowerBound(keys.data(), 8, 0x80000001u) == 4);
+    assert(NodeSearch<uint32_t>::upperBound(keys.data(), 8, 0xffffffffu) == 8);
+    assert(NodeSearch<uint32_t>::lowerBound(keys.data(), 8, 0xffffffffu) == 6);
+    std::cout << "testNodeSearch passed!" << std::endl;
+  }
+
+  // strings with long shared prefixes, ties in the normalized prefix, zero
+  // bytes and bytes above 0x7f
+  static std::string randomString(std::mt19937 &rng) {
+    static const char alphabet[] = {'a', 'b', '\0', '\xff'};
+    std::string key = rng() % 2 ? "shared/prefix/" : "";
+    for (size_t length = rng() % 12; length > 0; --length)
+      key += alphabet[rng() % 4];
+    return key;
+  }
+
+  static void testStringIndexes() {
+    std::mt19937 rng(11);
+    NodeIndexes<std::string> indexes;
+    std::vector<std::string> reference;
+    for (int round = 0; round < 5000; ++round) {
+      std::string key = randomString(rng);
+      size_t pos = (size_t)(std::lower_bound(reference.begin(),
+                                             reference.end(), key) -
+                            reference.begin());
+      switch (rng() % 7) {
+      case 0:
+        if (!reference.empty()) {
+          pos = rng() % reference.size();
+          reference.erase(reference.begin() + (long)pos);
+          indexes.erase(indexes.begin() + (long)pos);
+        }
+        break;
+      case 1:
+        // replace an index with one that keeps the order
+        if (!reference.empty()) {
+          pos = std::min(pos, reference.size() - 1);
+          if ((pos + 1 == reference.size() || key < reference[pos + 1]) &&
+              (pos == 0 || reference[pos - 1] < key)) {
+            reference[pos] = key;
+            indexes.set(pos, key);
+          }
+        }
+        break;
+      case 2:
+        if (reference.size() > 8) {
+          reference.resize(reference.size() / 2);
+          indexes.resize(reference.size());
+        }
+        break;
+      default:
+        reference.insert(reference.begin() + (long)pos, key);
+        indexes.insert(indexes.begin() + (long)pos, key);
+      }
+      assert(std::equal(reference.begin(), reference.end(), indexes.begin(),
+                        indexes.end()));
+      for (int probe = 0; probe < 4; ++probe) {
+        std::string key = randomString(rng);
+        assert(indexes.lowerBound(key) ==
+               (size_t)(std::lower_bound(reference.begin(), reference.end(),
+                                         key) -
+                        reference.begin()));
+        assert(indexes.upperBound(key) ==
+               (size_t)(std::upper_bound(reference.begin(), reference.end(),
+                                         key) -
+                        reference.begin()));
+      }
+    }
+
+    // the tree on top of them, small nodes to split, borrow and merge often
+    BpTree<std::string, int> tree(4);
+    std::map<std::string, int> map;
+    for (int round = 0; round < 20000; ++round) {
+      std::string key = randomString(rng);
+      if (rng() % 3 == 0)
+        assert(tree.erase(key) == (map.erase(key) == 1));
+      else
+        assert(tree.insert(key, round) == map.emplace(key, round).second);
+    }
+    for (const auto &entry : map) {
+      int *data = tree.search(entry.first);
+      assert(data && *data == entry.second);
+    }
+    auto all = tree.rangeQuery(std::nullopt, std::nullopt);
+    assert(all.size() == map.size());
+    auto it = map.begin();
+    for (size_t i = 0; i < all.size(); ++i, ++it)
+      assert(*all[i] == it->second);
+    std::cout << "testStringIndexes passed!" << std::endl;
+  }
+
+  static void testOlcBpTree() {
+    // single-threaded against std::map, with a small fanout to split often
+    OlcBpTree<std::string, int, 4> tree;
+    std::map<std::string, int> reference;
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> keys(0, 2000);
+    for (int round = 0; round < 20000; ++round) {
+      std::string key = std::to_string(keys(rng));
+      if (rng() % 3 == 0) {
+        assert(tree.erase(key) == (reference.erase(key) == 1));
+      } else {
+        bool inserted = reference.emplace(key, round).second;
+        assert(tree.insert(key, round) == inserted);
+      }
+    }
+    int data = 0;
+    for (const auto &entry : reference) {
+      assert(tree.search(entry.first, data) && data == entry.second);
+    }
+    assert(!tree.search("absent", data));
+    assert(tree.rangeQuery(std::nullopt, std::nullopt).size() ==
+           reference.size());
+    auto range = tree.rangeQuery(std::string("1"), std::string("2"), true,
+                                 false);
+    auto first = reference.lower_bound("1"), last = reference.lower_bound("2");
+    assert(range.size() == (size_t)std::distance(first, last));
+    assert(range.empty() || range.front() == first->second);
+    assert(!tree.insertOrAssign(first->first, -1));
+    assert(tree.modify(first->first, [](int &value) { value -= 1; }));
+    assert(tree.search(first->first, data) && data == -2);
+
+    // writers insert and erase disjoint keys while readers check the data
+    OlcBpTree<int, int, 8> shared;
+    const int threads = 4, perThread = 20000;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+      workers.emplace_back([&shared, t]() {
+        for (int i = t; i < threads * perThread; i += threads)
+          assert(shared.insert(i, i * 2));
+        for (int i = t; i < threads * perThread; i += threads * 2)
+          assert(shared.erase(i));
+      });
+      workers.emplace_back([&shared, t]() {
+        std::mt19937 readerRng(t);
+        int value = 0;
+        for (int i = 0; i < perThread; ++i) {
+          int key = (int)(readerRng() % (threads * perThread));
+          if (shared.search(key, value))
+            assert(value == key * 2);
+        }
+      });
+    }
+    for (auto &worker : workers)
+      worker.join();
+    auto all = shared.rangeQuery(std::nullopt, std::nullopt);
+    assert(all.size() == (size_t)(threads * perThread / 2));
+    for (size_t i = 0; i < all.size(); ++i) {
+      // the odd multiples of threads were erased
+      int key = (int)(i / threads * threads * 2 + threads + i % threads);
+      assert(all[i] == key * 2);
+    }
+    std::cout << "testOlcBpTree passed!" << std::endl;
+  }
+
+  // Random inserts, erases and range queries against a std::map
+  template <typename Tree, typename Index, typename MakeIndex>
+  static void checkStaticBpTree(MakeIndex makeIndex) {
+    Tree tree;
+    std::map<Index, int> expected;
+    std::mt19937 rng(24);
+    for (int i = 0; i < 20000; ++i) {
+      Index index = makeIndex(rng() % 5000);
+      if (rng() % 3 == 0) {
+        assert(tree.erase(index) == (expected.erase(index) == 1));
+      } else {
+        bool inserted = expected.emplace(index, i).second;
+        assert(tree.insert(index, i) == inserted);
+      }
+    }
+    assert(tree.size() == expected.size() && tree.height() > 2);
+    for (int i = 0; i < 5000; ++i) {
+      Index index = makeIndex(i);
+      auto it = expected.find(index);
+      const int *data = tree.search(index);
+      assert(it == expected.end() ? data == nullptr : *data == it->second);
+    }
+    for (int i = 0; i < 200; ++i) {
+      Index low = makeIndex(rng() % 5000), high = makeIndex(rng() % 5000);
+      if (high < low)
+        std::swap(low, high);
+      bool leftInclusive = rng() % 2, rightInclusive = rng() % 2;
+      // (low, low) would start past its end in the map
+      leftInclusive |= !(low < high);
+      auto first = leftInclusive ? expected.lower_bound(low)
+                                 : expected.upper_bound(low);
+      auto last = rightInclusive ? expected.upper_bound(high)
+                                 : expected.lower_bound(high);
+      auto range = tree.rangeQuery(low, high, leftInclusive, rightInclusive);
+      size_t pos = 0;
+      for (; first != last; ++first, ++pos)
+        assert(pos < range.size() && *range[pos] == first->second);
+      assert(pos == range.size());
+    }
+    assert(tree.rangeQuery(std::nullopt, std::nullopt).size() ==
+           expected.size());
+
+    tree[makeIndex(7000)] = 5;
+    assert(tree[makeIndex(7000)] == 5 && tree.size() == expected.size() + 1);
+  }
+
+  static void testStaticBpTree() {
+    auto number = [](int i) { return i; };
+    auto text = [](int i) { return "key" + std::to_string(i); };
+    checkStaticBpTree<StaticBpTree<int, int, 4>, int>(number);
+    checkStaticBpTree<StaticBpTree<int, int, 7>, int>(number);
+    checkStaticBpTree<StaticBpTree<int, int, 64>, int>(number);
+    checkStaticBpTree<StaticBpTree<std::string, int, 5>, std::string>(text);
+    checkStaticBpTree<StaticBpTree<std::string, int, 32>, std::string>(text);
+    static_assert(StaticBpTree<int, int, 16>::leafBytes % 64 == 0);
+    std::cout << "testStaticBpTree passed!" << std::endl;
+  }
+
+  // small pages, so that there are a few levels of them
+  using DiskTree = DiskBpTree<FixedKey<16>, int, 256>;
+
+  static void checkDiskTree(DiskTree &tree,
+                            const std::map<std::string, int> &reference) {
+    assert(tree.isOpen() && tree.size() == reference.size());
+    for (const auto &[key, value] : reference)
+      assert(tree.search(key) && *tree.search(key) == value);
+    auto expected = reference.begin();
+    size_t visited = tree.visitRange(
+        std::nullopt, std::nullopt, [&](const FixedKey<16> &index, int &data) {
+          assert(index.view() == expected->first && data == expected->second);
+          ++expected;
+        });
+    assert(visited == reference.size());
+  }
+
+  static void testDiskBpTree() {
+    const char *filename = "testDiskBpTree.db";
+    std::remove(filename);
+    std::map<std::string, int> reference;
+    std::mt19937 rng(17);
+    {
+      DiskTree tree(filename);
+      for (int i = 0; i < 20000; ++i) {
+        std::string key = "key" + std::to_string(rng() % 5000);
+        if (rng() % 3 == 0) {
+          assert(tree.erase(key) == (reference.erase(key) == 1));
+        } else {
+          bool inserted = reference.emplace(key, i).second;
+          assert(tree.insert(key, i) == inserted);
+        }
+        assert(!tree.search("missing"));
+      }
+      checkDiskTree(tree, reference);
+      size_t count = tree.visitRange(FixedKey<16>("key2"),
+                                     FixedKey<16>("key3"),
+                                     [](const FixedKey<16> &, int &) {});
+      assert(count == (size_t)std::distance(reference.lower_bound("key2"),
+                                            reference.upper_bound("key3")));
+      *tree.search(reference.begin()->first) = -1;
+      reference.begin()->second = -1;
+      assert(tree.sync());
+    }
+    {
+      // reopened as it was written, and still updatable
+      DiskTree tree(filename);
+      checkDiskTree(tree, reference);
+      assert(tree.insert("zzz", 7));
+      reference.emplace("zzz", 7);
+      // a file of other types or pages is refused
+      assert(!(DiskBpTree<FixedKey<8>, int, 256>(filename).isOpen()));
+      assert(!(DiskBpTree<FixedKey<16>, int, 512>(filename).isOpen()));
+    }
+    {
+      DiskTree tree(filename);
+      checkDiskTree(tree, reference);
+      // bulk load over the old content
+      std::vector<std::pair<FixedKey<16>, int>> sorted;
+      std::map<std::string, int> loaded;
+      for (int i = 0; i < 3000; ++i) {
+        std::string key = "bulk" + std::to_string(100000 + i);
+        sorted.emplace_back(key, i);
+        loaded.emplace(key, i);
+      }
+      sorted.emplace_back(sorted.back());
+      assert(tree.bulkLoad(sorted.begin(), sorted.end()));
+      checkDiskTree(tree, loaded);
+      assert(tree.insert("bulk099999", -5) && tree.erase("bulk100001"));
+      loaded.emplace("bulk099999", -5);
+      loaded.erase("bulk100001");
+      checkDiskTree(tree, loaded);
+    }
+    std::remove(filename);
+    std::cout << "testDiskBpTree passed!" << std::endl;
+  }
+
+  using LoggedTree = LoggedBpTree<std::string, int>;
+
+  static void checkLoggedTree(const LoggedTree &tree,
+                              const std::map<std::string, int> &reference) {
+    assert(tree.isOpen() && tree.view().size() == reference.size());
+    auto expected = reference.begin();
+    for (auto [index, data] : tree.view()) {
+      assert(index == expected->first && data == expected->second);
+      ++expected;
+    }
+  }
+
+  static std::string readFile(const std::string &filename) {
+    std::ifstream file(filename, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), {});
+  }
+
+  static void writeFile(const std::string &filename,
+                        const std::string &content) {
+    std::ofstream(filename, std::ios::binary | std::ios::trunc) << content;
+  }
+
+  static void testWriteAheadLog() {
+    const std::string directory = "testWriteAheadLog";
+    const std::string wal = directory + "/wal";
+    const std::string checkpoint = directory + "/checkpoint";
+    std::remove(wal.c_str());
+    std::remove(checkpoint.c_str());
+    std::map<std::string, int> reference;
+    std::mt19937 rng(23);
+    auto update = [&](LoggedTree &tree, int i) {
+      std::string key = "key" + std::to_string(rng() % 2000);
+      if (rng() % 4 == 0) {
+        assert(tree.erase(key) == (reference.erase(key) == 1));
+      } else if (rng() % 2 == 0) {
+        assert(tree.assign(key, i));
+        reference[key] = i;
+      } else {
+        bool inserted = reference.emplace(key, i).second;
+        assert(tree.insert(key, i) == inserted);
+      }
+    };
+    {
+      // only the log, committed in groups and when closed
+      LoggedTree tree(directory, {8, 1 << 30});
+      for (int i = 0; i < 5000; ++i)
+        update(tree, i);
+      assert(tree.writeAheadLog().syncCount() > 0);
+      checkLoggedTree(tree, reference);
+    }
+    {
+      // replayed, then a torn record at the end is dropped
+      LoggedTree tree(directory, {8, 1 << 30});
+      checkLoggedTree(tree, reference);
+    }
+    std::string log = readFile(wal);
+    writeFile(wal, log + log.substr(0, 30));
+    {
+      LoggedTree tree(directory, {8, 1 << 30});
+      checkLoggedTree(tree, reference);
+      assert(readFile(wal) == log);
+      // a record with a bad checksum ends the log too
+      assert(tree.insert("zzz", 1));
+    }
+    std::string corrupt = readFile(wal);
+    corrupt[corrupt.size() - 1] ^= 1;
+    writeFile(wal, corrupt);
+    {
+      LoggedTree tree(directory, {8, 1 << 30});
+      checkLoggedTree(tree, reference);
+      assert(tree.checkpoint() && readFile(wal).empty());
+      for (int i = 0; i < 1000; ++i)
+        update(tree, i);
+    }
+    {
+      // checkpoints taken as the log grows, with updates after the last one
+      LoggedTree tree(directory, {4, 20000});
+      checkLoggedTree(tree, reference);
+      for (int i = 0; i < 5000; ++i)
+        update(tree, i);
+      assert(tree.writeAheadLog().size() < 20000);
+      checkLoggedTree(tree, reference);
+    }
+    {
+      LoggedTree tree(directory, {4, 20000});
+      checkLoggedTree(tree, reference);
+      // a checkpoint whose log was not cleared: the records in it are skipped
+      assert(tree.assign("key0", -1) && tree.erase("key0"));
+      assert(tree.insert("key0", -2) && tree.commit());
+      reference["key0"] = -2;
+      log = readFile(wal);
+      assert(tree.checkpoint());
+    }
+    writeFile(wal, log);
+    {
+      LoggedTree tree(directory);
+      checkLoggedTree(tree, reference);
+    }
+    // a damaged checkpoint is refused
+    std::string snapshot = readFile(checkpoint);
+    snapshot[snapshot.size() / 2] ^= 1;
+    writeFile(checkpoint, snapshot);
+    assert(!LoggedTree(directory).isOpen());
+    std::remove(wal.c_str());
+    std::remove(checkpoint.c_str());
+    std::remove(directory.c_str());
+    std::cout << "testWriteAheadLog passed!" << std::endl;
+  }
+
+  static void testHashes() {
+    // the CRC32C check value, in hardware and software
+    assert(crc32c("123456789", 9) == 0xe3069283);
+    assert(~crc32cSoftware("123456789", 9) == 0xe3069283);
+    std::string text;
+    for (int i = 0; i < 300; ++i)
+      text += (char)('a' + i * 7 % 26);
+    // every length takes its own path through the short-key cases, and any
+    // byte change shows
+    for (size_t len = 0; len <= text.size(); ++len) {
+      std::string key = text.substr(0, len);
+      assert(crc32c(key.data(), len) == ~crc32cSoftware(key.data(), len));
+      std::array<uint64_t, 4> values = {
+          wyhash(key.data(), len), xxh3Style(key.data(), len),
+          crc32c(key.data(), len), multiplyMix(key.data(), len)};
+      assert(values[0] == WyHash()(key) && values[1] == Xxh3StyleHash()(key));
+      assert(values[3] == MultiplyMixHash()(key));
+      for (size_t i = 0; i < len; i += 1 + len / 8) {
+        std::string changed = key;
+        changed[i] ^= 1;
+        assert(wyhash(changed.data(), len) != values[0]);
+        assert(xxh3Style(changed.data(), len) != values[1]);
+        assert(crc32c(changed.data(), len) != values[2]);
+        assert(multiplyMix(changed.data(), len) != values[3]);
+      }
+      // the seed changes the value too
+      assert(wyhash(key.data(), len, 1) != values[0]);
+      assert(xxh3Style(key.data(), len, 1) != values[1]);
+      assert(multiplyMix(key.data(), len, 1) != values[3]);
+    }
+    // keys that only differ by trailing zero bytes
+    std::string zeros(16, '\0');
+    for (size_t len = 1; len <= zeros.size(); ++len) {
+      assert(wyhash(zeros.data(), len) != wyhash(zeros.data(), len - 1));
+      assert(xxh3Style(zeros.data(), len) != xxh3Style(zeros.data(), len - 1));
+      assert(multiplyMix(zeros.data(), len) !=
+             multiplyMix(zeros.data(), len - 1));
+    }
+    std::cout << "testHashes passed!" << std::endl;
+  }
+
+  // every key in one probe sequence
+  struct ConstantHash {
+    size_t operator()(const std::string &) const { return 42; }
+  };
+
+  template <typename Map, typename Key>
+  static void checkFlatHashMap(Map &map, const std::map<Key, int> &reference) {
+    assert(map.size() == reference.size());
+    assert(map.load_factor() <= 0.875);
+    for (const auto &[key, value] : reference)
+      assert(map.find(key) != map.end() && map.find(key)->second == value);
+    size_t visited = 0;
+    for (const auto &[key, value] : map) {
+      assert(reference.at(key) == value);
+      ++visited;
+    }
+    assert(visited == reference.size());
+  }
+
+  template <typename Map, typename Key, typename MakeKey>
+  static void checkFlatHashMapChurn(size_t keys, MakeKey makeKey) {
+    Map map;
+    std::map<Key, int> reference;
+    std::mt19937 rng(19);
+    assert(map.find(makeKey(0)) == map.end() && !map.erase(makeKey(0)));
+    for (int i = 0; i < 30000; ++i) {
+      Key key = makeKey(rng() % keys);
+      switch (rng() % 4) {
+      case 0:
+        assert(map.erase(key) == reference.erase(key));
+        break;
+      case 1:
+        map[key] = i;
+        reference[key] = i;
+        break;
+      case 2: {
+        bool inserted = reference.emplace(key, i).second;
+        assert(map.insert({key, i}).second == inserted);
+        break;
+      }
+      default:
+        assert(map.count(key) == reference.count(key));
+      }
+    }
+    checkFlatHashMap(map, reference);
+    // erase everything, then fill again: tombstones are reused or dropped
+    for (const auto &[key, value] : reference)
+      assert(map.erase(key) == 1);
+    assert(map.empty() && map.begin() == map.end());
+    reference.clear();
+    for (size_t i = 0; i < keys; ++i) {
+      map[makeKey(i)] = (int)i;
+      reference[makeKey(i)] = (int)i;
+    }
+    checkFlatHashMap(map, reference);
+    Map moved = std::move(map);
+    checkFlatHashMap(moved, reference);
+    moved.clear();
+    assert(moved.empty() && moved.find(makeKey(1)) == moved.end());
+    moved.reserve(1000);
+    size_t buckets = moved.bucket_count();
+    for (size_t i = 0; i < 1000; ++i)
+      moved[makeKey(i)] = 1;
+    assert(moved.bucket_count() == buckets);
+  }
+
+  static void testFlatHashMap() {
+    auto stringKey = [](size_t i) { return "key" + std::to_string(i); };
+    auto integerKey = [](size_t i) { return (uint64_t)i * 1000; };
+    checkFlatHashMapChurn<FlatHashMap<std::string, int>, std::string>(
+        5000, stringKey);
+    checkFlatHashMapChurn<FlatHashMap<uint64_t, int>, uint64_t>(20000,
+                                                                integerKey);
+    // a handful of keys in a small table, and a hash that puts every key on
+    // the same probe sequence
+    checkFlatHashMapChurn<FlatHashMap<std::string, int>, std::string>(
+        10, stringKey);
+    checkFlatHashMapChurn<FlatHashMap<std::string, int, ConstantHash>,
+                          std::string>(300, stringKey);
+    std::cout << "testFlatHashMap passed!" << std::endl;
+  }
+
+  static void testTreeStats() {
+    BpTree<int, int> empty(5);
+    auto stats = empty.stats();
+    assert(stats.height == 1 && stats.nodes == 1 && stats.entries == 0);
+    assert(stats.fillFactor == 0.0);
+
+    // full leaves of 4 indexes, internal nodes of 5 children
+    std::vector<std::pair<int, int>> sorted;
+    for (int i = 0; i < 1000; ++i)
+      sorted.emplace_back(i, i);
+    BpTree<int, int> loaded(sorted.begin(), sorted.end(), 5);
+    stats = loaded.stats();
+    assert(stats.entries == 1000 && stats.leaves == 250);
+    assert(stats.fillFactor == 1.0 && stats.levels.front().nodes == 1);
+    assert(stats.height == stats.levels.size() && stats.height == 5);
+
+    BpTree<int, int> tree(5);
+    std::mt19937 rng(5);
+    for (int i = 0; i < 5000; ++i)
+      tree.insert((int)(rng() % 100000), i);
+    stats = tree.stats();
+    size_t nodes = 0;
+    for (size_t level = 0; level < stats.height; ++level) {
+      const auto &occupancy = stats.levels[level];
+      nodes += occupancy.nodes;
+      assert(occupancy.indexes <= occupancy.capacity);
+      // every node but the root is at least half full
+      if (level > 0)
+        assert(2 * occupancy.indexes >= occupancy.capacity);
+      if (level + 1 < stats.height)
+        assert(stats.levels[level + 1].indexes >= occupancy.indexes);
+    }
+    assert(nodes == stats.nodes && stats.entries == tree.size());
+    assert(stats.fillFactor >= 0.5 && stats.fillFactor <= 1.0);
+    std::cout << "testTreeStats passed!" << std::endl;
+  }
+
+  static void testAllocationCounter() {
+    AllocationCounter counter;
+    {
+      std::vector<int> numbers(1000);
+      auto stats = counter.stats();
+      assert(stats.allocations >= 1 && stats.liveBytes >= 4000);
+      // the grown buffer is live together with the old one while copying
+      numbers.resize(4000);
+      assert(counter.stats().allocations == stats.allocations + 1);
+      assert(counter.stats().liveBytes >= 16000);
+    }
+    auto stats = counter.stats();
+    assert(stats.liveBytes == 0 && stats.peakBytes >= 20000);
+    assert(stats.allocatedBytes >= 20000);
+    std::cout << "testAllocationCounter passed!" << std::endl;
+  }
+
+  // the bucket bound the median of value falls in, the maximum kept above it
+  static uint64_t bucketBound(uint64_t value) {
+    LatencyHistogram histogram;
+    histogram.record(value);
+    histogram.record(UINT64_MAX);
+    return histogram.percentile(50);
+  }
+
+  static void testLatencyHistogram() {
+    LatencyHistogram empty;
+    assert(empty.count() == 0 && empty.percentile(50) == 0);
+    LatencyHistogram::Summary none = empty.summary();
+    assert(none.p50 == 0 && none.p999 == 0 && none.max == 0);
+
+    // values below 32 get a bucket each, above they share them with the
+    // values up to 1/32 above the bucket's lowest
+    for (uint64_t value = 0; value < 64; ++value)
+      assert(bucketBound(value) == value);
+    assert(bucketBound(64) == 65 && bucketBound(65) == 65);
+    assert(bucketBound(66) == 67 && bucketBound(127) == 127);
+    assert(bucketBound(128) == 131 && bucketBound(131) == 131);
+    assert(bucketBound(132) == 135);
+    for (unsigned bit = 6; bit < 63; ++bit) {
+      uint64_t power = uint64_t(1) << bit;
+      for (uint64_t value : {power - 1, power, power + 1}) {
+        uint64_t bound = bucketBound(value);
+        assert(bound >= value && bound - value <= value / 32);
+      }
+    }
+    std::mt19937_64 rng(7);
+    for (int i = 0; i < 100000; ++i) {
+      uint64_t value = rng() >> (rng() % 64);
+      uint64_t bound = bucketBound(value);
+      assert(bound >= value && bound - value <= value / 32);
+    }
+
+    // a percentile is never above the largest value recorded
+    LatencyHistogram single;
+    single.record(1000);
+    LatencyHistogram::Summary one = single.summary();
+    assert(one.p50 == 1000 && one.p999 == 1000 && one.max == 1000);
+
+    LatencyHistogram low, high, all;
+    for (uint64_t value = 1; value <= 1000; ++value) {
+      (value <= 500 ? low : high).record(value);
+      all.record(value);
+    }
+    assert(std::abs((double)all.percentile(50) - 500) <= 500 / 32.0);
+    assert(std::abs((double)all.percentile(99) - 990) <= 990 / 32.0);
+    low.merge(high);
+    assert(low.count() == 1000 && low.count() == all.count());
+    for (double p : {0.0, 10.0, 50.0, 90.0, 99.0, 99.9, 100.0})
+      assert(low.percentile(p) == all.percentile(p));
+    assert(low.summary().max == 1000);
+
+    std::ostringstream row;
+    row << one;
+    assert(row.str() == "1000,1000,1000,1000,1000");
+    assert(LatencyHistogram::Summary::header("Access").find(
+               "AccessP50(ns),") == 0);
+    single.time([]() {});
+    assert(single.count() == 2);
+    std::cout << "testLatencyHistogram passed!" << std::endl;
+  }
+
+  static void testWorkload() {
+    std::mt19937_64 rng(11);
+    const size_t n = 1000, draws = 100000;
+
+    // ranks stay in range, also after the item count grew, rank 0 first
+    ZipfianGenerator zipfian(n);
+    std::vector<size_t> ranks(2 * n);
+    for (size_t i = 0; i < draws; ++i) {
+      size_t rank = zipfian.next(rng, i < draws / 2 ? n : 2 * n);
+      assert(rank < (i < draws / 2 ? n : 2 * n));
+      ++ranks[rank];
+    }
+    assert(ranks[0] > ranks[1] && ranks[1] > ranks[10] &&
+           ranks[10] > ranks[500]);
+    assert(ranks[0] > draws / 20);
+
+    auto histogram = [&](KeyDistribution distribution) {
+      KeyChooser chooser(distribution, n);
+      std::vector<size_t> counts(n);
+      for (size_t i = 0; i < draws; ++i) {
+        size_t record = chooser.next(rng, n);
+        assert(record < n);
+        ++counts[record];
+      }
+      assert(KeyChooser(distribution, 1).next(rng, 1) == 0);
+      return counts;
+    };
+    auto share = [&](const std::vector<size_t> &counts, size_t from,
+                     size_t to) {
+      size_t sum = 0;
+      for (size_t i = from; i < to; ++i)
+        sum += counts[i];
+      return (double)sum / (double)draws;
+    };
+    // the scrambled Zipfian is as skewed, but the popular ranks after the
+    // first, about a quarter of the draws, are spread over the records
+    std::vector<size_t> scrambled = histogram(KeyDistribution::Zipfian);
+    assert(*std::max_element(scrambled.begin(), scrambled.end()) > draws / 20);
+    assert(share(scrambled, 1, 10) < 0.05);
+    std::vector<size_t> latest = histogram(KeyDistribution::Latest);
+    assert(std::max_element(latest.begin(), latest.end()) ==
+           latest.end() - 1);
+    std::vector<size_t> hotspot = histogram(KeyDistribution::Hotspot);
+    assert(std::abs(share(hotspot, 0, n / 5) - 0.8) < 0.01);
+    std::vector<size_t> uniform = histogram(KeyDistribution::Uniform);
+    assert(std::abs(share(uniform, 0, n / 2) - 0.5) < 0.01);
+
+    // every mix is replayed in its ratios; inserts add new keys
+    std::vector<std::pair<std::string, int>> data;
+    for (size_t i = 0; i < n; ++i)
+      data.emplace_back("name" + std::to_string(i), (int)i);
+    for (const WorkloadMix &mix : ycsbWorkloads()) {
+      KeySpace keys(data, n);
+      std::vector<Operation> ops =
+          generateOperations(mix, mix.distribution, keys, draws, rng);
+      assert(ops.size() == draws);
+      std::array<size_t, 5> types{};
+      for (const Operation &op : ops) {
+        ++types[op.type];
+        if (op.type == Operation::Scan)
+          assert(op.scanLength >= 1 && op.scanLength <= mix.maxScanLength);
+      }
+      double expected[] = {mix.read, mix.update, mix.insert, mix.scan,
+                           mix.readModifyWrite};
+      for (size_t type = 0; type < types.size(); ++type)
+        assert(std::abs((double)types[type] / draws - expected[type]) < 0.01);
+      assert(keys.size() == n + types[Operation::Insert]);
+      if (types[Operation::Insert] > 0)
+        assert(keys[n] == "name0#1000");
+    }
+
+    // an empty key space is filled before it is read
+    std::vector<std::pair<std::string, int>> nothing;
+    KeySpace empty(nothing, 0);
+    std::vector<Operation> ops = generateOperations(
+        ycsbWorkloads().front(), KeyDistribution::Zipfian, empty, 100, rng);
+    assert(ops.front().type == Operation::Insert);
+    assert(*ops.front().key == "key#0" && empty.size() >= 1);
+    for (const Operation &op : ops)
+      assert(op.key && op.key->rfind("key#", 0) == 0);
+    std::cout << "testWorkload passed!" << std::endl;
+  }
+
+  static void testPerfCounters() {
+    PerfCounters counters;
+    size_t sum = 0;
+    PerfStats stats = counters.measure([&]() {
+      for (size_t i = 0; i < 1000000; ++i)
+        sum += i * i;
+      volatile size_t result = sum;
+      (void)result;
+    });
+    // without a PMU (or with perf_event_paranoid too high) every event is
+    // invalid and written as an empty field
+    if (!counters.available()) {
+      for (bool valid : stats.valid)
+        assert(!valid);
+    }
+    if (stats.has(PerfStats::Instructions))
+      assert(stats[PerfStats::Instructions] >= 1000000);
+    if (stats.has(PerfStats::Cycles))
+      assert(stats[PerfStats::Cycles] > 0);
+
+    // a second measurement on the same counters counts only its own run
+    PerfStats again = counters.measure([&]() {
+      for (size_t i = 0; i < 1000000; ++i)
+        sum += i * i;
+      volatile size_t result = sum;
+      (void)result;
+    });
+    for (int event = 0; event < PerfStats::EventCount; ++event)
+      assert(again.valid[event] == stats.valid[event]);
+    if (again.has(PerfStats::Instructions)) {
+      assert(again[PerfStats::Instructions] >= 1000000);
+      assert(again[PerfStats::Instructions] <
+             1.5 * stats[PerfStats::Instructions]);
+    }
+
+    PerfStats perOperation = stats.perOperation(1000);
+    for (int event = 0; event < PerfStats::EventCount; ++event) {
+      assert(perOperation.valid[event] == stats.valid[event]);
+      assert(std::abs(perOperation.values[event] * 1000 -
+                      stats.values[event]) <= 1e-6 * stats.values[event]);
+    }
+    std::ostringstream row;
+    row << PerfStats();
+    assert(row.str() == ",,,,,");
+    assert(PerfStats::header("Insert").find("InsertCycles,") == 0);
+    std::cout << "testPerfCounters passed!" << std::endl;
+  }
+
+  static void testBenchRunner() {
+    SampleStats stats = SampleStats::of({4, NAN, 1, 3, 2, 5});
+    assert(stats.count == 5 && stats.median == 3 && stats.mean == 3);
+    assert(std::abs(stats.stddev - std::sqrt(2.5)) < 1e-9);
+    // t(0.975, 4) = 2.776
+    double margin = 2.776 * std::sqrt(2.5) / std::sqrt(5.0);
+    assert(std::abs(stats.ciHigh - 3 - margin) < 1e-9);
+    assert(std::abs(3 - stats.ciLow - margin) < 1e-9);
+    assert(SampleStats::of({2, 4}).median == 3);
+    std::ostringstream row;
+    row << SampleStats::of({NAN});
+    assert(row.str() == "0,,,,,");
+
+    char *argv[] = {(char *)"bench", (char *)"--warmup", (char *)"2",
+                    (char *)"--repetitions", (char *)"3", (char *)"--seed",
+                    (char *)"9"};
+    BenchRunner::Options options = BenchRunner::Options::parse(7, argv);
+    assert(options.warmup == 2 && options.repetitions == 3);
+    assert(options.seed == 9 && !options.isolate);
+
+    // every case runs warmup + repetitions times, and only the measured runs
+    // are returned
+    std::vector<int> runs(3);
+    std::vector<BenchRunner::Case> cases;
+    for (int i = 0; i < 3; ++i) {
+      auto run = [&runs, i]() {
+        ++runs[i];
+        return Sample{{(double)i, (double)runs[i]}, "text"};
+      };
+      cases.push_back({std::to_string(i), run});
+    }
+    BenchRunner runner(options);
+    auto samples = runner.run(cases);
+    assert(samples.size() == 3);
+    for (int i = 0; i < 3; ++i) {
+      assert(runs[i] == 5 && samples[i].size() == 3);
+      for (size_t run = 0; run < 3; ++run) {
+        assert(samples[i][run].values[0] == i);
+        assert(samples[i][run].values[1] == 3 + run);
+      }
+    }
+
+    // isolated runs happen in children, which send their samples back
+    options.isolate = true;
+    BenchRunner isolated(options);
+    samples = isolated.run(cases);
+    for (int i = 0; i < 3; ++i) {
+      assert(runs[i] == 5 && samples[i].size() == 3);
+      assert(samples[i][0].values[1] == 8 && samples[i][2].text == "text");
+    }
+    std::cout << "testBenchRunner passed!" << std::endl;
+  }
+
+  static void testDataset() {
+    const char *filename = "testDataset.csv";
+    {
+      std::ofstream file(filename, std::ios::binary);
+      file << "KEY,studentID,class,totalCredit\r\n";
+      for (int i = 0; i < 100000; ++i)
+        file << "key" << i << "," << 6000000000ULL + i << ",2010," << i % 150
+             << "\r\n";
+      file << "last,1,2011,7"; // no line break at the end
+    }
+    // enough data for several chunks
+    Dataset dataset = loadDataset(filename, 4);
+    std::remove(filename);
+    assert(dataset.size() == 100001);
+    assert(dataset.keys[0] == "key0" && dataset.keys[99999] == "key99999");
+    assert(dataset.studentIds[12345] == 6000012345ULL);
+    assert(dataset.classes[5] == "2010" && dataset.totalCredits[151] == 1);
+    assert(dataset.keys[100000] == "last" && dataset.totalCredits[100000] == 7);
+    assert(loadDataset("missing.csv").size() == 0);
+    std::cout << "testDataset passed!" << std::endl;
+  }
 };
 
 #endif // PROJECT_DB_TEST_BPTREE_H